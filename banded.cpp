@@ -0,0 +1,368 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+#include "linalg.h"
+
+/*! \file banded.cpp
+  \brief Banded Matrices
+
+  Implements BandedMatrix. The band is stored row by row with the diagonals side by side, which keeps each row of the factorization and each step of the substitutions in one or two cache lines. Right hand sides are the rows of a Matrix, so with several of them the innermost loops run across a contiguous row and the cost of walking the band is shared. */
+
+//! Default Constructor
+/*! Creates an empty \f$0\times0\f$ BandedMatrix. */
+BandedMatrix::BandedMatrix()
+{
+	band=factors=NULL;
+	pivots=NULL;
+	n=l=u=0;
+	factored=thomas=false;
+	LINALG_CONSTRUCT();
+}
+
+//! Copy Constructor
+/*! Creates a BandedMatrix from the BandedMatrix \a other. The factors are not copied.
+  \param other the BandedMatrix to copy from */
+BandedMatrix::BandedMatrix(const BandedMatrix &other)
+{
+	allocate(other.n,other.l,other.u);
+	for (unsigned long i=0;i<(unsigned long)n*(l+u+1);i++)
+		band[i]=other.band[i];
+	LINALG_CONSTRUCT();
+	LINALG_COPY();
+}
+
+//! Full Constructor
+/*! Creates a zero \f$a\times a\f$ BandedMatrix.
+  \param a number of rows and columns
+  \param lower number of diagonals below the main diagonal
+  \param upper number of diagonals above the main diagonal */
+BandedMatrix::BandedMatrix(unsigned int a,unsigned int lower,unsigned int upper)
+{
+	allocate(a,lower,upper);
+	for (unsigned long i=0;i<(unsigned long)n*(l+u+1);i++)
+		band[i]=0.0;
+	LINALG_CONSTRUCT();
+}
+
+//! Destructor
+/*! Frees the band and the factors. */
+BandedMatrix::~BandedMatrix()
+{
+	release();
+}
+
+//! Assignment Operator
+/*! Copies the BandedMatrix \a other. The factors are not copied.
+  \param other the BandedMatrix to copy from
+  \return a reference to this BandedMatrix */
+BandedMatrix &BandedMatrix::operator=(const BandedMatrix &other)
+{
+	if (this==&other)
+		return *this;
+	release();
+	allocate(other.n,other.l,other.u);
+	for (unsigned long i=0;i<(unsigned long)n*(l+u+1);i++)
+		band[i]=other.band[i];
+	LINALG_COPY();
+	return *this;
+}
+
+//! Storage Allocator
+/*! Allocates an uninitialized band and sets the dimensions. The factors are allocated by factor().
+  \param a number of rows and columns
+  \param lower number of diagonals below the main diagonal
+  \param upper number of diagonals above the main diagonal */
+void BandedMatrix::allocate(unsigned int a,unsigned int lower,unsigned int upper)
+{
+	try
+	{
+		band=new double[(size_t)a*(lower+upper+1)];
+	}
+	catch (std::bad_alloc &e)
+	{
+		std::cerr<<"Exception: "<<e.what()<<std::endl;
+		abort();
+	}
+	factors=NULL;
+	pivots=NULL;
+	n=a;
+	l=lower;
+	u=upper;
+	factored=thomas=false;
+	LINALG_ALLOC((size_t)a*(lower+upper+1)*sizeof(double));
+}
+
+//! Storage Deallocator
+/*! Frees the band and the factors and leaves an empty \f$0\times0\f$ BandedMatrix. */
+void BandedMatrix::release()
+{
+	if (band)
+	{
+		delete[] band;
+		LINALG_FREE((size_t)n*(l+u+1)*sizeof(double));
+	}
+	if (factors)
+	{
+		delete[] factors;
+		delete[] pivots;
+		LINALG_FREE((size_t)n*(2*l+u+1)*sizeof(double)+(size_t)n*sizeof(unsigned int));
+	}
+	band=factors=NULL;
+	pivots=NULL;
+	n=l=u=0;
+	factored=false;
+}
+
+//! Banded Matrix Multiplication
+/*! Multiplies the BandedMatrix by \a X, for instance to check the residual of solve(). Runs \f$O(n(l+u+1)k)\f$ for a \f$n\times k\f$ Matrix.
+  \param X \f$n\times k\f$ Matrix to multiply
+  \throw LinAlgException if the dimensions don't match
+  \return the resulting \f$n\times k\f$ Matrix */
+Matrix BandedMatrix::operator*(Matrix &X)
+{
+	if (X.m!=n)
+		throw LinAlgException("Incompatible Dimensions");
+	const unsigned int w=l+u+1,k=X.n;
+	unsigned long flops=0;
+	Matrix Y(n,k);
+	for (unsigned int i=0;i<n;i++)
+	{
+		unsigned int first=i>l?i-l:0,last=i+u<n?i+u:n-1;
+		double *y=Y.matrix[i];
+		for (unsigned int j=first;j<=last;j++)
+		{
+			double a=band[(size_t)i*w+j+l-i],*x=X.matrix[j];
+			for (unsigned int c=0;c<k;c++)
+				y[c]+=a*x[c];
+		}
+		flops+=2ul*(last-first+1)*k;
+	}
+	LINALG_FLOPS(OP_BANDED,flops);
+	return Y;
+}
+
+//! Accessor Method
+/*! Accesses the value at \f$M_{ab}\f$, which is zero outside the band.
+  \param a the row of the value
+  \param b the column of the value
+  \throw LinAlgException if \a a or \a b is out of bounds
+  \return the value */
+double BandedMatrix::at(unsigned int a,unsigned int b)
+{
+	if (a>=n||b>=n)
+		throw LinAlgException("Dimensions out of bounds");
+	if (b+l<a||b>a+u)
+		return 0.0;
+	return band[(size_t)a*(l+u+1)+b+l-a];
+}
+
+//! Dense Copy
+/*! Expands the BandedMatrix into a Matrix.
+  \return the \f$n\times n\f$ Matrix */
+Matrix BandedMatrix::dense()
+{
+	Matrix D(n,n);
+	for (unsigned int i=0;i<n;i++)
+	{
+		unsigned int first=i>l?i-l:0,last=i+u<n?i+u:n-1;
+		for (unsigned int j=first;j<=last;j++)
+			D.matrix[i][j]=band[(size_t)i*(l+u+1)+j+l-i];
+	}
+	return D;
+}
+
+//! Lower Bandwidth Accessor
+/*! \return the number of diagonals below the main diagonal */
+unsigned int BandedMatrix::lower()
+{
+	return l;
+}
+
+//! Standard Mutator
+/*! This function will assign the value \a v to \f$M_{ab}\f$ and discard the factors.
+  \param a the row to access
+  \param b the column to access
+  \param v the data to load
+  \throw LinAlgException if \f$M_{ab}\f$ is out of bounds or outside the band */
+void BandedMatrix::set(unsigned int a,unsigned int b,double v)
+{
+	if (a>=n||b>=n)
+		throw LinAlgException("Dimensions out of bounds");
+	if (b+l<a||b>a+u)
+		throw LinAlgException("Outside the band");
+	band[(size_t)a*(l+u+1)+b+l-a]=v;
+	factored=false;
+}
+
+//! Size Accessor
+/*! \return the number of rows and columns */
+unsigned int BandedMatrix::size()
+{
+	return n;
+}
+
+//! Banded Solver
+/*! Solves \f$MX=B\f$ ``in place'' for every column of \a B at once. The first call after a set() factors the BandedMatrix in \f$O(nl(l+u))\f$; after that each solve costs \f$O(n(2l+u)k)\f$ for \f$k\f$ right hand sides, which for a tridiagonal spline system is a few passes over the data.
+  \param B \f$n\times k\f$ right hand sides, replaced by the solutions
+  \throw LinAlgException if \a B does not have \f$n\f$ rows or the BandedMatrix is singular
+  \sa Matrix::LU(Matrix &b) */
+void BandedMatrix::solve(Matrix &B)
+{
+	if (B.m!=n)
+		throw LinAlgException("Incompatible dimensions for Matrix b");
+	if (!factored)
+		factor();
+	const unsigned int fw=2*l+u+1,k=B.n;
+	double **x=B.matrix;
+	unsigned long flops=0;
+	if (thomas)
+	{
+		/* forward elimination with the stored multipliers */
+		for (unsigned int i=1;i<n;i++)
+		{
+			double m=factors[(size_t)i*fw];
+			for (unsigned int c=0;c<k;c++)
+				x[i][c]-=m*x[i-1][c];
+		}
+		/* back substitution */
+		for (unsigned int c=0;c<k&&n;c++)
+			x[n-1][c]/=factors[(size_t)(n-1)*fw+1];
+		for (unsigned int i=n-2;i<n;i--)
+		{
+			const double *f=factors+(size_t)i*fw;
+			for (unsigned int c=0;c<k;c++)
+				x[i][c]=(x[i][c]-f[2]*x[i+1][c])/f[1];
+		}
+		flops=5ul*n*k;
+	}
+	else
+	{
+		/* apply the row swaps and L; the rows are swapped by value since B may wrap the caller's rows */
+		for (unsigned int j=0;j<n;j++)
+		{
+			unsigned int last=j+l<n?j+l:n-1;
+			if (pivots[j]!=j)
+				for (unsigned int c=0;c<k;c++)
+				{
+					double t=x[j][c];
+					x[j][c]=x[pivots[j]][c];
+					x[pivots[j]][c]=t;
+				}
+			for (unsigned int i=j+1;i<=last;i++)
+			{
+				double m=factors[(size_t)i*fw+j+l-i];
+				for (unsigned int c=0;c<k;c++)
+					x[i][c]-=m*x[j][c];
+			}
+			flops+=2ul*(last-j)*k;
+		}
+		/* back substitution with U, whose rows reach l+u past the diagonal */
+		for (unsigned int i=n-1;i<n;i--)
+		{
+			unsigned int last=i+l+u<n?i+l+u:n-1;
+			const double *f=factors+(size_t)i*fw+l-i;
+			for (unsigned int j=i+1;j<=last;j++)
+				for (unsigned int c=0;c<k;c++)
+					x[i][c]-=f[j]*x[j][c];
+			for (unsigned int c=0;c<k;c++)
+				x[i][c]/=f[i];
+			flops+=(2ul*(last-i)+1)*k;
+		}
+	}
+	B.touch();
+	LINALG_FLOPS(OP_BANDED,flops);
+}
+
+//! Upper Bandwidth Accessor
+/*! \return the number of diagonals above the main diagonal */
+unsigned int BandedMatrix::upper()
+{
+	return u;
+}
+
+//! Banded LU Decomposition
+/*! Factors the BandedMatrix into factors and pivots. A tridiagonal matrix that is strictly diagonally dominant by rows is factored by the Thomas algorithm: no pivoting is needed, and the multipliers and the reduced diagonal are all that is stored. Otherwise rows are swapped for partial pivoting, which lets the upper factor grow \a l diagonals past the band.
+  \throw LinAlgException if the BandedMatrix is singular */
+void BandedMatrix::factor()
+{
+	const unsigned int w=l+u+1,fw=2*l+u+1;
+	unsigned long flops=0;
+	if (!factors)
+	{
+		try
+		{
+			factors=new double[(size_t)n*fw];
+			pivots=new unsigned int[n];
+		}
+		catch (std::bad_alloc &e)
+		{
+			std::cerr<<"Exception: "<<e.what()<<std::endl;
+			abort();
+		}
+		LINALG_ALLOC((size_t)n*fw*sizeof(double)+(size_t)n*sizeof(unsigned int));
+	}
+	for (unsigned int i=0;i<n;i++)
+	{
+		double *f=factors+(size_t)i*fw;
+		const double *b=band+(size_t)i*w;
+		for (unsigned int j=0;j<w;j++)
+			f[j]=b[j];
+		for (unsigned int j=w;j<fw;j++)
+			f[j]=0.0;
+		pivots[i]=i;
+	}
+	/* entries of the band outside the matrix are zero, so the end rows need no special case */
+	thomas=(l==1&&u==1);
+	for (unsigned int i=0;thomas&&i<n;i++)
+		thomas=fabs(band[(size_t)i*w+1])>fabs(band[(size_t)i*w])+fabs(band[(size_t)i*w+2]);
+	if (thomas)
+	{
+		/* row i holds the multiplier at 0, the reduced diagonal at 1 and the superdiagonal at 2 */
+		for (unsigned int i=1;i<n;i++)
+		{
+			double *f=factors+(size_t)i*fw;
+			const double *p=f-fw;
+			f[0]/=p[1];
+			f[1]-=f[0]*p[2];
+		}
+		flops=n?3ul*(n-1):0;
+	}
+	else
+	{
+		for (unsigned int j=0;j<n;j++)
+		{
+			unsigned int last=j+l<n?j+l:n-1,right=j+l+u<n?j+l+u:n-1,p=j;
+			/* element (i,j) is factors[i*fw+j+l-i] */
+			for (unsigned int i=j+1;i<=last;i++)
+				if (fabs(factors[(size_t)i*fw+j+l-i])>fabs(factors[(size_t)p*fw+j+l-p]))
+					p=i;
+			/* an exact zero only; the pivot is the largest entry left in the column */
+			if (factors[(size_t)p*fw+j+l-p]==0.0)
+				throw LinAlgException("Singular matrix");
+			pivots[j]=p;
+			if (p!=j)
+			{
+				double *a=factors+(size_t)j*fw+l-j,*b=factors+(size_t)p*fw+l-p;
+				for (unsigned int k=j;k<=right;k++)
+				{
+					double t=a[k];
+					a[k]=b[k];
+					b[k]=t;
+				}
+			}
+			const double *pivotRow=factors+(size_t)j*fw+l-j;
+			for (unsigned int i=j+1;i<=last;i++)
+			{
+				double *row=factors+(size_t)i*fw+l-i;
+				double m=row[j]/pivotRow[j];
+				row[j]=m;
+				for (unsigned int k=j+1;k<=right;k++)
+					row[k]-=m*pivotRow[k];
+				flops+=2ul*(right-j)+1;
+			}
+		}
+	}
+	factored=true;
+	LINALG_FLOPS(OP_BANDED,flops);
+}
@@ -0,0 +1,198 @@
+#include <cmath>
+#include "robot.h"
+#include "parallel.h"
+#include "simd.h"
+
+/*! \file clusters.cpp
+  \brief Clustered Light Culling
+
+  Implements LightClusters. Columns and rows are cut evenly across the viewport, so the planes between them all pass through the eye, and slices are spaced evenly in the log of the depth, so cells stay roughly cube shaped from near to far. A fragment finds its cell from its window coordinates and its clip \f$w\f$ with the scale getScale() returns, exactly as bin() does on the CPU.
+
+  Binning runs in two passes over the LinAlgThreads pool. The first finds the columns, rows and slices each light's bounding sphere reaches, light by light. The second fills each slice's cells with a counting sort over the lights, slice by slice, so no two threads ever write the same cell and the lists come out in light order whatever the number of threads. */
+
+//! Boundary Plane Count
+/*! Planes between columns and between rows, including the edges of the viewport. */
+#define CLUSTER_PLANES (CLUSTER_COLUMNS + 1 + CLUSTER_ROWS + 1)
+
+//! Lights Per Range
+/*! Lights each thread takes at a time in the first pass. */
+#define CLUSTER_GRAIN 64
+
+//! LightClusters Constructor
+/*! Creates an empty grid over a frustum of unit depth; setFrustum() must be called before bin(). */
+LightClusters::LightClusters() : planes(4 * CLUSTER_PLANES, 0.0), cells(2 * CLUSTER_COUNT, 0)
+{
+	for (unsigned short i=0; i<4; i++)
+	{
+		depth[i] = i == 3 ? 1.0 : 0.0;
+		scale[i] = 0.0;
+	}
+	depthScale = 0.0;
+	nearPlane = 1.0;
+	farPlane = 2.0;
+}
+
+//! Set Frustum
+/*! Computes the planes between columns and rows and the depth slicing for a projection. The planes are taken from the rows of the projection matrix: the boundary at \f$x_{ndc}=x_i\f$ is the plane \f$(row_0-x_i\,row_3)\cdot p=0\f$, scaled to a unit normal so the plane equations give distances.
+  \param projection the transform from the eye coordinates the lights are in to clip coordinates
+  \param nearPlane the depth of the near clipping plane
+  \param farPlane the depth of the far clipping plane
+  \param width the width of the viewport in pixels
+  \param height the height of the viewport in pixels */
+void LightClusters::setFrustum(const Mat4 &projection, double nearPlane, double farPlane, int width, int height)
+{
+	const double *m = projection.m;
+	for (unsigned int i=0; i<CLUSTER_PLANES; i++)
+	{
+		/* columns bound x, rows bound y */
+		unsigned int row = i <= CLUSTER_COLUMNS ? 0 : 1;
+		double edge = row == 0 ? -1.0 + 2.0 * i / CLUSTER_COLUMNS : -1.0 + 2.0 * (i - CLUSTER_COLUMNS - 1) / CLUSTER_ROWS;
+		double plane[4], length = 0.0;
+		for (unsigned short j=0; j<4; j++)
+			plane[j] = m[4 * j + row] - edge * m[4 * j + 3];
+		for (unsigned short j=0; j<3; j++)
+			length += plane[j] * plane[j];
+		length = sqrt(length);
+		for (unsigned short j=0; j<4; j++)
+			planes[j * CLUSTER_PLANES + i] = plane[j] / length;
+	}
+	for (unsigned short j=0; j<4; j++)
+		depth[j] = m[4 * j + 3];
+	depthScale = sqrt(depth[0] * depth[0] + depth[1] * depth[1] + depth[2] * depth[2]);
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	scale[0] = (GLfloat)CLUSTER_COLUMNS / width;
+	scale[1] = (GLfloat)CLUSTER_ROWS / height;
+	scale[2] = CLUSTER_SLICES / log(farPlane / nearPlane);
+	scale[3] = -log(nearPlane) * scale[2];
+}
+
+//! Slice Of A Depth
+/*! \param depth a clip \f$w\f$ between the near and far planes
+  \return the slice it falls in */
+unsigned int LightClusters::slice(double depth) const
+{
+	int s = (int)floor(log(depth) * scale[2] + scale[3]);
+	return s < 0 ? 0 : (s >= CLUSTER_SLICES ? CLUSTER_SLICES - 1 : s);
+}
+
+//! Bin Lights
+/*! Rebuilds every cell's list from scratch.
+  \param lights the local lights, in the eye coordinates the projection passed to setFrustum() takes */
+void LightClusters::bin(const std::vector<LocalLight> &lights)
+{
+	unsigned long count = lights.size();
+	ranges.resize(6 * count);
+	/* find the cells each light reaches */
+	LinAlgThreads::run(count, CLUSTER_GRAIN, [&](unsigned long begin, unsigned long end)
+	{
+		double distances[CLUSTER_PLANES];
+		for (unsigned long i=begin; i<end; i++)
+		{
+			const GLfloat *p = lights[i].position;
+			double center[3] = {p[0], p[1], p[2]}, radius = p[3];
+			double w = depth[0] * center[0] + depth[1] * center[1] + depth[2] * center[2] + depth[3], reach = radius * depthScale;
+			int *range = &ranges[6 * i];
+			range[0] = 0;
+			range[1] = CLUSTER_COLUMNS - 1;
+			range[2] = 0;
+			range[3] = CLUSTER_ROWS - 1;
+			if (w + reach < nearPlane || w - reach > farPlane)
+			{
+				range[0] = 1;
+				range[1] = 0;
+				continue;
+			}
+			range[4] = slice(w - reach > nearPlane ? w - reach : nearPlane);
+			range[5] = slice(w + reach < farPlane ? w + reach : farPlane);
+			/* the planes meet at the eye, so a sphere around it may reach any column */
+			if (w < reach)
+				continue;
+			simdPlaneDistances(&planes[0], CLUSTER_PLANES, center, distances);
+			for (unsigned short axis=0; axis<2; axis++)
+			{
+				const double *d = distances + (axis ? CLUSTER_COLUMNS + 1 : 0);
+				int size = axis ? CLUSTER_ROWS : CLUSTER_COLUMNS, first = size, last = -1;
+				/* in a cell if inside its low edge and its high edge */
+				for (int j=0; j<size; j++)
+					if (d[j] > -radius && d[j+1] < radius)
+					{
+						if (first > j)
+							first = j;
+						last = j;
+					}
+				range[2 * axis] = first;
+				range[2 * axis + 1] = last;
+			}
+		}
+	});
+	/* fill each slice's cells by counting sort */
+	std::vector<std::vector<GLuint> > sliceIndices(CLUSTER_SLICES);
+	LinAlgThreads::run(CLUSTER_SLICES, 1, [&](unsigned long begin, unsigned long end)
+	{
+		for (unsigned long s=begin; s<end; s++)
+		{
+			GLuint *cell = &cells[2 * s * CLUSTER_COLUMNS * CLUSTER_ROWS];
+			for (unsigned int k=0; k<CLUSTER_COLUMNS*CLUSTER_ROWS; k++)
+				cell[2 * k + 1] = 0;
+			for (unsigned int pass=0; pass<2; pass++)
+			{
+				for (unsigned long i=0; i<count; i++)
+				{
+					const int *range = &ranges[6 * i];
+					if (range[0] > range[1] || range[2] > range[3] || (int)s < range[4] || (int)s > range[5])
+						continue;
+					for (int y=range[2]; y<=range[3]; y++)
+						for (int x=range[0]; x<=range[1]; x++)
+						{
+							GLuint *c = cell + 2 * (y * CLUSTER_COLUMNS + x);
+							if (pass)
+								sliceIndices[s][c[0] + c[1]] = i;
+							c[1]++;
+						}
+				}
+				if (pass)
+					break;
+				/* turn the counts into offsets and count again while filling */
+				GLuint total = 0;
+				for (unsigned int k=0; k<CLUSTER_COLUMNS*CLUSTER_ROWS; k++)
+				{
+					cell[2 * k] = total;
+					total += cell[2 * k + 1];
+					cell[2 * k + 1] = 0;
+				}
+				sliceIndices[s].resize(total);
+			}
+		}
+	});
+	/* join the slices */
+	indices.clear();
+	for (unsigned int s=0; s<CLUSTER_SLICES; s++)
+	{
+		GLuint base = indices.size();
+		for (unsigned int k=0; k<CLUSTER_COLUMNS*CLUSTER_ROWS; k++)
+			cells[2 * (s * CLUSTER_COLUMNS * CLUSTER_ROWS + k)] += base;
+		indices.insert(indices.end(), sliceIndices[s].begin(), sliceIndices[s].end());
+	}
+}
+
+//! Get Cells
+/*! \return the first index and the number of indices of every cell, in the order the shader reads them */
+const std::vector<GLuint> &LightClusters::getCells() const
+{
+	return cells;
+}
+
+//! Get Indices
+/*! \return the lights of every cell, cell after cell */
+const std::vector<GLuint> &LightClusters::getIndices() const
+{
+	return indices;
+}
+
+//! Get Shader Scale
+/*! \return array of 4 values for LightBlock::clusterScale: columns per pixel, rows per pixel, and the scale and offset that turn the natural log of a clip \f$w\f$ into a slice */
+const GLfloat *LightClusters::getScale() const
+{
+	return scale;
+}
@@ -0,0 +1,155 @@
+#include <cmath>
+#include "robot.h"
+#include "simd.h"
+
+/*! \file frustum.cpp
+  \brief Frustum Culling
+
+  Implements Frustum and the functions that build Bounds. Parts are culled in world coordinates: each part's Bounds in its own coordinates is carried through its palette matrix by transformBounds(), and the parts are merged into the Bounds of the whole model with mergeBounds(). The whole is tested first, so a model entirely in or out of view costs a single test, and only a model the frustum cuts through has its parts tested one by one. */
+
+//! Bounds Of A Box
+/*! \param min array of 3 values, the minimum corner
+  \param max array of 3 values, the maximum corner
+  \return the box with the sphere through its corners */
+Bounds boundsOf(const double *min, const double *max)
+{
+	Bounds bounds;
+	double length = 0.0;
+	for (unsigned short i=0; i<3; i++)
+	{
+		bounds.min[i] = min[i];
+		bounds.max[i] = max[i];
+		bounds.center[i] = (min[i] + max[i]) / 2.0;
+		length += (max[i] - min[i]) * (max[i] - min[i]);
+	}
+	bounds.radius = sqrt(length) / 2.0;
+	return bounds;
+}
+
+//! Transform Bounds
+/*! Carries bounds through a transform. The new box is the smallest axis aligned box around the transformed one, found from the absolute values of the matrix as in Arvo's method; the sphere is moved and grows with the longest axis of the transform.
+  \param bounds the bounds in the coordinates \a model takes
+  \param model an affine transform
+  \return the bounds in the coordinates \a model gives */
+Bounds transformBounds(const Bounds &bounds, const Mat4 &model)
+{
+	Bounds result;
+	double middle[3], extent[3], scale = 0.0;
+	for (unsigned short j=0; j<3; j++)
+	{
+		middle[j] = (bounds.min[j] + bounds.max[j]) / 2.0;
+		extent[j] = (bounds.max[j] - bounds.min[j]) / 2.0;
+	}
+	for (unsigned short i=0; i<3; i++)
+	{
+		double center = model.m[12+i], reach = 0.0, length = 0.0;
+		result.center[i] = model.m[12+i];
+		for (unsigned short j=0; j<3; j++)
+		{
+			center += model.m[4*j+i] * middle[j];
+			reach += fabs(model.m[4*j+i]) * extent[j];
+			result.center[i] += model.m[4*j+i] * bounds.center[j];
+			length += model.m[4*i+j] * model.m[4*i+j];
+		}
+		result.min[i] = center - reach;
+		result.max[i] = center + reach;
+		if (scale < length)
+			scale = length;
+	}
+	result.radius = bounds.radius * sqrt(scale);
+	return result;
+}
+
+//! Merge Bounds
+/*! Grows bounds to enclose other bounds as well: the box to the box around both, and the sphere to the smallest sphere around both spheres.
+  \param bounds the bounds to grow
+  \param other the bounds to take in */
+void mergeBounds(Bounds &bounds, const Bounds &other)
+{
+	double distance = 0.0;
+	for (unsigned short i=0; i<3; i++)
+	{
+		if (bounds.min[i] > other.min[i])
+			bounds.min[i] = other.min[i];
+		if (bounds.max[i] < other.max[i])
+			bounds.max[i] = other.max[i];
+		distance += (other.center[i] - bounds.center[i]) * (other.center[i] - bounds.center[i]);
+	}
+	distance = sqrt(distance);
+	/* one sphere may already hold the other */
+	if (distance + other.radius <= bounds.radius)
+		return;
+	if (distance + bounds.radius <= other.radius)
+	{
+		for (unsigned short i=0; i<3; i++)
+			bounds.center[i] = other.center[i];
+		bounds.radius = other.radius;
+		return;
+	}
+	double radius = (distance + bounds.radius + other.radius) / 2.0;
+	for (unsigned short i=0; i<3; i++)
+		bounds.center[i] += (radius - bounds.radius) / distance * (other.center[i] - bounds.center[i]);
+	bounds.radius = radius;
+}
+
+//! Frustum Constructor
+/*! Extracts the planes from the rows of a transform to clip coordinates as Gribb and Hartmann do: a point is inside when \f$-w\le x\le w\f$, so the left plane is \f$row_3+row_0\f$, the right plane \f$row_3-row_0\f$, and likewise for \f$y\f$ and \f$z\f$. The planes are scaled to unit normals so the plane equations give distances.
+  \param clip the transform from the coordinates the bounds will be in to clip coordinates */
+Frustum::Frustum(const Mat4 &clip)
+{
+	for (unsigned short i=0; i<FRUSTUM_PLANES; i++)
+	{
+		/* the padding is the plane HUGE_VAL = 0, which every point is infinitely far inside, so it never stops bounds being CULL_INSIDE */
+		double plane[4] = {0.0, 0.0, 0.0, HUGE_VAL}, length = 1.0;
+		if (i < 6)
+		{
+			length = 0.0;
+			for (unsigned short j=0; j<4; j++)
+				plane[j] = clip.m[4*j+3] + (i % 2 ? -1.0 : 1.0) * clip.m[4*j+i/2];
+			for (unsigned short j=0; j<3; j++)
+				length += plane[j] * plane[j];
+			length = sqrt(length);
+		}
+		for (unsigned short j=0; j<4; j++)
+		{
+			planes[j * FRUSTUM_PLANES + i] = plane[j] / length;
+			reach[j * FRUSTUM_PLANES + i] = j < 3 ? fabs(plane[j]) / length : 0.0;
+		}
+	}
+}
+
+//! Test Method
+/*! Finds where bounds lie. The sphere is tried first, which settles most bounds well inside or well outside; bounds the sphere leaves in doubt are tried again with the box, whose distance to each plane is its center's less how far its half size reaches toward the plane.
+  \param bounds the bounds, in the coordinates the frustum was built for
+  \return CULL_OUTSIDE if nothing in the bounds can be seen, CULL_INSIDE if all of it can, and CULL_INTERSECT otherwise */
+unsigned short Frustum::test(const Bounds &bounds) const
+{
+	double distances[FRUSTUM_PLANES], reaches[FRUSTUM_PLANES], middle[3], extent[3];
+	bool inside = true;
+	simdPlaneDistances(planes, FRUSTUM_PLANES, bounds.center, distances);
+	for (unsigned short i=0; i<FRUSTUM_PLANES; i++)
+	{
+		if (distances[i] < -bounds.radius)
+			return CULL_OUTSIDE;
+		if (distances[i] < bounds.radius)
+			inside = false;
+	}
+	if (inside)
+		return CULL_INSIDE;
+	for (unsigned short j=0; j<3; j++)
+	{
+		middle[j] = (bounds.min[j] + bounds.max[j]) / 2.0;
+		extent[j] = (bounds.max[j] - bounds.min[j]) / 2.0;
+	}
+	simdPlaneDistances(planes, FRUSTUM_PLANES, middle, distances);
+	simdPlaneDistances(reach, FRUSTUM_PLANES, extent, reaches);
+	inside = true;
+	for (unsigned short i=0; i<FRUSTUM_PLANES; i++)
+	{
+		if (distances[i] < -reaches[i])
+			return CULL_OUTSIDE;
+		if (distances[i] < reaches[i])
+			inside = false;
+	}
+	return inside ? CULL_INSIDE : CULL_INTERSECT;
+}
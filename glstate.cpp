@@ -0,0 +1,249 @@
+#include <cstring>
+#include <map>
+#include "robot.h"
+
+/*! \file glstate.cpp
+  \brief OpenGL State Cache
+
+  Implements GLState. Every piece of state starts out unknown, so the first call that sets it always reaches OpenGL, and is remembered from then on. Material parameters that \c GL_COLOR_MATERIAL may be overwriting from the current color are never remembered, because OpenGL changes them behind the cache's back whenever the color changes. */
+
+//! Material Parameters
+/*! Enumeration of the front material parameters the cache shadows. */
+enum materialParams {MATERIAL_AMBIENT, MATERIAL_DIFFUSE, MATERIAL_SPECULAR, MATERIAL_EMISSION, MATERIAL_SHININESS, MATERIAL_COUNT};
+
+//! Capabilities
+/*! The last known state of each capability passed to enable(), disable() or isEnabled(). */
+static std::map<GLenum, bool> capabilities;
+
+//! Front Material
+/*! The last known value of each front material parameter, valid where materialKnown is set. */
+static GLfloat frontMaterial[MATERIAL_COUNT][4];
+
+//! Known Material Parameters
+/*! Flags that tell which entries of frontMaterial are valid. */
+static bool materialKnown[MATERIAL_COUNT];
+
+//! Color Material Mode
+/*! The front material parameter the current color is tracked by, valid if colorModeKnown is set. */
+static GLenum colorMode;
+
+//! Known Color Material Mode
+/*! Flag that indicates whether colorMode is valid. */
+static bool colorModeKnown;
+
+//! Bound Texture
+/*! The texture last bound to \c GL_TEXTURE_2D, valid if textureKnown is set. */
+static GLuint texture;
+
+//! Known Texture
+/*! Flag that indicates whether texture is valid. */
+static bool textureKnown;
+
+//! Bound Program
+/*! The program last bound by useProgram(), or NULL for the fixed function pipeline. */
+static QOpenGLShaderProgram *program;
+
+//! Count A Call
+/*! Counts a call as issued or filtered.
+  \param same true if the call would not have changed anything
+  \return \a same */
+static bool redundant(bool same)
+{
+	RENDER_COUNT(same ? RENDER_STATE_FILTERED : RENDER_STATE_CHANGES, 1);
+	return same;
+}
+
+//! Material Parameter Index
+/*! \param pname a \c glMaterial parameter name
+  \return the matching materialParams entry, or MATERIAL_COUNT if the parameter is not shadowed */
+static unsigned int materialIndex(GLenum pname)
+{
+	switch (pname)
+	{
+		case GL_AMBIENT:
+			return MATERIAL_AMBIENT;
+		case GL_DIFFUSE:
+			return MATERIAL_DIFFUSE;
+		case GL_SPECULAR:
+			return MATERIAL_SPECULAR;
+		case GL_EMISSION:
+			return MATERIAL_EMISSION;
+		case GL_SHININESS:
+			return MATERIAL_SHININESS;
+		default:
+			return MATERIAL_COUNT;
+	}
+}
+
+//! Forget The Material
+/*! Marks every front material parameter unknown. */
+static void forgetMaterial()
+{
+	for (unsigned int i=0; i<MATERIAL_COUNT; i++)
+		materialKnown[i] = false;
+}
+
+//! Color Tracking Test
+/*! \param index a materialParams entry
+  \return true unless the parameter is known not to follow the current color through \c GL_COLOR_MATERIAL */
+static bool followsColor(unsigned int index)
+{
+	std::map<GLenum, bool>::iterator found = capabilities.find(GL_COLOR_MATERIAL);
+	if (found != capabilities.end() && !found->second)
+		return false;
+	if (!colorModeKnown)
+		return true;
+	switch (colorMode)
+	{
+		case GL_AMBIENT_AND_DIFFUSE:
+			return index == MATERIAL_AMBIENT || index == MATERIAL_DIFFUSE;
+		default:
+			return index == materialIndex(colorMode);
+	}
+}
+
+//! Set A Capability
+/*! Enables or disables a capability unless it is known to be in that state already.
+  \param cap the capability
+  \param enabled the state to put it in */
+static void setCapability(GLenum cap, bool enabled)
+{
+	std::map<GLenum, bool>::iterator found = capabilities.find(cap);
+	if (redundant(found != capabilities.end() && found->second == enabled))
+		return;
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	capabilities[cap] = enabled;
+	/* switching color tracking on copies the color in, and switching it off leaves the last color behind */
+	if (cap == GL_COLOR_MATERIAL)
+		forgetMaterial();
+}
+
+//! Enable A Capability
+/*! Equivalent to \c glEnable.
+  \param cap the capability */
+void GLState::enable(GLenum cap)
+{
+	setCapability(cap, true);
+}
+
+//! Disable A Capability
+/*! Equivalent to \c glDisable.
+  \param cap the capability */
+void GLState::disable(GLenum cap)
+{
+	setCapability(cap, false);
+}
+
+//! Capability Query
+/*! Equivalent to \c glIsEnabled, but only asks OpenGL the first time.
+  \param cap the capability
+  \return true if \a cap is enabled */
+bool GLState::isEnabled(GLenum cap)
+{
+	std::map<GLenum, bool>::iterator found = capabilities.find(cap);
+	if (found != capabilities.end())
+		return found->second;
+	bool enabled = glIsEnabled(cap);
+	capabilities[cap] = enabled;
+	return enabled;
+}
+
+//! Color Material Mode
+/*! Equivalent to \c glColorMaterial.
+  \param face the faces whose material tracks the current color
+  \param mode the material parameter that tracks it */
+void GLState::colorMaterial(GLenum face, GLenum mode)
+{
+	if (redundant(face == GL_FRONT && colorModeKnown && colorMode == mode))
+		return;
+	glColorMaterial(face, mode);
+	colorMode = mode;
+	colorModeKnown = face == GL_FRONT;
+	forgetMaterial();
+}
+
+//! Set A Material Parameter
+/*! Equivalent to \c glMaterialfv. Only the front material is shadowed; other faces always reach OpenGL.
+  \param face the faces to set
+  \param pname the parameter
+  \param params the value, four components for colors and one for the shininess */
+void GLState::material(GLenum face, GLenum pname, const GLfloat *params)
+{
+	unsigned int index = materialIndex(pname);
+	size_t size = (index == MATERIAL_SHININESS ? 1 : 4) * sizeof(GLfloat);
+	if (redundant(face == GL_FRONT && index < MATERIAL_COUNT && materialKnown[index] && !memcmp(frontMaterial[index], params, size)))
+		return;
+	glMaterialfv(face, pname, params);
+	if (index == MATERIAL_COUNT)
+	{
+		/* GL_AMBIENT_AND_DIFFUSE and the like */
+		forgetMaterial();
+		return;
+	}
+	materialKnown[index] = face == GL_FRONT && !followsColor(index);
+	memcpy(frontMaterial[index], params, size);
+}
+
+//! Set A Material Parameter
+/*! Equivalent to \c glMaterialf.
+  \param face the faces to set
+  \param pname the parameter
+  \param param the value */
+void GLState::material(GLenum face, GLenum pname, GLfloat param)
+{
+	material(face, pname, &param);
+}
+
+//! Bind A Texture
+/*! Equivalent to \c glBindTexture on the active texture unit. Only \c GL_TEXTURE_2D is shadowed.
+  \param target the texture target
+  \param name the texture */
+void GLState::bindTexture(GLenum target, GLuint name)
+{
+	if (redundant(target == GL_TEXTURE_2D && textureKnown && texture == name))
+		return;
+	glBindTexture(target, name);
+	if (target == GL_TEXTURE_2D)
+	{
+		texture = name;
+		textureKnown = true;
+	}
+}
+
+//! Delete A Texture
+/*! Equivalent to \c glDeleteTextures for one texture, which unbinds it if it is bound.
+  \param name the texture */
+void GLState::deleteTexture(GLuint name)
+{
+	glDeleteTextures(1, &name);
+	if (textureKnown && texture == name)
+		texture = 0;
+}
+
+//! Use A Program
+/*! Binds a shader program, or goes back to the fixed function pipeline, unless that is already in use. Programs must only be bound through here, and a program must be unbound with <tt>useProgram(NULL)</tt> before it is deleted.
+  \param newProgram the program, or NULL for the fixed function pipeline */
+void GLState::useProgram(QOpenGLShaderProgram *newProgram)
+{
+	if (redundant(program == newProgram))
+		return;
+	if (newProgram)
+		newProgram->bind();
+	else
+		program->release();
+	program = newProgram;
+}
+
+//! Invalidate The Cache
+/*! Forgets every piece of state, so the next call that sets it reaches OpenGL. Must be called when a new GL context is made current. No program is bound in a new context. */
+void GLState::invalidate()
+{
+	capabilities.clear();
+	forgetMaterial();
+	colorModeKnown = false;
+	textureKnown = false;
+	program = NULL;
+}
@@ -1,5 +1,7 @@
 #include "robot.h"
 #include <QColorDialog>
+#include <cmath>
+#include <cstring>
 
 //! Lighting constructor
 /*! Allocates needed objects and sets default parameters.
@@ -80,20 +82,16 @@ bool Lighting::enabled()
 }
 
 //! Enable Member
-/*! Flips the master switch and sets up lighting. */
+/*! Flips the master switch on; lighting follows on the next apply(). */
 void Lighting::enable()
 {
-	GLfloat ambient[] = {0.1, 0.1, 0.1, 1.0};
-	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambient);
-	glEnable(GL_LIGHTING);
 	lightSwitches.master = ON;
 }
 
 //! Disable Member
-/*! Flips the master switch and disables lighting. */
+/*! Flips the master switch off; lighting follows on the next apply(). */
 void Lighting::disable()
 {
-	glDisable(GL_LIGHTING);
 	lightSwitches.master = OFF;
 }
 
@@ -120,6 +118,29 @@ unsigned short Lighting::getType(unsigned short lightNum)
 	}
 }
 
+//! GetSwitch Accessor Method
+/*! Tells whether the specified light is switched on.
+  \param lightNum the light to check
+  \return true if the light is on, false if not */
+bool Lighting::getSwitch(unsigned short lightNum)
+{
+	switch (lightNum)
+	{
+		case LIGHT1:
+			return lightSwitches.light1 == ON;
+		case LIGHT2:
+			return lightSwitches.light2 == ON;
+		case LIGHT3:
+			return lightSwitches.light3 == ON;
+		case LIGHT4:
+			return lightSwitches.light4 == ON;
+		case LIGHT5:
+			return lightSwitches.light5 == ON;
+		default:
+			return false;
+	}
+}
+
 //! masterSwitch Slot
 /*! Slot for so the QWindow class can flip the master switch.
   \param state the new state of the master switch */
@@ -178,13 +199,13 @@ void Lighting::lightSwitch1(int state)
 		case Qt::Checked:
 		{
 			lightSwitches.light1 = ON;
-			lightSwitch(true, lightSwitches.type1, 1);
+			emit GLDraw();
 			break;
 		}
 		case Qt::Unchecked:
 		{
 			lightSwitches.light1 = OFF;
-			lightSwitch(false, lightSwitches.type1, 1);
+			emit GLDraw();
 			break;
 		}
 		default:
@@ -203,13 +224,13 @@ void Lighting::lightSwitch2(int state)
 		case Qt::Checked:
 		{
 			lightSwitches.light2 = ON;
-			lightSwitch(true, lightSwitches.type2, 2);
+			emit GLDraw();
 			break;
 		}
 		case Qt::Unchecked:
 		{
 			lightSwitches.light2 = OFF;
-			lightSwitch(false, lightSwitches.type2, 2);
+			emit GLDraw();
 			break;
 		}
 		default:
@@ -228,13 +249,13 @@ void Lighting::lightSwitch3(int state)
 		case Qt::Checked:
 		{
 			lightSwitches.light3 = ON;
-			lightSwitch(true, lightSwitches.type3, 3);
+			emit GLDraw();
 			break;
 		}
 		case Qt::Unchecked:
 		{
 			lightSwitches.light3 = OFF;
-			lightSwitch(false, lightSwitches.type3, 3);
+			emit GLDraw();
 			break;
 		}
 		default:
@@ -253,13 +274,13 @@ void Lighting::lightSwitch4(int state)
 		case Qt::Checked:
 		{
 			lightSwitches.light4 = ON;
-			lightSwitch(true, lightSwitches.type4, 4);
+			emit GLDraw();
 			break;
 		}
 		case Qt::Unchecked:
 		{
 			lightSwitches.light4 = OFF;
-			lightSwitch(false, lightSwitches.type4, 4);
+			emit GLDraw();
 			break;
 		}
 		default:
@@ -278,13 +299,13 @@ void Lighting::lightSwitch5(int state)
 		case Qt::Checked:
 		{
 			lightSwitches.light5 = ON;
-			lightSwitch(true, lightSwitches.type5, 5);
+			emit GLDraw();
 			break;
 		}
 		case Qt::Unchecked:
 		{
 			lightSwitches.light5 = OFF;
-			lightSwitch(false, lightSwitches.type5, 5);
+			emit GLDraw();
 			break;
 		}
 		default:
@@ -298,7 +319,7 @@ void Lighting::lightSwitch5(int state)
 void Lighting::setAngle1(double newAngle)
 {
 	angles[0] = newAngle;
-	setAngle(1);
+	emit GLDraw();
 }
 
 //! setAngle Slot 2
@@ -307,7 +328,7 @@ void Lighting::setAngle1(double newAngle)
 void Lighting::setAngle2(double newAngle)
 {
 	angles[1] = newAngle;
-	setAngle(2);
+	emit GLDraw();
 }
 
 //! setAngle Slot 3
@@ -316,7 +337,7 @@ void Lighting::setAngle2(double newAngle)
 void Lighting::setAngle3(double newAngle)
 {
 	angles[2] = newAngle;
-	setAngle(3);
+	emit GLDraw();
 }
 
 //! setAngle Slot 4
@@ -325,7 +346,7 @@ void Lighting::setAngle3(double newAngle)
 void Lighting::setAngle4(double newAngle)
 {
 	angles[3] = newAngle;
-	setAngle(4);
+	emit GLDraw();
 }
 
 //! setAngle Slot 5
@@ -334,7 +355,7 @@ void Lighting::setAngle4(double newAngle)
 void Lighting::setAngle5(double newAngle)
 {
 	angles[4] = newAngle;
-	setAngle(5);
+	emit GLDraw();
 }
 
 //! setType Slot 1
@@ -388,7 +409,7 @@ void Lighting::setType5(unsigned short type)
 void Lighting::setX1(double newX)
 {
 	coords[0][0] = newX;
-	repositionLight(lightSwitches.type1, 1);
+	emit GLDraw();
 }
 
 //! setX Slot 2
@@ -397,7 +418,7 @@ void Lighting::setX1(double newX)
 void Lighting::setX2(double newX)
 {
 	coords[1][0] = newX;
-	repositionLight(lightSwitches.type2, 2);
+	emit GLDraw();
 }
 
 //! setX Slot 3
@@ -406,7 +427,7 @@ void Lighting::setX2(double newX)
 void Lighting::setX3(double newX)
 {
 	coords[2][0] = newX;
-	repositionLight(lightSwitches.type3, 3);
+	emit GLDraw();
 }
 
 //! setX Slot 4
@@ -415,7 +436,7 @@ void Lighting::setX3(double newX)
 void Lighting::setX4(double newX)
 {
 	coords[3][0] = newX;
-	repositionLight(lightSwitches.type4, 4);
+	emit GLDraw();
 }
 
 //! setX Slot 5
@@ -424,7 +445,7 @@ void Lighting::setX4(double newX)
 void Lighting::setX5(double newX)
 {
 	coords[4][0] = newX;
-	repositionLight(lightSwitches.type5, 5);
+	emit GLDraw();
 }
 
 //! setY Slot 1
@@ -433,7 +454,7 @@ void Lighting::setX5(double newX)
 void Lighting::setY1(double newY)
 {
 	coords[0][1] = newY;
-	repositionLight(lightSwitches.type1, 1);
+	emit GLDraw();
 }
 
 //! setY Slot 2
@@ -442,7 +463,7 @@ void Lighting::setY1(double newY)
 void Lighting::setY2(double newY)
 {
 	coords[1][1] = newY;
-	repositionLight(lightSwitches.type2, 2);
+	emit GLDraw();
 }
 
 //! setY Slot 3
@@ -451,7 +472,7 @@ void Lighting::setY2(double newY)
 void Lighting::setY3(double newY)
 {
 	coords[2][1] = newY;
-	repositionLight(lightSwitches.type3, 3);
+	emit GLDraw();
 }
 
 //! setY Slot 4
@@ -460,7 +481,7 @@ void Lighting::setY3(double newY)
 void Lighting::setY4(double newY)
 {
 	coords[3][1] = newY;
-	repositionLight(lightSwitches.type4, 4);
+	emit GLDraw();
 }
 
 //! setY Slot 5
@@ -469,7 +490,7 @@ void Lighting::setY4(double newY)
 void Lighting::setY5(double newY)
 {
 	coords[4][1] = newY;
-	repositionLight(lightSwitches.type5, 5);
+	emit GLDraw();
 }
 
 //! setZ Slot 1
@@ -478,7 +499,7 @@ void Lighting::setY5(double newY)
 void Lighting::setZ1(double newZ)
 {
 	coords[0][2] = newZ;
-	repositionLight(lightSwitches.type1, 1);
+	emit GLDraw();
 }
 
 //! setZ Slot 2
@@ -487,7 +508,7 @@ void Lighting::setZ1(double newZ)
 void Lighting::setZ2(double newZ)
 {
 	coords[1][2] = newZ;
-	repositionLight(lightSwitches.type2, 2);
+	emit GLDraw();
 }
 
 //! setZ Slot 3
@@ -496,7 +517,7 @@ void Lighting::setZ2(double newZ)
 void Lighting::setZ3(double newZ)
 {
 	coords[2][2] = newZ;
-	repositionLight(lightSwitches.type3, 3);
+	emit GLDraw();
 }
 
 //! setZ Slot 4
@@ -505,7 +526,7 @@ void Lighting::setZ3(double newZ)
 void Lighting::setZ4(double newZ)
 {
 	coords[3][2] = newZ;
-	repositionLight(lightSwitches.type4, 4);
+	emit GLDraw();
 }
 
 //! setZ Slot 5
@@ -514,46 +535,6 @@ void Lighting::setZ4(double newZ)
 void Lighting::setZ5(double newZ)
 {
 	coords[4][2] = newZ;
-	repositionLight(lightSwitches.type5, 5);
-}
-
-//! lightSwitch Worker Function
-/*! Receives data from lightSwitchN() and does the actual work of flipping the light switch.
-  \param state the new state of the switch
-  \param type the current type of light
-  \param lightNum the light number */
-void Lighting::lightSwitch(bool state, unsigned short type, unsigned short lightNum)
-{
-	unsigned short GLNum = lightNum - 1;
-	if (state)
-	{
-		/* set light parameters */
-		if (type != SPOTLIGHT)
-			glLightfv(GL_LIGHT0 + GLNum, GL_POSITION, coords[GLNum]);
-		else
-		{
-			glLightf(GL_LIGHT0 + GLNum, GL_SPOT_CUTOFF, angles[GLNum]);
-			glLightfv(GL_LIGHT0 + GLNum, GL_SPOT_DIRECTION, coords[GLNum]);
-		}
-		glLightfv(GL_LIGHT0 + GLNum, GL_DIFFUSE, colors[GLNum]);
-		glLightfv(GL_LIGHT0 + GLNum, GL_SPECULAR, colors[GLNum]);
-		glEnable(GL_LIGHT0 + GLNum);
-	}
-	else
-	{
-		/* disable the light */
-		glDisable(GL_LIGHT0 + GLNum);
-	}
-	emit GLDraw();
-}
-
-//! setAngle Worker Function
-/*! Receives data from setAngleN() and does the actual work of changing the spotlight angle.
-  \param lightNum the light number */
-void Lighting::setAngle(unsigned short lightNum)
-{
-	unsigned short GLNum = lightNum - 1;
-	glLightf(GL_LIGHT0 + GLNum, GL_SPOT_CUTOFF, angles[GLNum]);
 	emit GLDraw();
 }
 
@@ -571,85 +552,146 @@ void Lighting::setColor(unsigned short lightNum)
 		colors[GLNum][1] = color.greenF();
 		colors[GLNum][2] = color.blueF();
 		colors[GLNum][3] = 1.0;
-		glLightfv(GL_LIGHT0 + GLNum, GL_DIFFUSE, colors[GLNum]);
-		glLightfv(GL_LIGHT0 + GLNum, GL_SPECULAR, colors[GLNum]);
 		emit GLDraw();
 	}
 }
 
 //! setType Worker Function
-/*! Receives data from setTypeN() and does the actual work of changing the light type.
+/*! Receives data from setTypeN() and does the actual work of changing the light type. Positional lights and spotlights are given \f$w=1\f$; spotlights always point toward the origin - for now.
   \param type the new light type
   \param lightNum the light number */
 void Lighting::setType(unsigned short type, unsigned short lightNum)
 {
-	unsigned short GLNum = lightNum - 1;
-	switch (type)
+	coords[lightNum - 1][3] = type == DIRECTIONAL ? 0.0 : 1.0;
+	emit GLDraw();
+}
+
+//! Apply Method
+/*! Hands every light to Shading, in eye coordinates under \a view, once per frame. The coordinates set through the slots are in world coordinates, so the lights stay put as the camera turns. The GL context must be current.
+  \param view the transform from world to eye coordinates
+  \param follow the light that follows the camera, or NONE
+  \param position the position of the camera in world coordinates, for \a follow */
+void Lighting::apply(const Mat4 &view, unsigned short follow, const GLfloat *position)
+{
+	LightBlock block;
+	/* zero the padding too, so unchanged lights compare equal */
+	memset(&block, 0, sizeof(LightBlock));
+	for (unsigned short i=0; i<5; i++)
 	{
-		case DIRECTIONAL:
+		LightUniforms &light = block.lights[i];
+		const GLfloat *p = (follow == i + 1 && position) ? position : coords[i];
+		for (unsigned short j=0; j<4; j++)
 		{
-			/* easy case */
-			coords[GLNum][3] = 0.0;
-			glLightfv(GL_LIGHT0 + GLNum, GL_POSITION, coords[0]);
-			emit GLDraw();
-			break;
+			light.position[j] = view.m[j] * p[0] + view.m[4+j] * p[1] + view.m[8+j] * p[2] + view.m[12+j] * p[3];
+			light.color[j] = colors[i][j];
 		}
-		case POSITIONAL:
+		light.spot[3] = -2.0;
+		if (getType(i + 1) == SPOTLIGHT)
 		{
-			/* we set spot light parameters back to default */
-			/* otherwise this stays a spot light */
-			coords[GLNum][3] = 1.0;
-			GLfloat direction[] = {0.0, 0.0, -1.0};
-			glLightfv(GL_LIGHT0 + GLNum, GL_POSITION, coords[GLNum]);
-			glLightf(GL_LIGHT0 + GLNum, GL_SPOT_CUTOFF, 180.0);
-			glLightfv(GL_LIGHT0 + GLNum, GL_SPOT_DIRECTION, direction);
-			emit GLDraw();
-			break;
+			/* toward the origin, rotated like the position */
+			GLfloat length = 0.0;
+			for (unsigned short j=0; j<3; j++)
+			{
+				light.spot[j] = -(view.m[j] * p[0] + view.m[4+j] * p[1] + view.m[8+j] * p[2]);
+				length += light.spot[j] * light.spot[j];
+			}
+			for (unsigned short j=0; j<3 && length>0.0; j++)
+				light.spot[j] /= sqrt(length);
+			light.spot[3] = cos(DEG2RAD(angles[i]));
 		}
-		case SPOTLIGHT:
+		if (getSwitch(i + 1))
+			block.enabled |= 1 << i;
+	}
+	for (unsigned short j=0; j<3; j++)
+		block.ambient[j] = 0.1;
+	block.ambient[3] = 1.0;
+	block.lighting = enabled();
+	/* local lights only reach the programs, so they are only binned for them */
+	if (!localLights.empty() && Shading::available())
+	{
+		eyeLights.resize(localLights.size());
+		for (unsigned int i=0; i<localLights.size(); i++)
 		{
-			/* the spot light always points toward the origin - for now */
-			coords[GLNum][3] = 1.0;
-			GLfloat direction[] = {-coords[GLNum][0], -coords[GLNum][1], -coords[GLNum][2]};
-			glLightfv(GL_LIGHT0 + GLNum, GL_POSITION, coords[GLNum]);
-			glLightf(GL_LIGHT0 + GLNum, GL_SPOT_CUTOFF, angles[GLNum]);
-			glLightfv(GL_LIGHT0 + GLNum, GL_SPOT_DIRECTION, direction);
-			emit GLDraw();
-			break;
+			const GLfloat *p = localLights[i].position;
+			for (unsigned short j=0; j<3; j++)
+				eyeLights[i].position[j] = view.m[j] * p[0] + view.m[4+j] * p[1] + view.m[8+j] * p[2] + view.m[12+j];
+			eyeLights[i].position[3] = p[3];
+			for (unsigned short j=0; j<4; j++)
+				eyeLights[i].color[j] = localLights[i].color[j];
 		}
-		default:
-			break;
+		clusters.bin(eyeLights);
+		Shading::setLocalLights(eyeLights, clusters);
+		for (unsigned short j=0; j<4; j++)
+			block.clusterScale[j] = clusters.getScale()[j];
+		block.clusterGrid[0] = CLUSTER_COLUMNS;
+		block.clusterGrid[1] = CLUSTER_ROWS;
+		block.clusterGrid[2] = CLUSTER_SLICES;
+		block.clusterGrid[3] = 1;
 	}
+	Shading::setLights(block);
+}
 
+//! Add A Local Light
+/*! Adds a small positional light that fades out to nothing at \a radius. Local lights are lit per fragment through LightClusters, so there may be many of them; they are only seen where Shading has uniform buffers.
+  \param position array containing the position in world coordinates in the form \f$(x,y,z)\f$
+  \param color array containing the color in the form \f$(r,g,b)\f$
+  \param radius the distance at which the light no longer reaches
+  \return the number of the new light, counting from 0 */
+unsigned int Lighting::addLocalLight(const GLfloat *position, const GLfloat *color, GLfloat radius)
+{
+	LocalLight light = {{position[0], position[1], position[2], radius}, {color[0], color[1], color[2], 1.0}};
+	localLights.push_back(light);
+	emit GLDraw();
+	return localLights.size() - 1;
 }
 
-//! repositionLight Worker Function
-/*! Receives data from setXN(), setYN(), or setZN() and does the actual work of moving the light around. This function is not called for the current light.
-  \param type the new light type
-  \param lightNum the light number */
-void Lighting::repositionLight(unsigned short type, unsigned short lightNum)
+//! Clear Local Lights
+/*! Removes every local light. */
+void Lighting::clearLocalLights()
 {
-	unsigned short GLNum = lightNum - 1;
-	switch (type)
+	localLights.clear();
+	emit GLDraw();
+}
+
+//! Local Light Count
+/*! \return the number of local lights */
+unsigned int Lighting::localLightCount()
+{
+	return localLights.size();
+}
+
+//! Scatter Local Lights
+/*! Replaces the local lights with \a count colored lights strewn just above the floor. The same count always gives the same lights.
+  \param count the number of lights
+  \param extent the half width of the square they are strewn over */
+void Lighting::scatterLocalLights(unsigned int count, GLfloat extent)
+{
+	/* a fixed linear congruential generator, so runs can be compared */
+	unsigned long seed = 12345;
+	GLfloat random[6];
+	localLights.clear();
+	for (unsigned int i=0; i<count; i++)
 	{
-		case DIRECTIONAL:
-		case POSITIONAL:
+		for (unsigned short j=0; j<6; j++)
 		{
-			/* move the light */
-			glLightfv(GL_LIGHT0 + GLNum, GL_POSITION, coords[GLNum]);
-			emit GLDraw();
-			break;
-		}
-		case SPOTLIGHT:
-		{
-			/* the spot light always points toward the origin - for now */
-			GLfloat direction[] = {-coords[GLNum][0], -coords[GLNum][1], -coords[GLNum][2]};
-			glLightfv(GL_LIGHT0 + GLNum, GL_POSITION, coords[GLNum]);
-			glLightfv(GL_LIGHT0 + GLNum, GL_SPOT_DIRECTION, direction);
-			emit GLDraw();
-			break;
+			seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+			random[j] = (GLfloat)seed / 0x7fffffff;
 		}
-		default:
-			break;
+		LocalLight light = {{extent * (2.0f * random[0] - 1.0f), extent * (2.0f * random[1] - 1.0f), 2.0f + 20.0f * random[2], 0.1f * extent + 0.1f * extent * random[3]},
+			{random[4], random[5], 1.0f - random[4], 1.0}};
+		localLights.push_back(light);
 	}
+	emit GLDraw();
+}
+
+//! Set Projection
+/*! Tells the light clusters the frustum and viewport they cut up. Call it whenever the view is resized.
+  \param projection the transform from the eye coordinates of apply() to clip coordinates
+  \param nearPlane the depth of the near clipping plane
+  \param farPlane the depth of the far clipping plane
+  \param width the width of the viewport in pixels
+  \param height the height of the viewport in pixels */
+void Lighting::setProjection(const Mat4 &projection, double nearPlane, double farPlane, int width, int height)
+{
+	clusters.setFrustum(projection, nearPlane, farPlane, width, height);
 }
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <iostream>
 #include <vector>
+#include "linalgstats.h"
+#include "mat4.h"
 using std::istream;
 using std::ostream;
 using std::vector;
@@ -14,21 +16,25 @@ using std::vector;
   A fully featured implentation of vectors in \f$\Re^n\f$ and \f$m\times n\f$ matrices. */
 
 //! Vector Library
-/*! Represents a vector in \f$\Re^n\f$. */
+/*! Represents a vector in \f$\Re^n\f$.
+
+  A Vector normally owns its storage, but the constructors taking a \a wrap flag can operate on someone else's array in place, such as a mapped file or buffer. The array must outlive the Vector. Operations that keep the dimension write through to it; anything that changes the dimension switches the Vector to storage of its own. Copies always own their storage. */
 class Vector
 {
 public:
 	Vector();
 	Vector(const Vector &other);
 	Vector(unsigned int a);
-	Vector(double *values,unsigned int a);
-	Vector(std::vector<double> &values);
+	Vector(double *values,unsigned int a,bool wrap=false);
+	Vector(std::vector<double> &values,bool wrap=false);
 	~Vector();
 	Vector &operator=(const Vector &other);
 	Vector operator+(Vector &other);
 	Vector operator-(Vector &other);
 	double operator*(Vector &other);
 	Vector operator%(Vector &other);
+	void cross(Vector &other,Vector &answer);
+	void axpy(double k,Vector &x);
 	Vector operator+=(Vector &other);
 	Vector operator-=(Vector &other);
 	Vector operator*=(double k);
@@ -49,18 +55,30 @@ public:
 	void set(double *values);
 	void set(std::vector<double> &values);
 	void set(unsigned int a,double v);
+	bool wraps();
 	void zero();
 private:
+	void allocate(unsigned int a);
+	void release();
 	//! Vector Array
 	/*! Array that stores the actual vector. */
 	double *vector;
 	//! Dimension
 	/*! Indicates the dimension of the vector. */
 	unsigned int n;
+	//! Wrap Flag
+	/*! True if vector belongs to the caller and must not be freed. */
+	bool wrapped;
 };
 
+struct MatrixCache;
+
 //! Matrix Library
-/*! Represents a \f$m\times n\f$ matrix. */
+/*! Represents a \f$m\times n\f$ matrix.
+
+  A Matrix remembers its LU factors, determinant and inverse until it is next modified, so asking an unchanged Matrix again costs \f$O(1)\f$. Every mutator bumps a version counter that the cached results are checked against. operator[]() counts as a mutator because the row it returns is writable; read with at() to keep the cache.
+
+  Like Vector, a Matrix can wrap the caller's rows instead of copying them. Only the array of row pointers is allocated. The rows must outlive the Matrix, and writes made to them behind the Matrix's back must be followed by touch(). */
 class Matrix
 {
 public:
@@ -68,8 +86,9 @@ public:
 	Matrix(const Matrix &other);
 	Matrix(unsigned int a,unsigned int b);
 	Matrix(double *values,unsigned int a,bool colOrder=true);
-	Matrix(double **values,unsigned int a,unsigned int b);
-	Matrix(std::vector< std::vector<double> > &values);
+	Matrix(double *values,unsigned int a,unsigned int b,bool wrap);
+	Matrix(double **values,unsigned int a,unsigned int b,bool wrap=false);
+	Matrix(std::vector< std::vector<double> > &values,bool wrap=false);
 	~Matrix();
 	Matrix &operator=(const Matrix &other);
 	Matrix operator+(Matrix &other);
@@ -86,12 +105,17 @@ public:
 	friend Matrix operator/(Matrix &m,double k);
 	friend ostream &operator<<(ostream &os,Matrix &m);
 	friend istream &operator>>(istream &is,Matrix &m);
+	friend class BandedMatrix;
 	double at(unsigned int a,unsigned int b);
 	double det();
 	void identity();
 	Matrix &inverse();
 	void load(double *values,unsigned int a,bool colOrder=true);
-	struct LUDecomposition &LU(Matrix &b=*(Matrix *)NULL);
+	struct LUDecomposition &LU();
+	struct LUDecomposition &LU(Matrix &b);
+	struct MixedSolution solveMixed(Matrix &b);
+	Matrix pinv(double tol=-1.0,double damping=0.0);
+	double cond();
 	void pivot(unsigned int a,unsigned int b,bool rowReduce=true);
 	void rref();
 	void set(double *values,bool colOrder=true);
@@ -100,14 +124,34 @@ public:
 	void set(unsigned int a,unsigned int b,double v);
 	void swapCol(unsigned int a,unsigned int b);
 	void swapRow(unsigned int a,unsigned int b);
+	struct SVDecomposition SVD();
 	Matrix &transpose();
 	double *values(bool colOrder=true);
+	unsigned long revision();
+	void touch();
+	bool wraps();
 private:
+	void allocate(unsigned int a,unsigned int b);
+	void wrap(unsigned int a,unsigned int b);
+	void release();
+	struct MatrixCache &cached();
+	struct MatrixCache &factored();
+	int decompose(struct LUDecomposition &LU,std::vector<unsigned int> &swaps);
+	const char *invert(Matrix &inv);
 	//! Matrix Array
 	/*! Array containing the actual matrix data. */
 	double **matrix;
 	unsigned int m; /*!< Number Of Rows */
 	unsigned int n; /*!< Number Of Columns */
+	//! Wrap Flag
+	/*! True if the rows belong to the caller and must not be freed. */
+	bool wrapped;
+	//! Version Counter
+	/*! Bumped by every modification. Starts at 1 so a cache entry stamped 0 is never current. */
+	unsigned long version;
+	//! Derived Results
+	/*! LU factors, determinant and inverse with the versions they were computed at. NULL until one is first needed; never shared by copies. */
+	struct MatrixCache *cache;
 };
 
 //! Linear Algebra Exception
@@ -122,7 +166,7 @@ public:
 	/*! Creates an exception with an error message \a msg.
 	 \param msg the error message */
 	LinAlgException(const char *msg) {
-		message = new char[strlen(msg)];
+		message = new char[strlen(msg) + 1];
 		strcpy(message, msg);
 	}
 	//! Destructor
@@ -156,4 +200,76 @@ struct LUDecomposition
 	bool exists;
 };
 
+//! Mixed Precision Solution
+/*! A struct that describes how Matrix::solveMixed() got its answer. */
+struct MixedSolution
+{
+	//! Refinement Rounds
+	/*! The most rounds of iterative refinement any right hand side needed. */
+	unsigned int rounds;
+	//! Relative Residual
+	/*! The largest \f$\|b-Ax\|_\infty/(\|A\|_\infty\|x\|_\infty)\f$ over the right hand sides. */
+	double residual;
+	//! Fallback Flag
+	/*! True if the Matrix was too ill conditioned for the single precision factors and had to be factored in double precision. */
+	bool fallback;
+};
+
+//! Singular Value Decomposition
+/*! A struct that contains the results of a thin singular value decomposition \f$A=USV^T\f$ of a \f$m\times n\f$ Matrix with \f$k=\min(m,n)\f$. */
+struct SVDecomposition
+{
+	Matrix U; /*!< \f$m\times k\f$ Left Singular Vectors */
+	Vector S; /*!< Singular Values In Decreasing Order */
+	Matrix V; /*!< \f$n\times k\f$ Right Singular Vectors */
+	//! Numerical Rank
+	/*! The number of singular values above \f$\max(m,n)s_1\epsilon\f$. */
+	unsigned int rank;
+};
+
+//! Banded Matrix
+/*! Represents a \f$n\times n\f$ matrix whose nonzero entries lie within \a lower diagonals below and \a upper diagonals above the main diagonal, such as the tridiagonal systems of cubic spline fits. Only the band is stored, so memory and solve() are \f$O(n)\f$ for a fixed bandwidth instead of \f$O(n^2)\f$ and \f$O(n^3)\f$.
+
+  solve() factors the matrix on first use and keeps the factors until the next set(), so refitting new data through the same knots only pays for the substitutions. Tridiagonal matrices that are strictly diagonally dominant by rows, which is what spline fits produce, are factored by the Thomas algorithm without pivoting; everything else gets a banded LU with partial pivoting. */
+class BandedMatrix
+{
+public:
+	BandedMatrix();
+	BandedMatrix(const BandedMatrix &other);
+	BandedMatrix(unsigned int a,unsigned int lower,unsigned int upper);
+	~BandedMatrix();
+	BandedMatrix &operator=(const BandedMatrix &other);
+	Matrix operator*(Matrix &X);
+	double at(unsigned int a,unsigned int b);
+	Matrix dense();
+	unsigned int lower();
+	void set(unsigned int a,unsigned int b,double v);
+	unsigned int size();
+	void solve(Matrix &B);
+	unsigned int upper();
+private:
+	void allocate(unsigned int a,unsigned int lower,unsigned int upper);
+	void release();
+	void factor();
+	//! Band Array
+	/*! Row \f$i\f$ holds columns \f$i-l\cdots i+u\f$, so element \f$(i,j)\f$ is <tt>band[i*(l+u+1)+j-i+l]</tt>. */
+	double *band;
+	//! LU Factors
+	/*! Same layout as band but \f$2l+u+1\f$ wide to make room for the fill in of row swaps. NULL until solve() first needs them. */
+	double *factors;
+	//! Pivot Rows
+	/*! The row swapped with row \f$i\f$ while factoring. */
+	unsigned int *pivots;
+	unsigned int n; /*!< Number Of Rows And Columns */
+	unsigned int l; /*!< Number Of Diagonals Below The Main Diagonal */
+	unsigned int u; /*!< Number Of Diagonals Above The Main Diagonal */
+	bool factored; /*!< True If factors Belongs To The Current Values */
+	bool thomas; /*!< True If factors Came From The Thomas Algorithm */
+};
+
+/* small matrix SVD: row major arrays, never allocates (see svd.cpp) */
+bool svdSmall(const double *a,unsigned int m,unsigned int n,double *u,double *s,double *v);
+unsigned int pinvSmall(const double *a,unsigned int m,unsigned int n,double *p,double tol=-1.0,double damping=0.0);
+double condSmall(const double *a,unsigned int m,unsigned int n);
+
 #endif
@@ -0,0 +1,23 @@
+# linear algebra microbenchmarks: qmake linalg_bench.pro && make
+# prints ns/op and allocations/op as JSON on stdout
+SOURCES = linalgbench.cpp \
+	  matrix.cpp \
+	  banded.cpp \
+	  mixed.cpp \
+	  svd.cpp \
+	  vector.cpp \
+	  simd.cpp \
+	  parallel.cpp \
+	  linalgstats.cpp
+HEADERS = linalg.h \
+	  linalgstats.h \
+	  simd.h \
+	  parallel.h \
+	  mat4.h
+TARGET = linalg_bench
+CONFIG += console release warn_on thread c++14
+CONFIG -= qt app_bundle
+# qmake CONFIG+=linalg_stats adds flops_per_op to the output
+linalg_stats {
+	DEFINES += LINALG_STATS
+}
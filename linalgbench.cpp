@@ -0,0 +1,471 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "linalg.h"
+#include "parallel.h"
+#include "simd.h"
+
+/*! \file linalgbench.cpp
+  \brief Linear Algebra Microbenchmarks
+
+  Standalone program (the \c linalg_bench target) that times the Matrix and Vector operations across sizes \f$2,4,\cdots,2048\f$ and prints the results as JSON. Each result has the mean wall clock time and the mean number of heap allocations per operation.
+
+  The solvers also report the relative backward error \f$\|b-Ax\|_\infty/(\|A\|_\infty\|x\|_\infty)\f$ of their answer as \c residual, so \c mixed_solve can be compared with \c lu_solve on accuracy as well as time.
+
+  Sizes above \c MATRIX_LIMIT only run the Vector and banded operations, so <tt>--max-size 67108864</tt> times the parallel Vector paths without building enormous matrices. <tt>--threads</tt> sets LinAlgThreads::setCount().
+
+  Before timing anything, every SIMD kernel the processor can run is checked against the portable one with simdCheck(), at sizes that are not multiples of the register width; the benchmark refuses to run if any disagree.
+
+  Usage: <tt>linalg_bench [--min-size n] [--max-size n] [--min-time ms] [--ops op1,op2,...] [--threads n]</tt> */
+
+//! Matrix Size Limit
+/*! Largest size the matrix operands are built for. */
+#define MATRIX_LIMIT 2048
+
+//! Banded Size Limit
+/*! Largest size the banded operands are built for. */
+#define BANDED_LIMIT 1048576
+
+//! Banded Right Hand Sides
+/*! Number of right hand sides solved at once, like the joints of a spline fit. */
+#define BANDED_RHS 6
+
+//! Allocation Counter
+/*! Number of calls to operator new since the program started. */
+static unsigned long allocations=0;
+
+//! Benchmark Sink
+/*! Results are folded into this so the optimizer can't discard the work being timed. */
+static volatile double sink=0.0;
+
+/* replace the global allocation functions so every heap allocation is counted */
+void *operator new(std::size_t size)
+{
+	allocations++;
+	void *p=malloc(size?size:1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size)
+{
+	allocations++;
+	void *p=malloc(size?size:1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p,std::size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p,std::size_t) noexcept
+{
+	free(p);
+}
+
+//! Benchmark Options
+/*! Command line options shared by every benchmark. */
+struct options
+{
+	unsigned int minSize; /*!< Smallest Size To Run */
+	unsigned int maxSize; /*!< Largest Size To Run */
+	double minTime; /*!< Minimum Time Per Measurement In Seconds */
+	std::string ops; /*!< Comma Separated Operations To Run; Empty Runs All */
+	unsigned int threads; /*!< Thread Count; 0 Keeps The Default */
+};
+
+//! Benchmark Fixture
+/*! Operands shared by the benchmarks of one size. The square matrices are diagonally dominant so det(), inverse() and LU() never hit a zero pivot. */
+struct fixture
+{
+	unsigned int n; /*!< Size */
+	Matrix A; /*!< First Square Operand */
+	Matrix B; /*!< Second Square Operand */
+	Matrix b; /*!< Right Hand Side */
+	double *rhs; /*!< Pristine Copy Of The Right Hand Side */
+	Vector u; /*!< First Vector Operand */
+	Vector v; /*!< Second Vector Operand */
+	Vector w; /*!< Vector Updated In Place */
+	BandedMatrix T; /*!< Diagonally Dominant Tridiagonal Operand */
+	BandedMatrix P; /*!< Pentadiagonal Operand That Needs Pivoting */
+	Matrix knots; /*!< Right Hand Sides Of The Banded Solves */
+	Matrix X; /*!< Banded Solutions */
+	std::string text; /*!< A Printed In Text Form */
+};
+
+//! Random Value
+/*! \return a uniformly distributed value in \f$[-1,1]\f$ */
+static double random1()
+{
+	return 2.0*rand()/RAND_MAX-1.0;
+}
+
+//! Build A Fixture
+/*! Fills a fixture with random operands of size \a n.
+  \param f the fixture to fill
+  \param n the size */
+static void setup(fixture &f,unsigned int n)
+{
+	f.n=n;
+	f.u=Vector(n);
+	f.v=Vector(n);
+	f.w=Vector(n);
+	f.rhs=NULL;
+	for (unsigned int i=0;i<n;i++)
+	{
+		f.u.set(i,random1());
+		f.v.set(i,random1());
+		f.w.set(i,random1());
+	}
+	if (n>BANDED_LIMIT)
+		return;
+	/* a cubic spline system through random knot spacings */
+	f.T=BandedMatrix(n,1,1);
+	f.P=BandedMatrix(n,2,2);
+	f.knots=Matrix(n,BANDED_RHS);
+	for (unsigned int i=0;i<n;i++)
+	{
+		double h=1.5+random1();
+		f.T.set(i,i,4.0*h);
+		if (i>0)
+			f.T.set(i,i-1,h);
+		if (i+1<n)
+			f.T.set(i,i+1,h);
+		for (unsigned int j=i>2?i-2:0;j<=i+2&&j<n;j++)
+			f.P.set(i,j,random1());
+		for (unsigned int j=0;j<BANDED_RHS;j++)
+			f.knots.set(i,j,random1());
+	}
+	if (n>MATRIX_LIMIT)
+		return;
+	f.A=Matrix(n,n);
+	f.B=Matrix(n,n);
+	f.b=Matrix(n,1);
+	f.rhs=new double[n];
+	for (unsigned int i=0;i<n;i++)
+	{
+		for (unsigned int j=0;j<n;j++)
+		{
+			f.A.set(i,j,random1());
+			f.B.set(i,j,random1());
+		}
+		f.A.set(i,i,f.A.at(i,i)+n);
+		f.B.set(i,i,f.B.at(i,i)+n);
+		f.rhs[i]=random1();
+		f.b.set(i,0,f.rhs[i]);
+	}
+	std::ostringstream os;
+	os<<f.A;
+	f.text=os.str();
+}
+
+//! Tear Down A Fixture
+/*! Frees what setup() allocated outside of the fixture's members.
+  \param f the fixture */
+static void teardown(fixture &f)
+{
+	delete[] f.rhs;
+}
+
+//! Invalidate Cached Results
+/*! Rewrites one element of f.A unchanged, which counts as a modification, so the next det(), inverse() or LU() recomputes instead of answering from the cache.
+  \param f the fixture */
+static void modify(fixture &f)
+{
+	f.A.set(0,0,f.A.at(0,0));
+}
+
+/* the benchmarked operations; each performs exactly one operation */
+static void construct(fixture &f) { Matrix M(f.n,f.n); sink=sink+M.at(0,0); }
+static void copy(fixture &f) { Matrix M(f.A); sink=sink+M.at(0,0); }
+static void add(fixture &f) { Matrix M=f.A+f.B; sink=sink+M.at(0,0); }
+static void multiply(fixture &f) { Matrix M=f.A*f.B; sink=sink+M.at(0,0); }
+static void det(fixture &f) { modify(f); sink=sink+f.A.det(); }
+static void detCached(fixture &f) { sink=sink+f.A.det(); }
+static void inverse(fixture &f) { modify(f); sink=sink+f.A.inverse().at(0,0); }
+static void inverseCached(fixture &f) { sink=sink+f.A.inverse().at(0,0); }
+static void transpose(fixture &f) { Matrix &M=f.A.transpose(); sink=sink+M.at(0,0); delete &M; }
+static void svd(fixture &f) { SVDecomposition S=f.A.SVD(); sink=sink+S.S[0]; }
+static void dot(fixture &f) { sink=sink+f.u*f.v; }
+static void norm(fixture &f) { sink=sink+f.u.norm(); }
+static void normalize(fixture &f) { f.w.normalize(); sink=sink+f.w[0]; }
+static void vectorAdd(fixture &f) { Vector w=f.u+f.v; sink=sink+w[0]; }
+static void axpy(fixture &f) { f.w.axpy(0.5,f.v); sink=sink+f.w[0]; }
+static void angle(fixture &f) { sink=sink+f.u.angle(f.v); }
+static void cross(fixture &f) { Vector w=f.u%f.v; sink=sink+w[0]; }
+static void crossInto(fixture &f) { f.u.cross(f.v,f.w); sink=sink+f.w[0]; }
+
+static void solve(fixture &f)
+{
+	/* LU(b) overwrites b with the solution, so restore it first */
+	for (unsigned int i=0;i<f.n;i++)
+		f.b.set(i,0,f.rhs[i]);
+	modify(f);
+	LUDecomposition &LU=f.A.LU(f.b);
+	sink=sink+f.b.at(0,0);
+	delete &LU;
+}
+
+static void mixed(fixture &f)
+{
+	for (unsigned int i=0;i<f.n;i++)
+		f.b.set(i,0,f.rhs[i]);
+	MixedSolution S=f.A.solveMixed(f.b);
+	sink=sink+f.b.at(0,0)+S.rounds;
+}
+
+static void tridiagonal(fixture &f)
+{
+	/* set() discards the factors, so this times factoring and solving */
+	f.X=f.knots;
+	f.T.set(0,0,f.T.at(0,0));
+	f.T.solve(f.X);
+	sink=sink+f.X.at(0,0);
+}
+
+static void banded(fixture &f)
+{
+	f.X=f.knots;
+	f.P.set(0,0,f.P.at(0,0));
+	f.P.solve(f.X);
+	sink=sink+f.X.at(0,0);
+}
+
+static void resolve(fixture &f)
+{
+	/* same as solve() but with the factors of f.A already cached */
+	for (unsigned int i=0;i<f.n;i++)
+		f.b.set(i,0,f.rhs[i]);
+	LUDecomposition &LU=f.A.LU(f.b);
+	sink=sink+f.b.at(0,0);
+	delete &LU;
+}
+
+//! Solution Accuracy
+/*! Checks f.b against the pristine right hand side after a solve.
+  \param f the fixture
+  \return \f$\|b-Ax\|_\infty/(\|A\|_\infty\|x\|_\infty)\f$ */
+static double residual(fixture &f)
+{
+	double r=0.0,a=0.0,x=0.0;
+	for (unsigned int i=0;i<f.n;i++)
+	{
+		double s=f.rhs[i],row=0.0;
+		for (unsigned int j=0;j<f.n;j++)
+		{
+			s-=f.A.at(i,j)*f.b.at(j,0);
+			row+=fabs(f.A.at(i,j));
+		}
+		r=fmax(r,fabs(s));
+		a=fmax(a,row);
+		x=fmax(x,fabs(f.b.at(i,0)));
+	}
+	return r/(a*x);
+}
+
+static void textIO(fixture &f)
+{
+	std::ostringstream os;
+	os<<f.A;
+	std::istringstream is(f.text);
+	Matrix M(f.n,f.n);
+	is>>M;
+	sink=sink+M.at(0,0)+os.str().size();
+}
+
+//! Benchmark Table Entry
+/*! Associates an operation name with the function that runs it. */
+struct benchmark
+{
+	const char *name; /*!< Operation Name */
+	void (*run)(fixture &f); /*!< Operation */
+	//! Fixed Size
+	/*! If nonzero, the operation only exists at this size and is run once at it instead of across the size range. */
+	unsigned int size;
+	//! Size Limit
+	/*! If nonzero, the largest size the operation's operands are built for: \c MATRIX_LIMIT or \c BANDED_LIMIT. */
+	unsigned int limit;
+	//! Accuracy Check
+	/*! If not NULL, measures the accuracy of the last run for the \c residual field. */
+	double (*check)(fixture &f);
+};
+
+//! Benchmark Table
+/*! All operations in the order they are run. */
+static const benchmark benchmarks[]=
+{
+	{"construct",construct,0,MATRIX_LIMIT,NULL},
+	{"copy",copy,0,MATRIX_LIMIT,NULL},
+	{"add",add,0,MATRIX_LIMIT,NULL},
+	{"multiply",multiply,0,MATRIX_LIMIT,NULL},
+	{"det",det,0,MATRIX_LIMIT,NULL},
+	{"det_cached",detCached,0,MATRIX_LIMIT,NULL},
+	{"inverse",inverse,0,MATRIX_LIMIT,NULL},
+	{"inverse_cached",inverseCached,0,MATRIX_LIMIT,NULL},
+	{"lu_solve",solve,0,MATRIX_LIMIT,residual},
+	{"mixed_solve",mixed,0,MATRIX_LIMIT,residual},
+	{"lu_resolve",resolve,0,MATRIX_LIMIT,NULL},
+	{"transpose",transpose,0,MATRIX_LIMIT,NULL},
+	{"svd",svd,0,MATRIX_LIMIT,NULL},
+	{"tridiagonal_solve",tridiagonal,0,BANDED_LIMIT,NULL},
+	{"banded_solve",banded,0,BANDED_LIMIT,NULL},
+	{"dot",dot,0,0,NULL},
+	{"norm",norm,0,0,NULL},
+	{"normalize",normalize,0,0,NULL},
+	{"vector_add",vectorAdd,0,0,NULL},
+	{"axpy",axpy,0,0,NULL},
+	{"angle",angle,0,0,NULL},
+	{"cross",cross,3,0,NULL},
+	{"cross_into",crossInto,3,0,NULL},
+	{"text_io",textIO,0,MATRIX_LIMIT,NULL}
+};
+
+//! Operation Filter
+/*! Checks whether \a name was selected with --ops.
+  \param opts the options
+  \param name the operation name
+  \return true if the operation should run */
+static bool selected(const options &opts,const char *name)
+{
+	if (opts.ops.empty())
+		return true;
+	std::string list=","+opts.ops+",";
+	return list.find(std::string(",")+name+",")!=std::string::npos;
+}
+
+//! Time One Operation
+/*! Runs \a b on \a f, doubling the iteration count until the measurement lasts at least opts.minTime, then prints one JSON object.
+  \param opts the options
+  \param b the benchmark
+  \param f the fixture
+  \param first true if this is the first result printed */
+static void measure(const options &opts,const benchmark &b,fixture &f,bool first)
+{
+	typedef std::chrono::steady_clock clock;
+	unsigned long iterations=1,allocs=0,flops=0;
+	double elapsed=0.0;
+	b.run(f);
+	for (;;)
+	{
+		unsigned long before=allocations;
+		LinAlgScope stats=LinAlgStats::scope(b.name);
+		clock::time_point start=clock::now();
+		for (unsigned long i=0;i<iterations;i++)
+			b.run(f);
+		elapsed=std::chrono::duration<double>(clock::now()-start).count();
+		allocs=allocations-before;
+		LinAlgCounters counted=stats.counters();
+		flops=0;
+		for (unsigned int i=0;i<OP_COUNT;i++)
+			flops+=counted.flops[i];
+		if (elapsed>=opts.minTime)
+			break;
+		iterations*=2;
+	}
+	printf("%s\n    {\"op\": \"%s\", \"n\": %u, \"iterations\": %lu, \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f",
+		first?"":",",b.name,f.n,iterations,elapsed*1e9/iterations,(double)allocs/iterations);
+	if (LinAlgStats::enabled())
+		printf(", \"flops_per_op\": %.1f",(double)flops/iterations);
+	if (b.check)
+		printf(", \"residual\": %.3g",b.check(f));
+	printf("}");
+	fflush(stdout);
+}
+
+int main(int argc,char **argv)
+{
+	options opts;
+	opts.minSize=2;
+	opts.maxSize=2048;
+	opts.minTime=0.1;
+	opts.threads=0;
+	for (int i=1;i<argc;i++)
+	{
+		if (!strcmp(argv[i],"--min-size")&&i+1<argc)
+			opts.minSize=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"--max-size")&&i+1<argc)
+			opts.maxSize=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"--min-time")&&i+1<argc)
+			opts.minTime=atof(argv[++i])/1000.0;
+		else if (!strcmp(argv[i],"--ops")&&i+1<argc)
+			opts.ops=argv[++i];
+		else if (!strcmp(argv[i],"--threads")&&i+1<argc)
+			opts.threads=atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr,"usage: %s [--min-size n] [--max-size n] [--min-time ms] [--ops op1,op2,...] [--threads n]\n",argv[0]);
+			return 1;
+		}
+	}
+	if (opts.minSize<1)
+		opts.minSize=1;
+	srand(1);
+	bool first=true;
+	const unsigned int count=sizeof(benchmarks)/sizeof(benchmarks[0]);
+	if (opts.threads)
+		LinAlgThreads::setCount(opts.threads);
+	/* timings of wrong kernels are worthless */
+	const char *failure=simdCheck();
+	if (failure)
+	{
+		fprintf(stderr,"SIMD kernels disagree with the portable ones: %s\n",failure);
+		return 1;
+	}
+	printf("{\n  \"benchmark\": \"linalg\",\n  \"threads\": %u,\n  \"simd\": \"%s\",\n  \"simd_check\": \"ok\",\n  \"results\": [",LinAlgThreads::count(),simdPath());
+	try
+	{
+		for (unsigned int n=opts.minSize;n<=opts.maxSize;n*=2)
+		{
+			fixture f;
+			setup(f,n);
+			for (unsigned int i=0;i<count;i++)
+			{
+				if (benchmarks[i].size||!selected(opts,benchmarks[i].name))
+					continue;
+				if (benchmarks[i].limit&&n>benchmarks[i].limit)
+					continue;
+				measure(opts,benchmarks[i],f,first);
+				first=false;
+			}
+			teardown(f);
+		}
+		/* operations such as the cross product only exist at one size */
+		for (unsigned int i=0;i<count;i++)
+		{
+			if (!benchmarks[i].size||!selected(opts,benchmarks[i].name))
+				continue;
+			fixture f;
+			setup(f,benchmarks[i].size);
+			measure(opts,benchmarks[i],f,first);
+			first=false;
+			teardown(f);
+		}
+	}
+	catch (LinAlgException &e)
+	{
+		fprintf(stderr,"Exception: %s\n",e.what());
+		return 1;
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
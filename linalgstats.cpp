@@ -0,0 +1,211 @@
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "linalgstats.h"
+
+/*! \file linalgstats.cpp
+  \brief Linear Algebra Instrumentation
+
+  Storage for the counters declared in linalgstats.h. */
+
+#ifdef LINALG_STATS
+
+//! Operation Names
+/*! Names used by LinAlgStats::report(), indexed by linalgOps. */
+static const char *opNames[OP_COUNT]={"add","subtract","multiply","scale","det","inverse","lu","pivot","svd","dot","cross","norm","normalize","banded"};
+
+//! Global Counters
+/*! Running totals since the program started or since the last LinAlgStats::reset(). */
+static LinAlgCounters totals;
+
+//! Scope Totals
+/*! Per scope name accumulation of counters. */
+struct scopeTotals
+{
+	unsigned long calls; /*!< Number Of Times The Scope Was Entered */
+	LinAlgCounters sum; /*!< Accumulated Counters; peakLiveBytes Is The Largest Seen */
+};
+
+//! Scope Table
+/*! Totals for every scope name that has been closed.
+  \return the table */
+static std::map<std::string,scopeTotals> &scopes()
+{
+	static std::map<std::string,scopeTotals> table;
+	return table;
+}
+
+//! Scope Constructor
+/*! Snapshots the counters and starts a fresh high water mark for this scope.
+  \param scopeName the name to report under */
+LinAlgScope::LinAlgScope(const char *scopeName)
+{
+	name=scopeName;
+	start=totals;
+	outerPeak=totals.peakLiveBytes;
+	totals.peakLiveBytes=totals.liveBytes;
+	active=true;
+}
+
+//! Move Constructor
+/*! Transfers the scope from \a other, which will no longer report.
+  \param other the scope to take over */
+LinAlgScope::LinAlgScope(LinAlgScope &&other)
+{
+	name=other.name;
+	start=other.start;
+	outerPeak=other.outerPeak;
+	active=other.active;
+	other.active=false;
+}
+
+//! Scope Destructor
+/*! Adds the counters accumulated inside the scope to the totals for its name and restores the enclosing high water mark. */
+LinAlgScope::~LinAlgScope()
+{
+	if (!active)
+		return;
+	LinAlgCounters delta=counters();
+	scopeTotals &entry=scopes()[name];
+	entry.calls++;
+	entry.sum.constructions+=delta.constructions;
+	entry.sum.copies+=delta.copies;
+	entry.sum.allocations+=delta.allocations;
+	entry.sum.bytesAllocated+=delta.bytesAllocated;
+	entry.sum.liveBytes+=delta.liveBytes;
+	if (delta.peakLiveBytes>entry.sum.peakLiveBytes)
+		entry.sum.peakLiveBytes=delta.peakLiveBytes;
+	for (unsigned int i=0;i<OP_COUNT;i++)
+		entry.sum.flops[i]+=delta.flops[i];
+	if (outerPeak>totals.peakLiveBytes)
+		totals.peakLiveBytes=outerPeak;
+}
+
+//! Scope Counters
+/*! Counters accumulated since the scope was opened. liveBytes is the net change in live storage and peakLiveBytes is the high water mark above the live storage at the start of the scope.
+  \return the counters */
+LinAlgCounters LinAlgScope::counters()
+{
+	LinAlgCounters delta;
+	delta.constructions=totals.constructions-start.constructions;
+	delta.copies=totals.copies-start.copies;
+	delta.allocations=totals.allocations-start.allocations;
+	delta.bytesAllocated=totals.bytesAllocated-start.bytesAllocated;
+	delta.liveBytes=totals.liveBytes-start.liveBytes;
+	delta.peakLiveBytes=totals.peakLiveBytes-start.liveBytes;
+	for (unsigned int i=0;i<OP_COUNT;i++)
+		delta.flops[i]=totals.flops[i]-start.flops[i];
+	return delta;
+}
+
+//! Construction Hook
+/*! Called by every Matrix and Vector constructor. */
+void LinAlgStats::construct()
+{
+	totals.constructions++;
+}
+
+//! Copy Hook
+/*! Called by copy constructors and assignment operators. */
+void LinAlgStats::copy()
+{
+	totals.copies++;
+}
+
+//! Allocation Hook
+/*! Called whenever Matrix or Vector storage is allocated.
+  \param bytes the size of the allocation */
+void LinAlgStats::allocate(size_t bytes)
+{
+	totals.allocations++;
+	totals.bytesAllocated+=bytes;
+	totals.liveBytes+=bytes;
+	if (totals.liveBytes>totals.peakLiveBytes)
+		totals.peakLiveBytes=totals.liveBytes;
+}
+
+//! Deallocation Hook
+/*! Called whenever Matrix or Vector storage is freed.
+  \param bytes the size of the allocation being freed */
+void LinAlgStats::release(size_t bytes)
+{
+	totals.liveBytes-=bytes;
+}
+
+//! FLOP Hook
+/*! Charges \a count floating point operations to \a op.
+  \param op the operation, one of linalgOps
+  \param count the number of floating point operations */
+void LinAlgStats::flops(unsigned int op,unsigned long count)
+{
+	totals.flops[op]+=count;
+}
+
+#endif
+
+//! Statistics Flag
+/*! Tells whether the library was built with \c LINALG_STATS.
+  \return true if counters are being collected */
+bool LinAlgStats::enabled()
+{
+#ifdef LINALG_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+//! Counter Snapshot
+/*! Returns the global counters.
+  \return the counters; all zero if statistics are disabled */
+LinAlgCounters LinAlgStats::snapshot()
+{
+#ifdef LINALG_STATS
+	return totals;
+#else
+	LinAlgCounters c={};
+	return c;
+#endif
+}
+
+//! Print Statistics
+/*! Prints the global counters followed by the per call averages of every scope.
+  \param os the output stream */
+void LinAlgStats::report(std::ostream &os)
+{
+#ifdef LINALG_STATS
+	std::map<std::string,scopeTotals>::iterator it;
+	os<<"linalg: "<<totals.constructions<<" constructions, "<<totals.copies<<" copies, "
+	  <<totals.bytesAllocated<<" bytes allocated, "<<totals.liveBytes<<" live, "<<totals.peakLiveBytes<<" peak"<<std::endl;
+	for (it=scopes().begin();it!=scopes().end();++it)
+	{
+		const scopeTotals &entry=it->second;
+		unsigned long flops=0;
+		for (unsigned int i=0;i<OP_COUNT;i++)
+			flops+=entry.sum.flops[i];
+		os<<"  "<<it->first<<": "<<entry.calls<<" calls; per call "
+		  <<(double)entry.sum.constructions/entry.calls<<" constructions, "
+		  <<(double)entry.sum.copies/entry.calls<<" copies, "
+		  <<(double)entry.sum.bytesAllocated/entry.calls<<" bytes, "
+		  <<(double)flops/entry.calls<<" flops; peak "<<entry.sum.peakLiveBytes<<" bytes"<<std::endl;
+		for (unsigned int i=0;i<OP_COUNT;i++)
+			if (entry.sum.flops[i])
+				os<<"    "<<opNames[i]<<": "<<(double)entry.sum.flops[i]/entry.calls<<" flops"<<std::endl;
+	}
+#else
+	os<<"linalg: statistics disabled (build with CONFIG+=linalg_stats)"<<std::endl;
+#endif
+}
+
+//! Reset Statistics
+/*! Zeroes the global counters and forgets all scope totals. Live byte counts are kept since the storage they describe still exists. */
+void LinAlgStats::reset()
+{
+#ifdef LINALG_STATS
+	long live=totals.liveBytes;
+	memset(&totals,0,sizeof(totals));
+	totals.liveBytes=totals.peakLiveBytes=live;
+	scopes().clear();
+#endif
+}
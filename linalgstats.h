@@ -0,0 +1,112 @@
+#ifndef LINALGSTATS_H
+#define LINALGSTATS_H
+
+#include <cstddef>
+#include <iostream>
+
+/*! \file linalgstats.h
+  \brief Linear Algebra Instrumentation
+
+  Optional counters for constructions, copies, heap traffic and floating point operations in Matrix and Vector. The counters are only compiled in when \c LINALG_STATS is defined (<tt>qmake CONFIG+=linalg_stats</tt>); otherwise every hook expands to nothing and LinAlgScope is an empty object, so instrumented call sites cost nothing in normal builds.
+
+  Typical use is to attribute cost to a piece of code:
+  \code
+  LinAlgScope stats=LinAlgStats::scope("grabCube");
+  \endcode
+  Everything counted until \c stats goes out of scope is added to the \c grabCube totals printed by LinAlgStats::report(). The counters are not thread safe; only instrument code that runs on one thread. */
+
+//! Instrumented Operations
+/*! Enumeration of the operations FLOPs are counted for. FLOPs are charged to the operation that performs the arithmetic, so det() shows up partly under OP_LU and OP_PIVOT. */
+enum linalgOps {OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_SCALE, OP_DET, OP_INVERSE, OP_LU, OP_PIVOT, OP_SVD, OP_DOT, OP_CROSS, OP_NORM, OP_NORMALIZE, OP_BANDED, OP_COUNT};
+
+//! Linear Algebra Counters
+/*! A snapshot of the counters. As a scope result, every field is the amount accumulated inside the scope and peakLiveBytes is the high water mark reached inside it. */
+struct LinAlgCounters
+{
+	unsigned long constructions; /*!< Matrix And Vector Constructions */
+	unsigned long copies; /*!< Copy Constructions And Assignments */
+	unsigned long allocations; /*!< Storage Allocations */
+	unsigned long bytesAllocated; /*!< Bytes Of Storage Allocated */
+	long liveBytes; /*!< Bytes Of Storage Currently Allocated */
+	long peakLiveBytes; /*!< High Water Mark Of liveBytes */
+	unsigned long flops[OP_COUNT]; /*!< Floating Point Operations By Operation */
+};
+
+//! Statistics Scope
+/*! RAII handle returned by LinAlgStats::scope(). On destruction the counters accumulated since construction are added to the totals of the scope's name. */
+class LinAlgScope
+{
+public:
+#ifdef LINALG_STATS
+	LinAlgScope(const char *scopeName);
+	LinAlgScope(LinAlgScope &&other);
+	~LinAlgScope();
+	LinAlgCounters counters();
+private:
+	LinAlgScope(const LinAlgScope &other);
+	LinAlgScope &operator=(const LinAlgScope &other);
+	//! Scope Name
+	/*! Name the counters are reported under. Must outlive the scope; string literals are intended. */
+	const char *name;
+	//! Starting Counters
+	/*! Snapshot of the global counters when the scope was opened. */
+	LinAlgCounters start;
+	//! Enclosing Peak
+	/*! High water mark of the enclosing scope, restored when this scope closes. */
+	long outerPeak;
+	//! Active Flag
+	/*! False once the scope has been moved from; only the active handle reports. */
+	bool active;
+#else
+	//! Scope Constructor
+	/*! Does nothing since statistics are disabled. */
+	LinAlgScope(const char *) {}
+	//! Scope Destructor
+	/*! Does nothing; declared so that an unused scope handle doesn't draw a warning. */
+	~LinAlgScope() {}
+	//! Scope Counters
+	/*! Statistics are disabled so this is always zero.
+	  \return zeroed counters */
+	LinAlgCounters counters() {LinAlgCounters c={}; return c;}
+#endif
+};
+
+//! Linear Algebra Statistics
+/*! Static interface to the Matrix and Vector counters. */
+class LinAlgStats
+{
+public:
+	//! Open A Scope
+	/*! Starts attributing counters to \a name until the returned handle is destroyed.
+	  \param name the name to report under
+	  \return the scope handle */
+	static LinAlgScope scope(const char *name) {return LinAlgScope(name);}
+	static bool enabled();
+	static LinAlgCounters snapshot();
+	static void report(std::ostream &os);
+	static void reset();
+#ifdef LINALG_STATS
+	static void construct();
+	static void copy();
+	static void allocate(size_t bytes);
+	static void release(size_t bytes);
+	static void flops(unsigned int op,unsigned long count);
+#endif
+};
+
+/* hooks used by Matrix and Vector; these vanish unless LINALG_STATS is defined */
+#ifdef LINALG_STATS
+#define LINALG_CONSTRUCT() LinAlgStats::construct()
+#define LINALG_COPY() LinAlgStats::copy()
+#define LINALG_ALLOC(bytes) LinAlgStats::allocate(bytes)
+#define LINALG_FREE(bytes) LinAlgStats::release(bytes)
+#define LINALG_FLOPS(op,count) LinAlgStats::flops(op,count)
+#else
+#define LINALG_CONSTRUCT() ((void)0)
+#define LINALG_COPY() ((void)0)
+#define LINALG_ALLOC(bytes) ((void)(bytes))
+#define LINALG_FREE(bytes) ((void)(bytes))
+#define LINALG_FLOPS(op,count) ((void)(op),(void)(count))
+#endif
+
+#endif
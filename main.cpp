@@ -3,6 +3,7 @@
 
 int main(int argc, char **argv)
 {
+	RenderStats::start();
 	QApplication app(argc, argv);
 	RobotWindow window;
 	window.show();
@@ -0,0 +1,298 @@
+#ifndef MAT4_H
+#define MAT4_H
+
+/*! \file mat4.h
+  \brief Homogeneous Transforms
+
+  A fixed size \f$4\times4\f$ matrix with builders for the transforms OpenGL's matrix stack and GLU produce. The builders follow the OpenGL reference pages exactly, so a Mat4 can replace \c glTranslated, \c glRotated, \c glScaled, \c glFrustum, \c glOrtho, \c gluPerspective and \c gluLookAt and be handed straight to \c glLoadMatrixd. Everything is \c constexpr, including the trigonometry, so transforms with constant arguments are computed by the compiler:
+  \code
+  static constexpr Mat4 shoulderMount=Mat4::translate(-10.0,0.0,30.0)*Mat4::rotate(90.0,0.0,1.0,0.0);
+  \endcode
+  Requires C++14. */
+
+//! Homogeneous Transform
+/*! A \f$4\times4\f$ matrix stored in column major order like OpenGL. Angles are in degrees like OpenGL. */
+struct Mat4
+{
+	//! Matrix Data
+	/*! The 16 entries in column major order: element \f$(i,j)\f$ is \c m[4*j+i]. */
+	double m[16];
+
+	//! Element Accessor
+	/*! \param i the row
+	  \param j the column
+	  \return element \f$(i,j)\f$ */
+	constexpr double at(unsigned int i,unsigned int j) const {return m[4*j+i];}
+
+	//! Identity
+	/*! \return \f$I_4\f$ */
+	static constexpr Mat4 identity()
+	{
+		Mat4 r={};
+		r.m[0]=r.m[5]=r.m[10]=r.m[15]=1.0;
+		return r;
+	}
+
+	//! Translation
+	/*! Equivalent to \c glTranslated.
+	  \param x the \f$x\f$ offset
+	  \param y the \f$y\f$ offset
+	  \param z the \f$z\f$ offset
+	  \return the transform */
+	static constexpr Mat4 translate(double x,double y,double z)
+	{
+		Mat4 r=identity();
+		r.m[12]=x;
+		r.m[13]=y;
+		r.m[14]=z;
+		return r;
+	}
+
+	//! Scale
+	/*! Equivalent to \c glScaled.
+	  \param x the \f$x\f$ factor
+	  \param y the \f$y\f$ factor
+	  \param z the \f$z\f$ factor
+	  \return the transform */
+	static constexpr Mat4 scale(double x,double y,double z)
+	{
+		Mat4 r={};
+		r.m[0]=x;
+		r.m[5]=y;
+		r.m[10]=z;
+		r.m[15]=1.0;
+		return r;
+	}
+
+	//! Rotation
+	/*! Equivalent to \c glRotated: a counterclockwise rotation by \a angle degrees about the axis \f$(x,y,z)\f$, which need not be normalized.
+	  \param angle the angle in degrees
+	  \param x the \f$x\f$ component of the axis
+	  \param y the \f$y\f$ component of the axis
+	  \param z the \f$z\f$ component of the axis
+	  \return the transform */
+	static constexpr Mat4 rotate(double angle,double x,double y,double z)
+	{
+		double length=root(x*x+y*y+z*z);
+		if (length>0.0)
+		{
+			x/=length;
+			y/=length;
+			z/=length;
+		}
+		double c=cosine(angle*(pi/180.0)),s=sine(angle*(pi/180.0)),t=1.0-c;
+		Mat4 r={};
+		r.m[0]=x*x*t+c;
+		r.m[1]=y*x*t+z*s;
+		r.m[2]=x*z*t-y*s;
+		r.m[4]=x*y*t-z*s;
+		r.m[5]=y*y*t+c;
+		r.m[6]=y*z*t+x*s;
+		r.m[8]=x*z*t+y*s;
+		r.m[9]=y*z*t-x*s;
+		r.m[10]=z*z*t+c;
+		r.m[15]=1.0;
+		return r;
+	}
+
+	//! Perspective Frustum
+	/*! Equivalent to \c glFrustum.
+	  \param left the left clipping plane
+	  \param right the right clipping plane
+	  \param bottom the bottom clipping plane
+	  \param top the top clipping plane
+	  \param zNear the distance to the near clipping plane
+	  \param zFar the distance to the far clipping plane
+	  \return the projection */
+	static constexpr Mat4 frustum(double left,double right,double bottom,double top,double zNear,double zFar)
+	{
+		Mat4 r={};
+		r.m[0]=2.0*zNear/(right-left);
+		r.m[5]=2.0*zNear/(top-bottom);
+		r.m[8]=(right+left)/(right-left);
+		r.m[9]=(top+bottom)/(top-bottom);
+		r.m[10]=-(zFar+zNear)/(zFar-zNear);
+		r.m[11]=-1.0;
+		r.m[14]=-2.0*zFar*zNear/(zFar-zNear);
+		return r;
+	}
+
+	//! Symmetric Perspective
+	/*! Equivalent to \c gluPerspective.
+	  \param fovy the vertical field of view in degrees
+	  \param aspect the width to height ratio
+	  \param zNear the distance to the near clipping plane
+	  \param zFar the distance to the far clipping plane
+	  \return the projection */
+	static constexpr Mat4 perspective(double fovy,double aspect,double zNear,double zFar)
+	{
+		double half=fovy*(pi/360.0);
+		double f=cosine(half)/sine(half);
+		Mat4 r={};
+		r.m[0]=f/aspect;
+		r.m[5]=f;
+		r.m[10]=(zFar+zNear)/(zNear-zFar);
+		r.m[11]=-1.0;
+		r.m[14]=2.0*zFar*zNear/(zNear-zFar);
+		return r;
+	}
+
+	//! Orthographic Projection
+	/*! Equivalent to \c glOrtho.
+	  \param left the left clipping plane
+	  \param right the right clipping plane
+	  \param bottom the bottom clipping plane
+	  \param top the top clipping plane
+	  \param zNear the distance to the near clipping plane
+	  \param zFar the distance to the far clipping plane
+	  \return the projection */
+	static constexpr Mat4 ortho(double left,double right,double bottom,double top,double zNear,double zFar)
+	{
+		Mat4 r=identity();
+		r.m[0]=2.0/(right-left);
+		r.m[5]=2.0/(top-bottom);
+		r.m[10]=-2.0/(zFar-zNear);
+		r.m[12]=-(right+left)/(right-left);
+		r.m[13]=-(top+bottom)/(top-bottom);
+		r.m[14]=-(zFar+zNear)/(zFar-zNear);
+		return r;
+	}
+
+	//! Viewing Transform
+	/*! Equivalent to \c gluLookAt.
+	  \param eyeX the \f$x\f$ coordinate of the eye
+	  \param eyeY the \f$y\f$ coordinate of the eye
+	  \param eyeZ the \f$z\f$ coordinate of the eye
+	  \param centerX the \f$x\f$ coordinate of the point looked at
+	  \param centerY the \f$y\f$ coordinate of the point looked at
+	  \param centerZ the \f$z\f$ coordinate of the point looked at
+	  \param upX the \f$x\f$ component of the up direction
+	  \param upY the \f$y\f$ component of the up direction
+	  \param upZ the \f$z\f$ component of the up direction
+	  \return the transform */
+	static constexpr Mat4 lookAt(double eyeX,double eyeY,double eyeZ,double centerX,double centerY,double centerZ,double upX,double upY,double upZ)
+	{
+		/* f is the normalized view direction, s=f x up normalized, u=s x f */
+		double f[3]={centerX-eyeX,centerY-eyeY,centerZ-eyeZ};
+		double k=root(f[0]*f[0]+f[1]*f[1]+f[2]*f[2]);
+		f[0]/=k;
+		f[1]/=k;
+		f[2]/=k;
+		double s[3]={f[1]*upZ-f[2]*upY,f[2]*upX-f[0]*upZ,f[0]*upY-f[1]*upX};
+		k=root(s[0]*s[0]+s[1]*s[1]+s[2]*s[2]);
+		s[0]/=k;
+		s[1]/=k;
+		s[2]/=k;
+		double u[3]={s[1]*f[2]-s[2]*f[1],s[2]*f[0]-s[0]*f[2],s[0]*f[1]-s[1]*f[0]};
+		Mat4 r=identity();
+		for (unsigned int j=0;j<3;j++)
+		{
+			r.m[4*j]=s[j];
+			r.m[4*j+1]=u[j];
+			r.m[4*j+2]=-f[j];
+		}
+		return r*translate(-eyeX,-eyeY,-eyeZ);
+	}
+
+	//! Composition
+	/*! Equivalent to \c glMultMatrixd: the result applies \a other first, then this transform.
+	  \param other the right hand operand
+	  \return the product */
+	constexpr Mat4 operator*(const Mat4 &other) const
+	{
+		Mat4 r={};
+		for (unsigned int j=0;j<4;j++)
+			for (unsigned int i=0;i<4;i++)
+				r.m[4*j+i]=m[i]*other.m[4*j]+m[4+i]*other.m[4*j+1]+m[8+i]*other.m[4*j+2]+m[12+i]*other.m[4*j+3];
+		return r;
+	}
+
+	//! Transform A Point
+	/*! Applies the transform to the point \f$(x,y,z,1)\f$.
+	  \param x the \f$x\f$ coordinate
+	  \param y the \f$y\f$ coordinate
+	  \param z the \f$z\f$ coordinate
+	  \param out array of 4 receiving the homogeneous result */
+	constexpr void apply(double x,double y,double z,double *out) const
+	{
+		for (unsigned int i=0;i<4;i++)
+			out[i]=m[i]*x+m[4+i]*y+m[8+i]*z+m[12+i];
+	}
+
+private:
+	//! \f$\pi\f$
+	static constexpr double pi=3.14159265358979323846;
+
+	//! Square Root
+	/*! Newton's method, usable in constant expressions.
+	  \param x a nonnegative number
+	  \return \f$\sqrt x\f$ */
+	static constexpr double root(double x)
+	{
+		if (x<=0.0)
+			return 0.0;
+		double r=x>1.0?x:1.0,last=0.0;
+		while (r!=last)
+		{
+			last=r;
+			r=0.5*(r+x/r);
+			/* Newton's method approaches from above; stop when it turns around */
+			if (r>=last)
+				return last;
+		}
+		return r;
+	}
+
+	//! Reduced Sine And Cosine
+	/*! Taylor series for \f$|x|\le\frac\pi4\f$, accurate to double precision.
+	  \param x the angle in radians
+	  \param cosineWanted true for the cosine, false for the sine
+	  \return \f$\sin x\f$ or \f$\cos x\f$ */
+	static constexpr double series(double x,bool cosineWanted)
+	{
+		double term=cosineWanted?1.0:x,sum=term;
+		for (unsigned int k=cosineWanted?1:2;k<12;k++)
+		{
+			unsigned int n=2*k-(cosineWanted?0:1);
+			term*=-x*x/((n-1)*n);
+			sum+=term;
+		}
+		return sum;
+	}
+
+	//! Sine Or Cosine
+	/*! Reduces \a x to \f$[-\frac\pi4,\frac\pi4]\f$ by quadrant and evaluates series(). Meant for angles of a few turns at most, which is all transforms use.
+	  \param x the angle in radians
+	  \param cosineWanted true for the cosine, false for the sine
+	  \return \f$\sin x\f$ or \f$\cos x\f$ */
+	static constexpr double trig(double x,bool cosineWanted)
+	{
+		double q=x/(pi/2.0);
+		long long quadrant=(long long)(q<0.0?q-0.5:q+0.5);
+		double r=x-quadrant*(pi/2.0);
+		unsigned int phase=(unsigned int)(((quadrant%4)+4)%4)+(cosineWanted?1:0);
+		switch (phase%4)
+		{
+			case 0:
+				return series(r,false);
+			case 1:
+				return series(r,true);
+			case 2:
+				return -series(r,false);
+			default:
+				return -series(r,true);
+		}
+	}
+
+	//! Sine
+	/*! \param x the angle in radians
+	  \return \f$\sin x\f$ */
+	static constexpr double sine(double x) {return trig(x,false);}
+
+	//! Cosine
+	/*! \param x the angle in radians
+	  \return \f$\cos x\f$ */
+	static constexpr double cosine(double x) {return trig(x,true);}
+};
+
+#endif
@@ -4,7 +4,47 @@
 
 #include "linalg.h"
 
-static int detFactor;
+//! Matrix Cache
+/*! Results derived from a Matrix's contents. Each entry is stamped with the Matrix::version it was computed from and is current only while the stamps match, so invalidating everything is a single increment. The objects are reused across recomputations, which keeps references handed out by LU() and inverse() valid for the life of the Matrix. */
+struct MatrixCache
+{
+	MatrixCache():luVersion(0),detVersion(0),inverseVersion(0) {}
+	//! LU Factors
+	/*! As computed by decompose(); solved and exists are always false. */
+	LUDecomposition lu;
+	//! Row Swaps
+	/*! Pairs of rows swapped while factoring, in order, for permuting a right hand side. */
+	std::vector<unsigned int> swaps;
+	int detFactor; /*!< Sign Of The Row Permutation */
+	bool singular; /*!< True If The Reduced Matrix Has A Zero Row */
+	unsigned long luVersion; /*!< Version Of lu, swaps, detFactor And singular */
+	double det; /*!< Determinant */
+	unsigned long detVersion; /*!< Version Of det */
+	Matrix inverse; /*!< Inverse */
+	//! Inversion Error
+	/*! The message inverse() throws, or NULL if the inverse exists. */
+	const char *inverseError;
+	unsigned long inverseVersion; /*!< Version Of inverse And inverseError */
+};
+
+//! Zero Row Test
+/*! Checks whether any row of \a M is zero to within \c DBL_EPSILON, which after reduction means the original Matrix is singular.
+  \param M the Matrix
+  \param m number of rows
+  \param n number of columns
+  \return true if there is a zero row */
+static bool zeroRow(Matrix &M,unsigned int m,unsigned int n)
+{
+	for (unsigned int i=0;i<m;i++)
+	{
+		unsigned int j=0;
+		while (j<n&&fabs(M.at(i,j))<=DBL_EPSILON)
+			j++;
+		if (j==n)
+			return true;
+	}
+	return false;
+}
 
 //! Scalar Multiplication Operator
 /*! Friend function that multiplies a Matrix \a m by a scalar \a k.
@@ -17,6 +57,7 @@ Matrix operator*(double k,Matrix &m)
 	for (unsigned int i=0;i<m.m;i++)
 		for (unsigned int j=0;j<m.n;j++)
 			answer[i][j]=k*m.matrix[i][j];
+	LINALG_FLOPS(OP_SCALE,(unsigned long)m.m*m.n);
 	return answer;
 }
 
@@ -44,6 +85,7 @@ Matrix operator/(Matrix &m,double k)
 	for (unsigned int i=0;i<m.m;i++)
 		for (unsigned int j=0;j<m.n;j++)
 			answer[i][j]=m.matrix[i][j]/k;
+	LINALG_FLOPS(OP_SCALE,(unsigned long)m.m*m.n);
 	return answer;
 }
 
@@ -79,6 +121,7 @@ istream &operator>>(istream &is,Matrix &m)
 	for (unsigned int i=0;i<m.m;i++)
 		for (unsigned int j=0;j<m.n;j++)
 			is>>m.matrix[i][j];
+	m.touch();
 	return is;
 }
 
@@ -98,6 +141,10 @@ Matrix::Matrix()
 {
 	matrix=0;
 	m=n=0;
+	wrapped=false;
+	version=1;
+	cache=NULL;
+	LINALG_CONSTRUCT();
 }
 
 //! Copy Constructor
@@ -105,22 +152,14 @@ Matrix::Matrix()
   \param other the Matrix to copy from */
 Matrix::Matrix(const Matrix &other)
 {
-	try
-	{
-		matrix=new double*[other.m];
-		for (unsigned int i=0;i<other.m;i++)
-			matrix[i]=new double[other.n];
-		for (unsigned int i=0;i<other.m;i++)
-			for (unsigned int j=0;j<other.n;j++)
-				matrix[i][j]=other.matrix[i][j];
-	}
-	catch (std::bad_alloc &e)
-	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
-	}
-	m=other.m;
-	n=other.n;
+	allocate(other.m,other.n);
+	version=1;
+	cache=NULL;
+	for (unsigned int i=0;i<m;i++)
+		for (unsigned int j=0;j<n;j++)
+			matrix[i][j]=other.matrix[i][j];
+	LINALG_CONSTRUCT();
+	LINALG_COPY();
 }
 
 //! Full Constructor
@@ -129,22 +168,13 @@ Matrix::Matrix(const Matrix &other)
   \param b number of columns */
 Matrix::Matrix(unsigned int a,unsigned int b)
 {
-	try
-	{
-		matrix=new double*[a];
-		for (unsigned int i=0;i<a;i++)
-			matrix[i]=new double[b];
-		for (unsigned int i=0;i<a;i++)
-			for (unsigned int j=0;j<b;j++)
-				matrix[i][j]=0.0;
-	}
-	catch (std::bad_alloc &e)
-	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
-	}
-	m=a;
-	n=b;
+	allocate(a,b);
+	version=1;
+	cache=NULL;
+	for (unsigned int i=0;i<a;i++)
+		for (unsigned int j=0;j<b;j++)
+			matrix[i][j]=0.0;
+	LINALG_CONSTRUCT();
 }
 
 //! OpenGL glGetDoublev() Compatible Constructor
@@ -159,88 +189,106 @@ Matrix::Matrix(double *values,unsigned int a,bool colOrder)
 	/* check to see if this can create a square matrix */
 	if ((fabs(pow(sqrt(a),2.0)-a))>DBL_EPSILON)
 		throw LinAlgException("Not a square matrix");
-	m=n=(unsigned int)sqrt(a);
-	try
-	{
-		matrix=new double*[m];
-		for (unsigned int i=0;i<m;i++)
-			matrix[i]=new double[n];
-		for (unsigned int i=0;i<m;i++)
-			for (unsigned int j=0;j<n;j++)
-			{
-				if (colOrder)
-					matrix[i][j]=values[n*j+i];
-				else
-					matrix[i][j]=values[n*i+j];
-			}
-	}
-	catch (std::bad_alloc &e)
+	unsigned int b=(unsigned int)sqrt(a);
+	allocate(b,b);
+	version=1;
+	cache=NULL;
+	for (unsigned int i=0;i<m;i++)
+		for (unsigned int j=0;j<n;j++)
+		{
+			if (colOrder)
+				matrix[i][j]=values[n*j+i];
+			else
+				matrix[i][j]=values[n*i+j];
+		}
+	LINALG_CONSTRUCT();
+}
+
+//! Flat Array Constructor
+/*! Creates a \f$a\times b\f$ Matrix from the one dimensional array \a values in row major order.
+  \param values array of \f$ab\f$ elements
+  \param a number of rows
+  \param b number of columns
+  \param wrap if false, \a values is copied; if true, the Matrix operates on \a values in place. There is no default so a call can't be mistaken for Matrix(double *,unsigned int,bool). */
+Matrix::Matrix(double *values,unsigned int a,unsigned int b,bool wrap)
+{
+	if (wrap)
+		this->wrap(a,b);
+	else
+		allocate(a,b);
+	version=1;
+	cache=NULL;
+	for (unsigned int i=0;i<a;i++)
 	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
+		if (wrap)
+			matrix[i]=values+(size_t)b*i;
+		else
+			for (unsigned int j=0;j<b;j++)
+				matrix[i][j]=values[(size_t)b*i+j];
 	}
+	LINALG_CONSTRUCT();
 }
 
 //! Two Dimensional Array Constructor
 /*! Creates a \f$a\times b\f$ Matrix from the two dimensional array \a values. \a values is assumed to be in row major order.
   \param values array containing the data to load
   \param a number of rows
-  \param b number of columns */
-Matrix::Matrix(double **values,unsigned int a,unsigned int b)
+  \param b number of columns
+  \param wrap if false, \a values is copied (default); if true, the Matrix operates on the rows of \a values in place */
+Matrix::Matrix(double **values,unsigned int a,unsigned int b,bool wrap)
 {
-	try
+	if (wrap)
+		this->wrap(a,b);
+	else
+		allocate(a,b);
+	version=1;
+	cache=NULL;
+	for (unsigned int i=0;i<a;i++)
 	{
-		matrix=new double*[a];
-		for (unsigned int i=0;i<a;i++)
-			matrix[i]=new double[b];
-		for (unsigned int i=0;i<a;i++)
+		if (wrap)
+			matrix[i]=values[i];
+		else
 			for (unsigned int j=0;j<b;j++)
 				matrix[i][j]=values[i][j];
 	}
-	catch (std::bad_alloc &e)
-	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
-	}
-	m=a;
-	n=b;
+	LINALG_CONSTRUCT();
 }
 
 //! std::vector Constructor
 /*! Creates a  Matrix from the std::vector< std::vector<double> > \a values. \a values is assumed to be in row major order.
   \param values std::vector containing the data to load
+  \param wrap if false, \a values is copied (default); if true, the Matrix operates on the rows of \a values in place, which must then not be resized
   \throw LinAlgException if the std::vector is not rectangular */
-Matrix::Matrix(std::vector< std::vector<double> > &values)
+Matrix::Matrix(std::vector< std::vector<double> > &values,bool wrap)
 {
 	/* check to make sure the vector is rectangular */
 	unsigned int x=values[0].size();
 	for (unsigned int i=0;i<values.size();i++)
 		if (values[i].size()!=x)
 			throw LinAlgException("Incompatible Dimensions");
-	try
+	if (wrap)
+		this->wrap(values.size(),x);
+	else
+		allocate(values.size(),x);
+	version=1;
+	cache=NULL;
+	for (unsigned int i=0;i<m;i++)
 	{
-		matrix=new double*[values.size()];
-		for (unsigned int i=0;i<values.size();i++)
-			matrix[i]=new double[values[i].size()];
-		for (unsigned int i=0;i<values.size();i++)
-			for (unsigned int j=0;j<values[i].size();j++)
+		if (wrap)
+			matrix[i]=x?&values[i][0]:NULL;
+		else
+			for (unsigned int j=0;j<n;j++)
 				matrix[i][j]=values[i][j];
 	}
-	catch (std::bad_alloc &e)
-	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
-	}
-	m=values.size();
-	n=values[0].size();
+	LINALG_CONSTRUCT();
 }
 
 //! Destructor
 /*! Frees allocated objects needed by Matrix. */
 Matrix::~Matrix()
 {
-	for (unsigned int i=0;i<m;i++)
-		delete matrix[i];
+	release();
+	delete cache;
 }
 
 //! Assignment Operator
@@ -249,26 +297,84 @@ Matrix::~Matrix()
   \return a reference to the new Matrix */
 Matrix &Matrix::operator=(const Matrix &other)
 {
-	if (matrix)
-		for (unsigned int i=0;i<m;i++)
-			delete matrix[i];
+	if (this==&other)
+		return *this;
+	/* reuse the storage when the dimensions already match */
+	if (!matrix||m!=other.m||n!=other.n)
+	{
+		release();
+		allocate(other.m,other.n);
+	}
+	for (unsigned int i=0;i<m;i++)
+		for (unsigned int j=0;j<n;j++)
+			matrix[i][j]=other.matrix[i][j];
+	touch();
+	LINALG_COPY();
+	return *this;
+}
+
+//! Storage Allocator
+/*! Allocates uninitialized storage for a \f$a\times b\f$ Matrix and sets the dimensions. All Matrix storage goes through here so it can be accounted for by LinAlgStats.
+  \param a number of rows
+  \param b number of columns */
+void Matrix::allocate(unsigned int a,unsigned int b)
+{
 	try
 	{
-		matrix=new double*[other.m];
-		for (unsigned int i=0;i<other.m;i++)
-			matrix[i]=new double[other.n];
-		for (unsigned int i=0;i<other.m;i++)
-			for (unsigned int j=0;j<other.n;j++)
-				matrix[i][j]=other.matrix[i][j];
+		matrix=new double*[a];
+		for (unsigned int i=0;i<a;i++)
+			matrix[i]=new double[b];
 	}
 	catch (std::bad_alloc &e)
 	{
 		std::cerr<<"Exception: "<<e.what()<<std::endl;
 		abort();
 	}
-	m=other.m;
-	n=other.n;
-	return *this;
+	m=a;
+	n=b;
+	wrapped=false;
+	LINALG_ALLOC(a*sizeof(double *)+(size_t)a*b*sizeof(double));
+}
+
+//! Row Table Allocator
+/*! Allocates only the row pointers of a \f$a\times b\f$ Matrix, for constructors that point them at the caller's rows.
+  \param a number of rows
+  \param b number of columns */
+void Matrix::wrap(unsigned int a,unsigned int b)
+{
+	try
+	{
+		matrix=new double*[a];
+	}
+	catch (std::bad_alloc &e)
+	{
+		std::cerr<<"Exception: "<<e.what()<<std::endl;
+		abort();
+	}
+	m=a;
+	n=b;
+	wrapped=true;
+	LINALG_ALLOC(a*sizeof(double *));
+}
+
+//! Storage Deallocator
+/*! Frees the storage obtained by allocate() or wrap() and leaves an empty \f$0\times0\f$ Matrix. Wrapped rows are only let go of. */
+void Matrix::release()
+{
+	if (!matrix)
+		return;
+	size_t bytes=m*sizeof(double *);
+	if (!wrapped)
+	{
+		for (unsigned int i=0;i<m;i++)
+			delete[] matrix[i];
+		bytes+=(size_t)m*n*sizeof(double);
+	}
+	delete[] matrix;
+	LINALG_FREE(bytes);
+	matrix=0;
+	m=n=0;
+	wrapped=false;
 }
 
 //! Addition Operator
@@ -284,6 +390,7 @@ Matrix Matrix::operator+(Matrix &other)
 	for (unsigned int i=0;i<m;i++)
 		for (unsigned int j=0;j<n;j++)
 			answer[i][j]=matrix[i][j]+other.matrix[i][j];
+	LINALG_FLOPS(OP_ADD,(unsigned long)m*n);
 	return answer;
 }
 
@@ -300,6 +407,7 @@ Matrix Matrix::operator-(Matrix &other)
 	for (unsigned int i=0;i<m;i++)
 		for (unsigned int j=0;j<n;j++)
 			answer[i][j]=matrix[i][j]-other.matrix[i][j];
+	LINALG_FLOPS(OP_SUBTRACT,(unsigned long)m*n);
 	return answer;
 }
 
@@ -317,6 +425,7 @@ Matrix Matrix::operator*(Matrix &other)
 		for (unsigned int j=0;j<answer.n;j++)
 			for (unsigned int k=0;k<n;k++)
 				answer.matrix[i][j]+=matrix[i][k]*other.matrix[k][j];
+	LINALG_FLOPS(OP_MULTIPLY,2ul*m*n*other.n);
 	return answer;
 }
 
@@ -376,11 +485,12 @@ Matrix Matrix::operator/=(double k)
 
 
 //! Array Subscript Operator
-/*! Accesses a particular element in the Matrix
+/*! Accesses a particular element in the Matrix. The row can be written through, so this counts as a modification and drops the cached results; use at() to read.
   \param a the element to access
   \return the \f$a^{th}\f$ element in the Matrix */
 double *Matrix::operator[](unsigned int a)
 {
+	touch();
 	return matrix[a];
 }
 
@@ -424,41 +534,27 @@ double Matrix::det()
 #endif
 
 //! Determinant
-/*! Finds the determinant by LUDecomposition. Runs \f$O(n^3)\f$.
+/*! Finds the determinant by LUDecomposition. Runs \f$O(n^3)\f$ the first time and \f$O(1)\f$ until the Matrix is modified.
   \throw LinAlgException if the Matrix is not square
   \return the determinant */
 double Matrix::det()
 {
-	if (n!=m)
-		throw LinAlgException("Not a square matrix");
-	bool singular=false;
-	double det=1.0;
-	Matrix temp(n,n),L(n,n),U(n,n);
-	struct LUDecomposition LU=this->LU();
-	temp=LU.A;
-	L=LU.L;
-	U=LU.A;
-	/* if there exists a row of only zeros, the matrix is singular */
-	for (unsigned int i=0;i<m;i++)
+	MatrixCache &c=factored();
+	if (c.detVersion==version)
+		return c.det;
+	/* det(A)=0 for all singular matrices A */
+	c.det=0.0;
+	if (!c.singular)
 	{
-		for (unsigned int j=0;j<n;j++)
-		{
-			if (fabs(temp[i][j])>DBL_EPSILON)
-				break;
-			else if (j==(n-1))
-				singular=true;
-		}
-		if (singular)
-			break;
+		/* otherwise, it's the product of the main diagonal */
+		c.det=1.0;
+		for (unsigned int i=0;i<m;i++)
+			c.det*=c.lu.L.matrix[i][i];
+		c.det*=c.detFactor;
+		LINALG_FLOPS(OP_DET,n+1);
 	}
-	/* det(A)=0 for all singular matrices A */
-	if (singular)
-		return 0.0;
-	/* otherwise, it's the product of the main diagonal */
-	for (unsigned int i=0;i<m;i++)
-		det*=L.matrix[i][i];
-	det*=detFactor;
-	return det;
+	c.detVersion=version;
+	return c.det;
 }
 
 //! Generate Identity
@@ -474,21 +570,41 @@ void Matrix::identity()
 				matrix[i][j]=0.0;
 			else
 				matrix[i][j]=1.0;
+	touch();
 }
 
 //! Matrix Inversion
-/*! Finds the inverse of a Matrix using Gauss Jordan Elimination.
+/*! Finds the inverse of a Matrix using Gauss Jordan Elimination. Runs \f$O(n^3)\f$ the first time and \f$O(1)\f$ until the Matrix is modified.
   \throw LinAlgException if the Matrix is not square \b or if the Matrix is singular
-  \return the resulting Matrix */
+  \return the resulting Matrix, owned by this Matrix and current until it is next modified */
 Matrix &Matrix::inverse()
 {
 	if (n!=m)
 		throw LinAlgException("Not a square matrix");
+	MatrixCache &c=cached();
+	if (c.inverseVersion!=version)
+	{
+		c.inverseError=invert(c.inverse);
+		c.inverseVersion=version;
+	}
+	if (c.inverseError)
+		throw LinAlgException(c.inverseError);
+	return c.inverse;
+}
+
+//! Gauss Jordan Worker Function
+/*! Does the actual work for inverse().
+  \param inv receives the inverse
+  \return NULL on success, otherwise the error message for inverse() to throw */
+const char *Matrix::invert(Matrix &inv)
+{
 	int largestValue;
-	bool singular=false;
 	double pivotElement;
-	Matrix temp=*this,*inv=new Matrix(n,n);
-	inv->identity();
+	unsigned long flops=0;
+	Matrix temp=*this;
+	if (inv.m!=n||inv.n!=n)
+		inv=Matrix(n,n);
+	inv.identity();
 
 	for (unsigned int i=0;i<m;i++)
 	{
@@ -503,18 +619,19 @@ Matrix &Matrix::inverse()
 					largestValue=j;
 			}
 			temp.swapRow(i,largestValue);
-			inv->swapRow(i,largestValue);
+			inv.swapRow(i,largestValue);
 		}
 		/* this essentially does the same as pivot() */
 		/* except it works on both temp and inv at the same time */
 		pivotElement=temp.matrix[i][i];
 		if (fabs(pivotElement)<DBL_EPSILON)
-			throw LinAlgException("Divide by zero");
+			return "Divide by zero";
 		for (unsigned int j=0;j<n;j++)
 		{
 			temp.matrix[i][j]/=pivotElement;
-			inv->matrix[i][j]/=pivotElement;
+			inv.matrix[i][j]/=pivotElement;
 		}
+		flops+=2*n;
 		for (unsigned int j=0;j<m;j++)
 		{
 			if (j!=i&&fabs(temp.matrix[j][i])>DBL_EPSILON)
@@ -523,30 +640,21 @@ Matrix &Matrix::inverse()
 				for (unsigned int k=0;k<n;k++)
 				{
 					temp.matrix[j][k]=temp.matrix[j][k]-factor*temp.matrix[i][k];
-					inv->matrix[j][k]=inv->matrix[j][k]-factor*inv->matrix[i][k];
+					inv.matrix[j][k]=inv.matrix[j][k]-factor*inv.matrix[i][k];
 				}
+				flops+=4*n;
 			}
 		}
 	}
+	LINALG_FLOPS(OP_INVERSE,flops);
 	/* check if the matrix is singular */
-	for (unsigned int i=0;i<m;i++)
-	{
-		for (unsigned int j=0;j<n;j++)
-		{
-			if (fabs(temp.matrix[i][j])>DBL_EPSILON)
-				break;
-			else if (j==(n-1))
-				singular=true;
-		}
-		if (singular)
-			throw LinAlgException("Singular matrix");
-	}
-
-	return *inv;
+	if (zeroRow(temp,m,n))
+		return "Singular matrix";
+	return NULL;
 }
 
 //! OpenGL glGetDoublev() Compatible Loader
-/*! Creates a \f$b\times b\f$ Matrix with data from \a values where \f$b=\sqrt a\f$. If the Matrix is not already \f$b\times b\f$, load() will adjust the Matrix.
+/*! Creates a \f$b\times b\f$ Matrix with data from \a values where \f$b=\sqrt a\f$. If the Matrix is not already \f$b\times b\f$, load() will adjust the Matrix. Loading the values the Matrix already holds is not a modification, so a transform reloaded every frame keeps its cached results while it stays put.
   \param values array containg the data to load
   \param a number of elements in \a values
   \param colOrder if true, \a values is in column major order (default); if false, \a values is assumed to be in row major order
@@ -557,45 +665,101 @@ void Matrix::load(double *values,unsigned int a,bool colOrder)
 	/* check to see if this can create a square matrix */
 	if ((fabs(pow(sqrt(a),2.0)-a))>DBL_EPSILON)
 		throw LinAlgException("Not a square matrix");
-	m=n=(unsigned int)sqrt(a);
-	matrix=new double*[m];
-	for (unsigned int i=0;i<m;i++)
-		matrix[i]=new double[n];
+	unsigned int b=(unsigned int)sqrt(a);
+	bool changed=false;
+	if (!matrix||m!=b||n!=b)
+	{
+		release();
+		allocate(b,b);
+		changed=true;
+	}
 	for (unsigned int i=0;i<m;i++)
 		for (unsigned int j=0;j<n;j++)
 		{
-			if (colOrder)
-				matrix[i][j]=values[n*j+i];
-			else
-				matrix[i][j]=values[n*i+j];
+			double v=colOrder?values[n*j+i]:values[n*i+j];
+			if (matrix[i][j]!=v)
+				changed=true;
+			matrix[i][j]=v;
 		}
+	if (changed)
+		touch();
+}
+
+//! LU Decomposition
+/*! Performs an LU Decomposition of a square \f$n\times n\f$ Matrix without attempting to solve a system. The factors are kept until the Matrix is modified, so repeated calls cost \f$O(1)\f$.
+  \throw LinAlgException if the Matrix is not square
+  \return struct LUDecomposition with the results, owned by this Matrix and current until it is next modified
+  \sa LU(Matrix &b)
+  \sa struct LUDecomposition */
+struct LUDecomposition &Matrix::LU()
+{
+	return factored().lu;
 }
 
 /*! \fn Matrix::LU(Matrix &b)
 
   \brief LU Decomposition
 
-  Performs an LU Decomposition of a square \f$n\times n\f$ Matrix. It will attempt to solve a system of equations with a \f$n\times 1\f$ Matrix \a b if \a b is provided. If \a b is NULL, the LU Decomposition is performed without attempting to solve a system (default). Solving by LU Decomposition is much faster \f$(O(n^3))\f$ than by Gauss Jordan Elimination \f$O(n^4))\f$.
+  Performs an LU Decomposition of a square \f$n\times n\f$ Matrix and solves the system of equations with the \f$n\times 1\f$ Matrix \a b ``in place''. Solving by LU Decomposition is much faster \f$(O(n^3))\f$ than by Gauss Jordan Elimination \f$O(n^4))\f$. The factors are cached, so solving again with another \a b before the Matrix is modified only costs the \f$O(n^2)\f$ substitutions.
   \param b \f$n\times 1\f$ answer Matrix
-  \return struct LUDecomposition with the results
+  \throw LinAlgException if the Matrix is not square or \a b has the wrong dimensions
+  \return struct LUDecomposition with the results; the caller owns it
   \sa inverse()
   \sa struct LUDecomposition */
 struct LUDecomposition &Matrix::LU(Matrix &b)
 {
 	if (n!=m)
 		throw LinAlgException("Not a square matrix");
-	if (&b&&(b.m!=m||b.n!=1))
+	if (b.m!=m||b.n!=1)
 		throw LinAlgException("Incompatible dimensions for Matrix b");
-	bool solve=false,singular=false;
-	int largestValue;
-	double c;
-	//vector<Matrix> *matrices=new vector<Matrix>;
-	LUDecomposition *LU=new LUDecomposition;
-	Matrix temp=*this,L(n,n),U(n,n),y(n,1);
-	if (&b)
-		solve=true;
+	MatrixCache &c=factored();
+	double s;
+	Matrix y(n,1);
+	LUDecomposition *LU=new LUDecomposition(c.lu);
+	/* apply the row swaps made while factoring */
+	for (unsigned int i=0;i<c.swaps.size();i+=2)
+		b.swapRow(c.swaps[i],c.swaps[i+1]);
+	if (!c.singular)
+	{
+		Matrix &L=c.lu.L,&U=c.lu.U;
+		/* solve y by forward subsitution */
+		for (unsigned int i=0;i<m;i++)
+		{
+			s=0.0;
+			for (unsigned int j=0;j<i;j++)
+				s+=L.matrix[i][j]*y.matrix[j][0];
+			y.matrix[i][0]=(b.matrix[i][0]-s)/L.matrix[i][i];
+		}
+		LINALG_FLOPS(OP_LU,(unsigned long)m*m);
+		/* solve x by back substitution */
+		for (unsigned int i=m-1;i<m;i--)
+		{
+			s=0.0;
+			for (unsigned int j=i+1;j<m;j++)
+				s+=U.matrix[i][j]*b.matrix[j][0];
+			b.matrix[i][0]=y.matrix[i][0]-s;
+		}
+		LINALG_FLOPS(OP_LU,(unsigned long)m*(m-1));
+		b.touch();
+	}
+	else
+		std::cout<<"Matrix is singular. Solution does not exist."<<std::endl;
+	LU->solved=true;
+	LU->exists=!c.singular;
+	return *LU;
+}
+
+//! LU Decomposition Worker Function
+/*! Does the actual factoring for both forms of LU(). Rows are only swapped to get a nonzero pivot; each swap is recorded in \a swaps as a pair of rows so a right hand side can be permuted the same way afterwards.
+  \param LU receives A, L and U
+  \param swaps receives the row swaps in the order they were made
+  \return the sign of the row permutation */
+int Matrix::decompose(struct LUDecomposition &LU,std::vector<unsigned int> &swaps)
+{
+	int largestValue,sign=1;
+	Matrix temp=*this,L(n,n),U(n,n);
+	swaps.clear();
 	U.identity();
-	detFactor=1;
 	/* travel down the main diagonal and populate L & U */
 	for (unsigned int i=0;i<m;i++)
 	{
@@ -609,76 +773,25 @@ struct LUDecomposition &Matrix::LU(Matrix &b)
 				if (fabs(temp.matrix[j][i])>fabs(temp.matrix[largestValue][i])&&j!=i)
 					largestValue=j;
 			}
-			detFactor*=-1;
+			sign*=-1;
 			temp.swapRow(i,largestValue);
-			if (solve)
-				b.swapRow(i,largestValue);
+			swaps.push_back(i);
+			swaps.push_back(largestValue);
 		}
 		/* populate L & U */
-		L[i][i]=temp.matrix[i][i];
+		L.matrix[i][i]=temp.matrix[i][i];
 		for (unsigned int j=i+1;j<n;j++)
-			L[j][i]=temp.matrix[j][i];
+			L.matrix[j][i]=temp.matrix[j][i];
 		temp.pivot(i,i);
 		for (unsigned int j=i+1;j<m;j++)
-			U[i][j]=temp.matrix[i][j];
+			U.matrix[i][j]=temp.matrix[i][j];
 	}
-	if (solve)
-	{
-		/* check if the matrix is singular */
-		for (unsigned int i=0;i<m;i++)
-		{
-			for (unsigned int j=0;j<n;j++)
-			{
-				if (fabs(temp.matrix[i][j])>DBL_EPSILON)
-					break;
-				else if (j==(n-1))
-					singular=true;
-			}
-			if (singular)
-				break;
-		}
-		if (!singular)
-		{
-			/* solve y by forward subsitution */
-			for (unsigned int i=0;i<m;i++)
-			{
-				c=0.0;
-				for (unsigned int j=0;j<i;j++)
-					c+=L.matrix[i][j]*y[j][0];
-				y.matrix[i][0]=(b.matrix[i][0]-c)/L.matrix[i][i];
-			}
-			/* solve x by back substitution */
-			for (unsigned int i=m-1;i<m;i--)
-			{
-				c=0.0;
-				for (unsigned int j=i+1;j<m;j++)
-					c+=U.matrix[i][j]*b[j][0];
-				b.matrix[i][0]=y.matrix[i][0]-c;
-			}
-		}
-		else
-			std::cout<<"Matrix is singular. Solution does not exist."<<std::endl;
-	}
-	LU->A=temp;
-	LU->L=L;
-	LU->U=U;
-	LU->exists=false;
-	LU->solved=false;
-	if (solve)
-	{
-		LU->solved=true;
-		if (!singular)
-			LU->exists=true;
-	}
-	/* std::cout<<"y: "<<std::endl;
-	std::cout<<y<<std::endl;
-	std::cout<<"b: "<<std::endl;
-	std::cout<<b<<std::endl;
-	std::cout<<"L: "<<std::endl;
-	std::cout<<L<<std::endl;
-	std::cout<<"U: "<<std::endl;
-	std::cout<<U<<std::endl; */
-	return *LU;
+	LU.A=temp;
+	LU.L=L;
+	LU.U=U;
+	LU.exists=false;
+	LU.solved=false;
+	return sign;
 }
 
 //! Pivot Around An Element
@@ -695,6 +808,7 @@ void Matrix::pivot(unsigned int a,unsigned int b,bool rowReduce)
 	if (a>=m||b>=n)
 		throw LinAlgException("Dimensions out of bounds");
 	double pivotElement=matrix[a][b];
+	unsigned long flops=n;
 	if (fabs(pivotElement)<DBL_EPSILON)
 		throw LinAlgException("Divide by zero");
 	for (unsigned int i=0;i<n;i++)
@@ -706,8 +820,11 @@ void Matrix::pivot(unsigned int a,unsigned int b,bool rowReduce)
 			double factor=matrix[i][b];
 			for (unsigned int j=0;j<n;j++)
 				matrix[i][j]=matrix[i][j]-factor*matrix[a][j];
+			flops+=2*n;
 		}
 	}
+	touch();
+	LINALG_FLOPS(OP_PIVOT,flops);
 }
 
 //! Row Reduced Echelon Form
@@ -738,6 +855,7 @@ void Matrix::rref()
 		for (unsigned int j=0;j<n;j++)
 			if (fabs(matrix[i][j])<DBL_EPSILON)
 				matrix[i][j]=0.0;
+	touch();
 }
 
 //! OpenGL glGetDoublev() Compatible Mutator
@@ -755,6 +873,7 @@ void Matrix::set(double *values,bool colOrder)
 			else
 				matrix[i][j]=values[n*i+j];
 		}
+	touch();
 }
 
 //! Two Dimensional Array Mutator
@@ -766,6 +885,7 @@ void Matrix::set(double **values)
 	for (unsigned int i=0;i<m;i++)
 		for (unsigned int j=0;j<n;j++)
 			matrix[i][j]=values[i][j];
+	touch();
 }
 
 //! std::vector Mutator
@@ -777,6 +897,7 @@ void Matrix::set(std::vector< std::vector<double> > &values)
 	for (unsigned int i=0;i<m;i++)
 		for (unsigned int j=0;j<n;j++)
 			matrix[i][j]=values[i][j];
+	touch();
 }
 
 //! Standard Mutator
@@ -787,6 +908,7 @@ void Matrix::set(std::vector< std::vector<double> > &values)
 void Matrix::set(unsigned int a,unsigned int b,double v)
 {
 	matrix[a][b]=v;
+	touch();
 }
 
 //! Swap Columns
@@ -803,6 +925,7 @@ void Matrix::swapCol(unsigned int a,unsigned int b)
 		matrix[i][a]=matrix[i][b];
 		matrix[i][b]=temp;
 	}
+	touch();
 }
 
 //! Swap Rows
@@ -819,6 +942,7 @@ void Matrix::swapRow(unsigned int a,unsigned int b)
 		matrix[a][i]=matrix[b][i];
 		matrix[b][i]=temp;
 	}
+	touch();
 }
 
 //! Transpose
@@ -850,3 +974,54 @@ double *Matrix::values(bool colOrder)
 				values[i*n+j]=matrix[i][j];
 	return values;
 }
+
+//! Version Accessor
+/*! The modification counter. Two calls returning the same value mean the Matrix was not modified in between, so callers can skip work that depends only on its contents.
+  \return the version */
+unsigned long Matrix::revision()
+{
+	return version;
+}
+
+//! Record A Modification
+/*! Called by every mutator. Bumping the version makes every cached result stale at once. Call it after writing to wrapped rows directly. */
+void Matrix::touch()
+{
+	version++;
+}
+
+//! Cache Accessor
+/*! Creates the cache on first use.
+  \return the cache */
+struct MatrixCache &Matrix::cached()
+{
+	if (!cache)
+		cache=new MatrixCache;
+	return *cache;
+}
+
+//! Current LU Factors
+/*! Factors the Matrix unless the cached factors are current.
+  \throw LinAlgException if the Matrix is not square
+  \return the cache with current LU factors */
+struct MatrixCache &Matrix::factored()
+{
+	if (n!=m)
+		throw LinAlgException("Not a square matrix");
+	MatrixCache &c=cached();
+	if (c.luVersion!=version)
+	{
+		c.detFactor=decompose(c.lu,c.swaps);
+		c.singular=zeroRow(c.lu.A,m,n);
+		c.luVersion=version;
+	}
+	return c;
+}
+
+//! Wrap Accessor
+/*! Indicates whether the Matrix operates on rows it does not own.
+  \return true if the Matrix wraps the caller's rows */
+bool Matrix::wraps()
+{
+	return wrapped;
+}
@@ -0,0 +1,91 @@
+#include <cmath>
+#include <utility>
+#include "robot.h"
+
+/*! \file mesh.cpp
+  \brief Procedural Meshes
+
+  Implements the functions that generate the vertex data for the Robot's shapes on the CPU, which PaletteMesh merges into its buffers. The shapes follow the GLU quadrics they replace: cylinders run along \f$+z\f$ from \f$z=0\f$ to their height, disks lie in a plane of constant \f$z\f$, and texture coordinates are laid out as \c gluQuadricTexture() would. */
+
+//! Add A Vertex
+/*! \param data the mesh to add to
+  \param x the \f$x\f$ coordinate
+  \param y the \f$y\f$ coordinate
+  \param z the \f$z\f$ coordinate
+  \param nx the \f$x\f$ component of the normal
+  \param ny the \f$y\f$ component of the normal
+  \param nz the \f$z\f$ component of the normal
+  \param s the \f$s\f$ texture coordinate
+  \param t the \f$t\f$ texture coordinate */
+static void addVertex(MeshData &data, GLfloat x, GLfloat y, GLfloat z, GLfloat nx, GLfloat ny, GLfloat nz, GLfloat s, GLfloat t)
+{
+	MeshVertex vertex = {{x, y, z}, {nx, ny, nz}, {s, t}};
+	data.vertices.push_back(vertex);
+}
+
+//! Add A Grid Of Quads
+/*! Joins \f$(rows+1)\times(columns+1)\f$ vertices, added row by row starting at \a first, into two triangles per cell.
+  \param data the mesh to add to
+  \param first the index of the first vertex of the grid
+  \param rows the number of rows of cells
+  \param columns the number of columns of cells
+  \param reverse if true, the triangles are wound the other way */
+static void addGrid(MeshData &data, GLuint first, int rows, int columns, bool reverse)
+{
+	for (int i=0; i<rows; i++)
+		for (int j=0; j<columns; j++)
+		{
+			GLuint a = first + i * (columns + 1) + j, b = a + columns + 1;
+			GLuint triangles[6] = {a, a + 1, b + 1, a, b + 1, b};
+			if (reverse)
+			{
+				std::swap(triangles[1], triangles[2]);
+				std::swap(triangles[4], triangles[5]);
+			}
+			data.indices.insert(data.indices.end(), triangles, triangles + 6);
+		}
+}
+
+//! Generate A Cylinder Wall
+/*! Adds the side of a cylinder around the \f$z\f$ axis, like \c gluCylinder() with equal radii. The ends are left open; close them with meshDisk().
+  \param data the mesh to add to
+  \param radius the radius
+  \param height the length along \f$z\f$
+  \param slices the number of subdivisions around the axis
+  \param stacks the number of subdivisions along the axis */
+void meshCylinder(MeshData &data, GLfloat radius, GLfloat height, int slices, int stacks)
+{
+	GLuint first = data.vertices.size();
+	for (int i=0; i<=stacks; i++)
+		for (int j=0; j<=slices; j++)
+		{
+			double theta = 2.0 * M_PI * j / slices;
+			GLfloat c = cos(theta), s = sin(theta);
+			addVertex(data, radius * s, radius * c, height * i / stacks, s, c, 0.0f, (GLfloat)j / slices, (GLfloat)i / stacks);
+		}
+	/* the grid comes out clockwise seen from outside */
+	addGrid(data, first, stacks, slices, true);
+}
+
+//! Generate A Disk
+/*! Adds a disk around the \f$z\f$ axis, like \c gluDisk() with no hole.
+  \param data the mesh to add to
+  \param radius the radius
+  \param z the plane the disk lies in
+  \param up true if the disk faces \f$+z\f$, false if it faces \f$-z\f$
+  \param slices the number of subdivisions around the axis
+  \param loops the number of rings from the center out */
+void meshDisk(MeshData &data, GLfloat radius, GLfloat z, bool up, int slices, int loops)
+{
+	GLuint first = data.vertices.size();
+	GLfloat nz = up ? 1.0f : -1.0f;
+	for (int i=0; i<=loops; i++)
+		for (int j=0; j<=slices; j++)
+		{
+			double theta = 2.0 * M_PI * j / slices;
+			GLfloat r = radius * i / loops, x = r * sin(theta), y = r * cos(theta);
+			addVertex(data, x, y, z, 0.0f, 0.0f, nz, 0.5f + x / (2.0f * radius), 0.5f + y / (2.0f * radius));
+		}
+	/* the grid comes out counterclockwise seen from +z */
+	addGrid(data, first, loops, slices, !up);
+}
@@ -0,0 +1,41 @@
+#include "mipmap.h"
+
+/*! \file mipmap.cpp
+  \brief Mip Level Filter
+
+  Implements the \f$2\times2\f$ box filter declared in mipmap.h. */
+
+//! Halve An Image
+/*! Fills \a level with \a above scaled to half its size. Each texel is the rounded average of a \f$2\times2\f$ box of \a above; the smaller size is rounded down as OpenGL sizes its levels, so when a dimension is odd its last row or column is dropped, and a dimension of 1 stays 1 by averaging its one row or column with itself. Runs on the CPU, so it works the same under software OpenGL.
+  \param above the RGBA texels of the larger image
+  \param width the width of \a above
+  \param height the height of \a above
+  \param stride the bytes between rows of \a above
+  \param level receives the RGBA texels of the smaller image, mipExtent(width, 1) by mipExtent(height, 1)
+  \param levelStride the bytes between rows of \a level */
+void mipHalve(const unsigned char *above, int width, int height, int stride, unsigned char *level, int levelStride)
+{
+	int lw = mipExtent(width, 1), lh = mipExtent(height, 1);
+	for (int y=0; y<lh; y++)
+	{
+		const unsigned char *row0 = above + (2 * y < height ? 2 * y : height - 1) * stride;
+		const unsigned char *row1 = above + (2 * y + 1 < height ? 2 * y + 1 : height - 1) * stride;
+		unsigned char *target = level + y * levelStride;
+		for (int x=0; x<lw; x++)
+		{
+			int x0 = 2 * x < width ? 2 * x : width - 1, x1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+			for (int c=0; c<4; c++)
+				target[4 * x + c] = (row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c] + 2) / 4;
+		}
+	}
+}
+
+//! Level Size
+/*! \param extent the width or height of level 0
+  \param level the level
+  \return the width or height of \a level, never less than 1 */
+int mipExtent(int extent, int level)
+{
+	extent >>= level;
+	return extent ? extent : 1;
+}
@@ -0,0 +1,12 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+/*! \file mipmap.h
+  \brief Mip Level Filter
+
+  The filter that builds each level of a mip chain from the one above it, on raw RGBA bytes so that it doesn't depend on Qt. mipChain() uses it for the Cube's textures and the \c texture_bench program uses it for its test texture. */
+
+void mipHalve(const unsigned char *above, int width, int height, int stride, unsigned char *level, int levelStride);
+int mipExtent(int extent, int level);
+
+#endif
@@ -0,0 +1,295 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "linalg.h"
+#include "simd.h"
+
+/*! \file mixed.cpp
+  \brief Mixed Precision Solver
+
+  Implements Matrix::solveMixed(). The Matrix is factored in single precision by a blocked LU with partial pivoting whose trailing updates run through simdRankUpdate(), which does twice the work per instruction of double precision and moves half the memory. The single precision solution is then corrected in double precision: each round computes the residual \f$r=b-Ax\f$ in double, solves \f$LUd=r\f$ with the single precision factors and adds \f$d\f$ to \f$x\f$. As long as \f$\kappa(A)\f$ is well below \f$1/\epsilon_{float}\approx10^7\f$ every round gains about seven digits, so two or three rounds reach full double precision at \f$O(n^2)\f$ each. If the corrections stop shrinking the Matrix is too ill conditioned for that, and it is factored again in double. */
+
+//! Block Size
+/*! Number of columns factored per panel. The trailing update works on blocks this deep. */
+#define MIXED_BLOCK 64
+
+//! Maximum Refinement Rounds
+/*! Rounds allowed before giving up on the single precision factors. */
+#define MIXED_MAX_ROUNDS 10
+
+//! Double Precision Rank Update
+/*! \f$C\leftarrow C-AB\f$ for the double precision fallback. Plain loops; the fallback is the rare case.
+  \param c the \f$rows\times cols\f$ block to update
+  \param a the \f$rows\times depth\f$ left factor
+  \param b the \f$depth\times cols\f$ right factor
+  \param rows the number of rows of \a c
+  \param cols the number of columns of \a c
+  \param depth the inner dimension
+  \param ld the row stride of all three blocks */
+static void rankUpdate(double *c,const double *a,const double *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	for (unsigned int i=0;i<rows;i++)
+		for (unsigned int k=0;k<depth;k++)
+		{
+			double aik=a[(size_t)i*ld+k];
+			for (unsigned int j=0;j<cols;j++)
+				c[(size_t)i*ld+j]-=aik*b[(size_t)k*ld+j];
+		}
+}
+
+//! Single Precision Rank Update
+/*! Forwards to simdRankUpdate() so factorBlocked() can be written once for both precisions. */
+static void rankUpdate(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	simdRankUpdate(c,a,b,rows,cols,depth,ld);
+}
+
+//! Blocked LU Decomposition
+/*! Factors the row major \f$n\times n\f$ array \a a in place into a unit lower triangular \f$L\f$ below the diagonal and \f$U\f$ on and above it, with partial pivoting. Each panel of \c MIXED_BLOCK columns is factored column by column, the matching rows of \f$U\f$ are solved for, and the rest of the matrix gets one rank update.
+  \param a the array to factor
+  \param n the dimension
+  \param pivots receives the row swapped with row \f$k\f$ at step \f$k\f$
+  \param flops incremented by the floating point operations performed
+  \return false if a pivot is zero or not finite */
+template<class T>
+static bool factorBlocked(T *a,unsigned int n,unsigned int *pivots,unsigned long &flops)
+{
+	for (unsigned int k0=0;k0<n;k0+=MIXED_BLOCK)
+	{
+		unsigned int kb=n-k0<MIXED_BLOCK?n-k0:MIXED_BLOCK,end=k0+kb;
+		/* factor the panel */
+		for (unsigned int k=k0;k<end;k++)
+		{
+			unsigned int p=k;
+			for (unsigned int i=k+1;i<n;i++)
+				if (fabs(a[(size_t)i*n+k])>fabs(a[(size_t)p*n+k]))
+					p=i;
+			T pivot=a[(size_t)p*n+k];
+			if (pivot==0||!std::isfinite(pivot))
+				return false;
+			pivots[k]=p;
+			if (p!=k)
+				for (unsigned int j=0;j<n;j++)
+				{
+					T t=a[(size_t)k*n+j];
+					a[(size_t)k*n+j]=a[(size_t)p*n+j];
+					a[(size_t)p*n+j]=t;
+				}
+			const T *rk=a+(size_t)k*n;
+			for (unsigned int i=k+1;i<n;i++)
+			{
+				T *ri=a+(size_t)i*n;
+				ri[k]/=pivot;
+				for (unsigned int j=k+1;j<end;j++)
+					ri[j]-=ri[k]*rk[j];
+			}
+			flops+=(unsigned long)(n-k-1)*(2*(end-k-1)+1);
+		}
+		if (end==n)
+			break;
+		/* rows of U right of the panel: solve with the unit lower triangle of the panel */
+		for (unsigned int k=k0;k<end;k++)
+			for (unsigned int i=k+1;i<end;i++)
+			{
+				T lik=a[(size_t)i*n+k];
+				for (unsigned int j=end;j<n;j++)
+					a[(size_t)i*n+j]-=lik*a[(size_t)k*n+j];
+				flops+=2ul*(n-end);
+			}
+		/* trailing update */
+		rankUpdate(a+(size_t)end*n+end,a+(size_t)end*n+k0,a+(size_t)k0*n+end,n-end,n-end,kb,n);
+		flops+=2ul*(n-end)*(n-end)*kb;
+	}
+	return true;
+}
+
+//! Triangular Solves
+/*! Solves \f$LUx=Pb\f$ with the factors from factorBlocked(), overwriting \a x.
+  \param a the factors
+  \param n the dimension
+  \param pivots the row swaps
+  \param x the right hand side, replaced by the solution */
+template<class T>
+static void substitute(const T *a,unsigned int n,const unsigned int *pivots,T *x)
+{
+	for (unsigned int k=0;k<n;k++)
+		if (pivots[k]!=k)
+		{
+			T t=x[k];
+			x[k]=x[pivots[k]];
+			x[pivots[k]]=t;
+		}
+	for (unsigned int i=1;i<n;i++)
+	{
+		const T *ri=a+(size_t)i*n;
+		T s=x[i];
+		for (unsigned int j=0;j<i;j++)
+			s-=ri[j]*x[j];
+		x[i]=s;
+	}
+	for (unsigned int i=n-1;i<n;i--)
+	{
+		const T *ri=a+(size_t)i*n;
+		T s=x[i];
+		for (unsigned int j=i+1;j<n;j++)
+			s-=ri[j]*x[j];
+		x[i]=s/ri[i];
+	}
+}
+
+//! Iterative Refinement
+/*! Refines every column of \a X against \a B until the residual is down to what rounding in double precision leaves, \f$\|b-Ax\|_\infty\le\sqrt n\epsilon\|A\|_\infty\|x\|_\infty\f$, the same test LAPACK's \c dsgesv uses. Stops early if the corrections stop shrinking. The refined columns are written back either way.
+  \param A the Matrix rows
+  \param n the dimension
+  \param aNorm \f$\|A\|_\infty\f$
+  \param factors the LU factors to solve for corrections with
+  \param pivots the row swaps of \a factors
+  \param B the right hand sides
+  \param X the solutions, refined in place
+  \param k the number of right hand sides
+  \param rounds raised to the largest number of rounds any column took
+  \param flops incremented by the floating point operations performed
+  \return true if every column converged */
+template<class T>
+static bool refine(double **A,unsigned int n,double aNorm,const T *factors,const unsigned int *pivots,double **B,double **X,unsigned int k,unsigned int &rounds,unsigned long &flops)
+{
+	std::vector<double> x(n);
+	std::vector<T> d(n);
+	double tolerance=sqrt((double)n)*DBL_EPSILON;
+	bool converged=true;
+	for (unsigned int c=0;c<k&&converged;c++)
+	{
+		double last=HUGE_VAL;
+		for (unsigned int j=0;j<n;j++)
+			x[j]=X[j][c];
+		for (unsigned int r=0;;r++)
+		{
+			double xNorm=0.0,rNorm=0.0,dNorm=0.0;
+			for (unsigned int i=0;i<n;i++)
+			{
+				double ri=B[i][c]-simdDot(A[i],&x[0],n);
+				d[i]=(T)ri;
+				rNorm=fmax(rNorm,fabs(ri));
+				xNorm=fmax(xNorm,fabs(x[i]));
+			}
+			flops+=2ul*n*n;
+			if (rNorm<=tolerance*aNorm*xNorm)
+				break;
+			if (r==MIXED_MAX_ROUNDS)
+			{
+				converged=false;
+				break;
+			}
+			rounds=r+1>rounds?r+1:rounds;
+			substitute(factors,n,pivots,&d[0]);
+			for (unsigned int i=0;i<n;i++)
+			{
+				x[i]+=d[i];
+				dNorm=fmax(dNorm,fabs((double)d[i]));
+			}
+			flops+=2ul*n*n+n;
+			/* a correction that isn't at most half the last one means kappa(A) is too large for these factors */
+			if (dNorm>0.5*last)
+			{
+				converged=false;
+				break;
+			}
+			last=dNorm;
+		}
+		for (unsigned int j=0;j<n;j++)
+			X[j][c]=x[j];
+	}
+	return converged;
+}
+
+//! Mixed Precision Solver
+/*! Solves \f$AX=B\f$ ``in place'' for every column of \a b by a single precision LU decomposition and iterative refinement in double precision. The result is as accurate as LU(Matrix &b) for matrices with \f$\kappa(A)\lesssim10^6\f$, at about half the cost of a double precision factorization for large \f$n\f$. Beyond that the single precision factors can't converge, and the Matrix is factored again in double precision and refined with those factors.
+  \param b \f$n\times k\f$ right hand sides, replaced by the solutions
+  \throw LinAlgException if the Matrix is not square, \a b has the wrong number of rows, or the Matrix is singular
+  \return struct MixedSolution describing what it took
+  \sa LU(Matrix &b) */
+struct MixedSolution Matrix::solveMixed(Matrix &b)
+{
+	if (n!=m)
+		throw LinAlgException("Not a square matrix");
+	if (b.m!=m)
+		throw LinAlgException("Incompatible dimensions for Matrix b");
+	MixedSolution result;
+	result.rounds=0;
+	result.residual=0.0;
+	result.fallback=false;
+	if (n==0)
+		return result;
+	unsigned long flops=0;
+	double aNorm=0.0;
+	for (unsigned int i=0;i<n;i++)
+	{
+		double s=0.0;
+		for (unsigned int j=0;j<n;j++)
+			s+=fabs(matrix[i][j]);
+		aNorm=fmax(aNorm,s);
+	}
+	std::vector<unsigned int> pivots(n);
+	Matrix x=b;
+	{
+		std::vector<float> factors((size_t)n*n);
+		std::vector<float> y(n);
+		for (unsigned int i=0;i<n;i++)
+			for (unsigned int j=0;j<n;j++)
+				factors[(size_t)i*n+j]=(float)matrix[i][j];
+		if (factorBlocked(&factors[0],n,&pivots[0],flops))
+		{
+			for (unsigned int c=0;c<b.n;c++)
+			{
+				for (unsigned int i=0;i<n;i++)
+					y[i]=(float)b.matrix[i][c];
+				substitute(&factors[0],n,&pivots[0],&y[0]);
+				for (unsigned int i=0;i<n;i++)
+					x.matrix[i][c]=y[i];
+			}
+			result.fallback=!refine(matrix,n,aNorm,&factors[0],&pivots[0],b.matrix,x.matrix,b.n,result.rounds,flops);
+		}
+		else
+			result.fallback=true;
+	}
+	if (result.fallback)
+	{
+		std::vector<double> factors((size_t)n*n);
+		for (unsigned int i=0;i<n;i++)
+			for (unsigned int j=0;j<n;j++)
+				factors[(size_t)i*n+j]=matrix[i][j];
+		if (!factorBlocked(&factors[0],n,&pivots[0],flops))
+			throw LinAlgException("Singular matrix");
+		std::vector<double> y(n);
+		for (unsigned int c=0;c<b.n;c++)
+		{
+			for (unsigned int i=0;i<n;i++)
+				y[i]=b.matrix[i][c];
+			substitute(&factors[0],n,&pivots[0],&y[0]);
+			for (unsigned int i=0;i<n;i++)
+				x.matrix[i][c]=y[i];
+		}
+		result.rounds=0;
+		refine(matrix,n,aNorm,&factors[0],&pivots[0],b.matrix,x.matrix,b.n,result.rounds,flops);
+	}
+	/* relative backward error of the worst column */
+	std::vector<double> column(n);
+	for (unsigned int c=0;c<b.n;c++)
+	{
+		double rNorm=0.0,xNorm=0.0;
+		for (unsigned int i=0;i<n;i++)
+			column[i]=x.matrix[i][c];
+		for (unsigned int i=0;i<n;i++)
+		{
+			rNorm=fmax(rNorm,fabs(b.matrix[i][c]-simdDot(matrix[i],&column[0],n)));
+			xNorm=fmax(xNorm,fabs(column[i]));
+		}
+		if (aNorm*xNorm>0.0)
+			result.residual=fmax(result.residual,rNorm/(aNorm*xNorm));
+	}
+	b=x;
+	LINALG_FLOPS(OP_LU,flops);
+	return result;
+}
@@ -0,0 +1,305 @@
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include "robot.h"
+
+/*! \file palettemesh.cpp
+  \brief Matrix Palette Meshes
+
+  Implements PaletteMesh. Every PaletteMesh shares one program, which poses each vertex by its part's matrix and shades each fragment with lightingShader from the lights and materials in Shading's uniform buffers. Parts can be told to take their material from their vertex color regardless of the current material, which lets parts with different materials share the one draw call. */
+
+//! Part Attribute
+/*! Location of the palette index attribute; clear of the fixed function arrays. */
+#define PALETTE_ATTRIBUTE 10
+
+//! Palette Vertex Shader
+/*! Poses and transforms one vertex, and hands its eye coordinates and normal on to be lit per fragment. The palette holds 32 matrices, enough for any PaletteMesh, so one program serves them all. */
+static const char *paletteVertexShader =
+	"#version 140\n"
+	"#extension GL_ARB_compatibility : require\n"
+	"in float part;\n"
+	"uniform mat4 palette[32];\n"
+	"uniform int colored;\n"
+	"uniform int textured;\n"
+	"out vec3 eye;\n"
+	"out vec3 normal;\n"
+	"out vec4 color;\n"
+	"out vec2 st;\n"
+	"out float cartoon;\n"
+	"out float texturing;\n"
+	"void main()\n"
+	"{\n"
+	"	int i = int(part);\n"
+	"	vec4 position = gl_ModelViewMatrix * (palette[i] * gl_Vertex);\n"
+	"	gl_Position = gl_ProjectionMatrix * position;\n"
+	"	eye = position.xyz / position.w;\n"
+	"	normal = gl_NormalMatrix * (mat3(palette[i]) * gl_Normal);\n"
+	"	color = gl_Color;\n"
+	"	st = gl_MultiTexCoord0.st;\n"
+	"	cartoon = (colored & (1 << i)) != 0 ? 1.0 : 0.0;\n"
+	"	texturing = (textured & (1 << i)) != 0 ? 1.0 : 0.0;\n"
+	"}\n";
+
+//! Palette Fragment Shader
+/*! Lights one fragment and modulates it by the bound texture on textured parts, like \c GL_MODULATE; appended to lightingShader. */
+static const char *paletteFragmentShader =
+	"in vec3 eye;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"in vec2 st;\n"
+	"in float cartoon;\n"
+	"in float texturing;\n"
+	"uniform sampler2D image;\n"
+	"out vec4 fragment;\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 lit = shade(eye, normal, color, cartoon > 0.5);\n"
+	"	fragment = texturing > 0.5 ? lit * texture(image, st) : lit;\n"
+	"}\n";
+
+//! Shared Program
+/*! The program every PaletteMesh draws with; NULL while no PaletteMesh holds it. */
+static QOpenGLShaderProgram *sharedProgram;
+
+//! Program Holders
+/*! Number of PaletteMeshes holding sharedProgram. */
+static unsigned int programHolders;
+
+//! Program Linked Flag
+/*! Flag that indicates whether sharedProgram is usable. */
+static bool programLinked;
+
+//! Acquire The Shared Program
+/*! Returns the shared program, building it only if nobody holds it yet. Every call must be matched by releaseProgram(). The GL context must be current.
+  \return the program, which is only usable if programLinked is set */
+static QOpenGLShaderProgram *acquireProgram()
+{
+	if (programHolders++)
+		return sharedProgram;
+	sharedProgram = new QOpenGLShaderProgram();
+	programLinked = false;
+	if (!Shading::available()
+	    || !sharedProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, paletteVertexShader)
+	    || !sharedProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, (std::string(lightingShader) + paletteFragmentShader).c_str()))
+		return sharedProgram;
+	sharedProgram->bindAttributeLocation("part", PALETTE_ATTRIBUTE);
+	if (!sharedProgram->link())
+	{
+		std::cerr << "palette disabled: " << sharedProgram->log().toStdString() << std::endl;
+		return sharedProgram;
+	}
+	Shading::bind(sharedProgram);
+	sharedProgram->setUniformValue("image", 0);
+	programLinked = true;
+	return sharedProgram;
+}
+
+//! Release The Shared Program
+/*! Gives up one hold on the shared program, freeing it when it was the last. The GL context must be current. */
+static void releaseProgram()
+{
+	if (--programHolders)
+		return;
+	GLState::useProgram(NULL);
+	delete sharedProgram;
+	sharedProgram = NULL;
+}
+
+//! PaletteMesh Constructor
+/*! Creates an empty mesh. Nothing is allocated on the GPU until upload() is called.
+  \param size the number of parts, at most 32 */
+PaletteMesh::PaletteMesh(unsigned int size) : indexBuffer(QOpenGLBuffer::IndexBuffer)
+{
+	parts = size;
+	count = 0;
+	program = NULL;
+	shaded = false;
+}
+
+//! PaletteMesh Destructor
+/*! Frees the buffers on the GPU and releases the program. The GL context they were created in must be current. */
+PaletteMesh::~PaletteMesh()
+{
+	if (program)
+		releaseProgram();
+	array.destroy();
+	vertexBuffer.destroy();
+	indexBuffer.destroy();
+}
+
+//! Add Method
+/*! Adds a piece of a part.
+  \param part the part, which is posed by entry \a part of the palette
+  \param data the piece's vertices and triangles in the part's own coordinates
+  \param color array containing the piece's color in the form \f$(r,g,b)\f$
+  \return the number draw() knows the piece by */
+unsigned int PaletteMesh::add(unsigned int part, const MeshData &data, const double *color)
+{
+	GLuint base = vertices.size();
+	PalettePiece piece = {part, (GLuint)indices.size(), (GLsizei)data.indices.size()};
+	for (unsigned int i=0; i<data.vertices.size(); i++)
+	{
+		const MeshVertex &v = data.vertices[i];
+		PaletteVertex vertex = {{v.position[0], v.position[1], v.position[2]}, {v.normal[0], v.normal[1], v.normal[2]}, {v.st[0], v.st[1]},
+			{(GLfloat)color[0], (GLfloat)color[1], (GLfloat)color[2]}, (GLfloat)part};
+		vertices.push_back(vertex);
+	}
+	for (unsigned int i=0; i<data.indices.size(); i++)
+		indices.push_back(base + data.indices[i]);
+	pieces.push_back(piece);
+	return pieces.size() - 1;
+}
+
+//! Upload Method
+/*! Copies the vertices of every piece added so far into the vertex buffer. The triangles follow on the next draw(). The GL context must be current. */
+void PaletteMesh::upload()
+{
+	if (!vertexBuffer.isCreated())
+	{
+		vertexBuffer.create();
+		indexBuffer.create();
+	}
+	vertexBuffer.bind();
+	vertexBuffer.allocate(vertices.empty() ? NULL : &vertices[0], vertices.size() * sizeof(PaletteVertex));
+	vertexBuffer.release();
+	/* the piece numbers may mean something else now */
+	selection.clear();
+	count = 0;
+	RENDER_COUNT(RENDER_MESH_UPLOADS, 1);
+}
+
+//! Draw Method
+/*! Draws the chosen pieces, each posed by its part's matrix under the current modelview matrix, lit by Shading's lights in its current material, in one \c glDrawElements. Where the program isn't available, the pieces are drawn one at a time by the fixed function pipeline instead. The GL context must be current.
+  \param pieces the pieces to draw, as returned by add()
+  \param palette array of one transform per part, from the part's own coordinates to the modelview's; they may only scale uniformly
+  \param colored bitmask of the parts whose material is their vertex color without specular highlights, as if \c GL_COLOR_MATERIAL were enabled for \c GL_AMBIENT_AND_DIFFUSE and the specular color were black, whatever the current material
+  \param textured bitmask of the parts that are modulated by the texture bound to unit 0 */
+void PaletteMesh::draw(const std::vector<unsigned int> &pieces, const Mat4 *palette, unsigned int colored, unsigned int textured)
+{
+	if (vertices.empty())
+		return;
+	if (!program)
+		initialize();
+	if (pieces != selection)
+		select(pieces);
+	if (!shaded)
+	{
+		GLfloat black[] = {0.0, 0.0, 0.0, 1.0};
+		GLuint first = 0;
+		GLState::useProgram(NULL);
+		bindArrays();
+		for (unsigned int i=0; i<selection.size(); i++)
+		{
+			const PalettePiece &piece = this->pieces[selection[i]];
+			glPushMatrix();
+			glMultMatrixd(palette[piece.part].m);
+			/* changed behind GLState's back, but restored before it is used again */
+			glPushAttrib(GL_LIGHTING_BIT | GL_ENABLE_BIT);
+			glEnable(GL_NORMALIZE);
+			if (colored & (1 << piece.part))
+			{
+				glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+				glEnable(GL_COLOR_MATERIAL);
+				glMaterialfv(GL_FRONT, GL_SPECULAR, black);
+			}
+			if (textured & (1 << piece.part))
+				glEnable(GL_TEXTURE_2D);
+			glDrawElements(GL_TRIANGLES, piece.count, GL_UNSIGNED_INT, (const GLvoid *)(first * sizeof(GLuint)));
+			RENDER_COUNT(RENDER_DRAW_CALLS, 1);
+			RENDER_COUNT(RENDER_TRIANGLES, piece.count / 3);
+			glPopAttrib();
+			glPopMatrix();
+			first += piece.count;
+		}
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		indexBuffer.release();
+		vertexBuffer.release();
+		return;
+	}
+	QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+	std::vector<GLfloat> matrices(16 * parts);
+	for (unsigned int i=0; i<16*parts; i++)
+		matrices[i] = palette[i / 16].m[i % 16];
+	GLState::useProgram(program);
+	gl->glUniformMatrix4fv(program->uniformLocation("palette"), parts, GL_FALSE, &matrices[0]);
+	program->setUniformValue("material", (int)Shading::getMaterial());
+	program->setUniformValue("colored", (int)colored);
+	program->setUniformValue("textured", (int)textured);
+	array.bind();
+	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, NULL);
+	RENDER_COUNT(RENDER_DRAW_CALLS, 1);
+	RENDER_COUNT(RENDER_TRIANGLES, count / 3);
+	array.release();
+}
+
+//! Matches Method
+/*! Tells whether two meshes were built alike: the same parts, and the same pieces with the same vertices and triangles, added in the same order so that they have the same numbers.
+  \param other the mesh to compare with
+  \return true if drawing \a other would give the same result */
+bool PaletteMesh::matches(const PaletteMesh &other) const
+{
+	if (parts != other.parts || vertices.size() != other.vertices.size() || indices != other.indices || pieces.size() != other.pieces.size())
+		return false;
+	for (unsigned int i=0; i<pieces.size(); i++)
+		if (pieces[i].part != other.pieces[i].part || pieces[i].first != other.pieces[i].first || pieces[i].count != other.pieces[i].count)
+			return false;
+	return vertices.empty() || !memcmp(&vertices[0], &other.vertices[0], vertices.size() * sizeof(PaletteVertex));
+}
+
+//! Select Method
+/*! Rewrites the index buffer with the triangles of the chosen pieces, one after the other.
+  \param pieces the pieces to draw, as returned by add() */
+void PaletteMesh::select(const std::vector<unsigned int> &pieces)
+{
+	std::vector<GLuint> chosen;
+	for (unsigned int i=0; i<pieces.size(); i++)
+	{
+		const PalettePiece &piece = this->pieces[pieces[i]];
+		chosen.insert(chosen.end(), indices.begin() + piece.first, indices.begin() + piece.first + piece.count);
+	}
+	indexBuffer.bind();
+	indexBuffer.allocate(chosen.empty() ? NULL : &chosen[0], chosen.size() * sizeof(GLuint));
+	indexBuffer.release();
+	selection = pieces;
+	count = chosen.size();
+	RENDER_COUNT(RENDER_MESH_UPLOADS, 1);
+}
+
+//! Bind Vertex Arrays
+/*! Binds the vertex and index buffers and points the fixed function position, normal, texture coordinate and color arrays into the vertex buffer; the buffers stay bound. */
+void PaletteMesh::bindArrays()
+{
+	vertexBuffer.bind();
+	indexBuffer.bind();
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(PaletteVertex), (const GLvoid *)offsetof(PaletteVertex, position));
+	glNormalPointer(GL_FLOAT, sizeof(PaletteVertex), (const GLvoid *)offsetof(PaletteVertex, normal));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(PaletteVertex), (const GLvoid *)offsetof(PaletteVertex, st));
+	glColorPointer(3, GL_FLOAT, sizeof(PaletteVertex), (const GLvoid *)offsetof(PaletteVertex, color));
+}
+
+//! Initialize Method
+/*! Takes hold of the shared program and records the arrays in a vertex array object. Leaves shaded false if the context can't run the program or lacks vertex array objects. */
+void PaletteMesh::initialize()
+{
+	program = acquireProgram();
+	if (!programLinked || !array.create())
+		return;
+	QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+	array.bind();
+	bindArrays();
+	gl->glVertexAttribPointer(PALETTE_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, sizeof(PaletteVertex), (const GLvoid *)offsetof(PaletteVertex, part));
+	gl->glEnableVertexAttribArray(PALETTE_ATTRIBUTE);
+	array.release();
+	vertexBuffer.release();
+	indexBuffer.release();
+	shaded = true;
+}
@@ -0,0 +1,258 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+/*! \file parallel.cpp
+  \brief Parallel Vector Operations
+
+  The worker pool behind LinAlgThreads. The calling thread works alongside the pool, claiming chunks from a shared counter until none are left, so the pool has one thread fewer than LinAlgThreads::count(). Only one job runs at a time; a job started from inside a worker runs serially on that worker instead of waiting on itself. */
+
+//! Pool Job
+/*! One call to runChunks() or sumChunks(). Lives on the caller's stack. */
+struct poolJob
+{
+	std::function<void(unsigned long)> task; /*!< Runs One Chunk */
+	unsigned long chunks; /*!< Number Of Chunks */
+	std::atomic<unsigned long> next; /*!< Next Chunk To Claim */
+	std::atomic<unsigned long> done; /*!< Number Of Chunks Finished */
+	unsigned int users; /*!< Workers Holding The Job; Guarded By The Pool Mutex */
+};
+
+//! Worker Flag
+/*! True on pool threads, and on the calling thread while it drains a job, so nested parallel calls fall back to serial. */
+static thread_local bool insideWorker=false;
+
+//! Worker Pool
+/*! Persistent threads that sleep until a job is posted. */
+class workerPool
+{
+public:
+	workerPool(unsigned int threads);
+	~workerPool();
+	void execute(poolJob &job);
+private:
+	void work();
+	static void drain(poolJob &job);
+	//! Worker Threads
+	std::vector<std::thread> workers;
+	//! Pool Mutex
+	/*! Guards current, generation, stop and poolJob::users. */
+	std::mutex lock;
+	//! Job Posted Or Stopping
+	std::condition_variable wake;
+	//! Job Finished Or Released
+	std::condition_variable finished;
+	//! Job Being Worked On
+	/*! NULL between jobs. */
+	poolJob *current;
+	//! Job Counter
+	/*! Bumped for every job so a worker never runs the same job twice. */
+	unsigned long generation;
+	//! Shutdown Flag
+	bool stop;
+};
+
+//! Pool Constructor
+/*! Starts \a threads workers.
+  \param threads the number of worker threads */
+workerPool::workerPool(unsigned int threads)
+{
+	current=NULL;
+	generation=0;
+	stop=false;
+	for (unsigned int i=0;i<threads;i++)
+		workers.push_back(std::thread(&workerPool::work,this));
+}
+
+//! Pool Destructor
+/*! Stops and joins the workers. */
+workerPool::~workerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop=true;
+	}
+	wake.notify_all();
+	for (unsigned int i=0;i<workers.size();i++)
+		workers[i].join();
+}
+
+//! Claim Chunks
+/*! Runs chunks of \a job until all have been claimed.
+  \param job the job */
+void workerPool::drain(poolJob &job)
+{
+	unsigned long c;
+	while ((c=job.next++)<job.chunks)
+	{
+		job.task(c);
+		job.done++;
+	}
+}
+
+//! Worker Loop
+/*! Waits for a job, helps drain it and releases it. */
+void workerPool::work()
+{
+	unsigned long seen=0;
+	insideWorker=true;
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;)
+	{
+		while (!stop&&(generation==seen||!current))
+			wake.wait(guard);
+		if (stop)
+			return;
+		seen=generation;
+		poolJob *job=current;
+		job->users++;
+		guard.unlock();
+		drain(*job);
+		guard.lock();
+		if (--job->users==0&&job->done==job->chunks)
+			finished.notify_all();
+	}
+}
+
+//! Run A Job
+/*! Posts \a job, drains it on the calling thread too and returns once every chunk has finished and no worker still refers to it.
+  \param job the job */
+void workerPool::execute(poolJob &job)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		current=&job;
+		generation++;
+	}
+	wake.notify_all();
+	/* the caller holds jobLock, so its own nested calls must not start another job */
+	bool nested=insideWorker;
+	insideWorker=true;
+	drain(job);
+	insideWorker=nested;
+	std::unique_lock<std::mutex> guard(lock);
+	while (job.done!=job.chunks||job.users)
+		finished.wait(guard);
+	current=NULL;
+}
+
+//! Requested Thread Count
+/*! Zero until the count is first needed. */
+static unsigned int threadCount=0;
+
+//! Pool Instance
+/*! Created on the first parallel job and replaced when the thread count changes. */
+static workerPool *pool=NULL;
+
+//! Job Mutex
+/*! Serializes jobs and changes to the pool. */
+static std::mutex jobLock;
+
+//! Thread Count
+/*! The number of threads parallel operations use, including the caller. Taken from \c LINALG_THREADS if it is set to a positive whole number, otherwise from the hardware, and capped at \c LINALG_MAX_THREADS.
+  \return the thread count */
+unsigned int LinAlgThreads::count()
+{
+	std::lock_guard<std::mutex> guard(jobLock);
+	if (!threadCount)
+	{
+		const char *env=getenv("LINALG_THREADS");
+		if (env)
+		{
+			char *end;
+			long threads=strtol(env,&end,10);
+			/* anything but a positive whole number is ignored */
+			if (end!=env&&!*end&&threads>0)
+				threadCount=threads>(long)LINALG_MAX_THREADS?LINALG_MAX_THREADS:threads;
+		}
+		if (!threadCount)
+			threadCount=std::thread::hardware_concurrency();
+		if (!threadCount)
+			threadCount=1;
+		if (threadCount>LINALG_MAX_THREADS)
+			threadCount=LINALG_MAX_THREADS;
+	}
+	return threadCount;
+}
+
+//! Set Thread Count
+/*! Changes the number of threads used by later parallel operations. Results do not depend on it.
+  \param threads the thread count, capped at \c LINALG_MAX_THREADS; 0 restores the default */
+void LinAlgThreads::setCount(unsigned int threads)
+{
+	std::lock_guard<std::mutex> guard(jobLock);
+	threadCount=threads>LINALG_MAX_THREADS?LINALG_MAX_THREADS:threads;
+	delete pool;
+	pool=NULL;
+}
+
+//! Serial Check
+/*! Tells whether parallel operations on this thread must run serially: on the pool's threads and on a thread draining a job, where starting another job would wait on the job already running, or when there is only one thread. Asks for the thread count only outside jobs, since count() takes the job mutex.
+  \return true if the work should run on the calling thread alone */
+bool LinAlgThreads::serial()
+{
+	return insideWorker||count()==1;
+}
+
+//! Execute Chunks
+/*! Runs \a task for chunk indices \f$0..chunks-1\f$, in parallel when possible.
+  \param chunks the number of chunks
+  \param task the work for one chunk */
+static void execute(unsigned long chunks,const std::function<void(unsigned long)> &task)
+{
+	if (insideWorker||LinAlgThreads::count()==1)
+	{
+		for (unsigned long c=0;c<chunks;c++)
+			task(c);
+		return;
+	}
+	std::lock_guard<std::mutex> guard(jobLock);
+	if (!pool)
+		pool=new workerPool(threadCount-1);
+	poolJob job;
+	job.task=task;
+	job.chunks=chunks;
+	job.next=0;
+	job.done=0;
+	job.users=0;
+	pool->execute(job);
+}
+
+//! Chunked Loop
+/*! Implementation of run() for arrays of more than one chunk.
+  \param n the number of elements
+  \param chunk the number of elements per chunk
+  \param body the work for a range */
+void LinAlgThreads::runChunks(unsigned long n,unsigned long chunk,const std::function<void(unsigned long,unsigned long)> &body)
+{
+	execute((n+chunk-1)/chunk,[&](unsigned long c)
+	{
+		unsigned long begin=c*chunk;
+		body(begin,begin+chunk<n?begin+chunk:n);
+	});
+}
+
+//! Chunked Sum
+/*! Implementation of sum() for arrays of more than one chunk. The partial sums are stored by chunk and added in order afterwards, which is what makes the result independent of the thread count.
+  \param n the number of elements
+  \param body the partial sum of a range
+  \return the total */
+double LinAlgThreads::sumChunks(unsigned long n,const std::function<double(unsigned long,unsigned long)> &body)
+{
+	unsigned long chunks=(n+LINALG_CHUNK-1)/LINALG_CHUNK;
+	std::vector<double> partial(chunks);
+	execute(chunks,[&](unsigned long c)
+	{
+		unsigned long begin=c*LINALG_CHUNK;
+		partial[c]=body(begin,begin+LINALG_CHUNK<n?begin+LINALG_CHUNK:n);
+	});
+	double answer=0.0;
+	for (unsigned long c=0;c<chunks;c++)
+		answer+=partial[c];
+	return answer;
+}
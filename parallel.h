@@ -0,0 +1,68 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+/*! \file parallel.h
+  \brief Parallel Vector Operations
+
+  A small worker pool for element-wise and reduction work on very large arrays. Work is cut into fixed chunks of \c LINALG_CHUNK elements no matter how many threads there are. Reductions keep one partial result per chunk and add the partials in chunk order, so a sum comes out bit for bit the same with one thread or sixteen. Arrays of one chunk or less never touch the pool, so small Vectors pay nothing.
+
+  The thread count defaults to the number of hardware threads and can be set with the \c LINALG_THREADS environment variable or LinAlgThreads::setCount(), up to \c LINALG_MAX_THREADS. */
+
+//! Chunk Size
+/*! Elements per unit of work. Part of the result definition for reductions: changing it changes the last bits of large sums. */
+#define LINALG_CHUNK 32768ul
+
+//! Thread Limit
+/*! Most threads parallel operations use, whatever \c LINALG_THREADS or LinAlgThreads::setCount() asks for. */
+#define LINALG_MAX_THREADS 256u
+
+//! Linear Algebra Threads
+/*! Static interface to the worker pool. */
+class LinAlgThreads
+{
+public:
+	static unsigned int count();
+	static void setCount(unsigned int threads);
+	//! Parallel Loop
+	/*! Calls \a body on consecutive ranges covering \f$[0,n)\f$. The ranges run concurrently, so \a body must only touch the elements in its range.
+	  \param n the number of elements
+	  \param body callable taking the half open range <tt>(begin,end)</tt> */
+	template <class Body> static void run(unsigned long n,Body body)
+	{
+		if (n<2*LINALG_CHUNK||serial())
+			body(0ul,n);
+		else
+			runChunks(n,LINALG_CHUNK,std::function<void(unsigned long,unsigned long)>(body));
+	}
+	//! Parallel Loop With A Grain
+	/*! Like run(), but cut into ranges of \a grain elements, for loops whose elements are too costly to batch by the \c LINALG_CHUNK, such as binning lights. The ranges run concurrently, so \a body must only touch the elements in its range.
+	  \param n the number of elements
+	  \param grain the number of elements per range
+	  \param body callable taking the half open range <tt>(begin,end)</tt> */
+	template <class Body> static void run(unsigned long n,unsigned long grain,Body body)
+	{
+		if (n<2*grain||serial())
+			body(0ul,n);
+		else
+			runChunks(n,grain,std::function<void(unsigned long,unsigned long)>(body));
+	}
+	//! Parallel Sum
+	/*! Adds up \a body over consecutive chunks covering \f$[0,n)\f$ in a fixed order.
+	  \param n the number of elements
+	  \param body callable taking the half open range <tt>(begin,end)</tt> and returning its partial sum
+	  \return the sum of the partial sums in chunk order */
+	template <class Body> static double sum(unsigned long n,Body body)
+	{
+		if (n<=LINALG_CHUNK)
+			return body(0ul,n);
+		return sumChunks(n,std::function<double(unsigned long,unsigned long)>(body));
+	}
+private:
+	static bool serial();
+	static void runChunks(unsigned long n,unsigned long chunk,const std::function<void(unsigned long,unsigned long)> &body);
+	static double sumChunks(unsigned long n,const std::function<double(unsigned long,unsigned long)> &body);
+};
+
+#endif
@@ -1,9 +1,45 @@
 #include "robot.h"
+#include <QImageReader>
 #include <QtOpenGL>
 #include <cmath>
 
 #define INITIAL_WINDOW_SIZE 500
 
+//! Face Loader
+/*! Loads one face of the Cube through the TextureCache on a worker thread, then hands it to QRobot::faceLoaded() on the GUI thread, which owns the GL context. */
+class faceLoader : public QRunnable
+{
+public:
+	//! Face Loader Constructor
+	/*! \param target the QRobot to notify
+	  \param source the cache to load through
+	  \param name the image file
+	  \param number the face, from 0 to 5
+	  \param destination the mip chain to fill; only this loader touches it until the notification */
+	faceLoader(QRobot *target, TextureCache *source, const QString &name, unsigned short number, std::vector<QImage> *destination)
+	{
+		robot = target;
+		cache = source;
+		fileName = name;
+		face = number;
+		chain = destination;
+	}
+	//! Load The Face
+	/*! Runs on a worker thread. */
+	void run()
+	{
+		bool cached;
+		bool loaded = cache->load(fileName, *chain, cached);
+		QMetaObject::invokeMethod(robot, "faceLoaded", Qt::QueuedConnection, Q_ARG(int, face), Q_ARG(bool, loaded), Q_ARG(bool, cached));
+	}
+private:
+	QRobot *robot; /*!< QRobot To Notify */
+	TextureCache *cache; /*!< Cache To Load Through */
+	QString fileName; /*!< Image File */
+	unsigned short face; /*!< Face Number */
+	std::vector<QImage> *chain; /*!< Mip Chain To Fill */
+};
+
 //! QRobot Constructor
 /*! Allocates objects needed by QRobot. Also sets up initial parameters.
   \param parent parent QWidget; automatically handled by Qt */
@@ -19,13 +55,22 @@ QRobot::QRobot(QWidget *parent) : QGLWidget(parent)
 	zRot = 0.0;
 	lights = new Lighting();
 	connect(lights, SIGNAL(GLDraw()), this, SLOT(GLDraw()));
+	/* ROBOT_LIGHTS strews that many local lights around the floor */
+	const char *env = getenv("ROBOT_LIGHTS");
+	if (env)
+		lights->scatterLocalLights(atoi(env), zoomDistance / 2.0);
 	textures = false;
 	viewMode = true;
 	currLight = NONE;
 	currLightCoords = new GLfloat[4];
-	faces = new QImage*[6];
+	robot = NULL;
+	floor = NULL;
+	faces = new std::vector<QImage>[6];
+	ready = new bool[6];
 	for (unsigned short i=0; i<6; i++)
-		faces[i] = new QImage;
+		ready[i] = false;
+	cache = new TextureCache();
+	loaders = new QThreadPool();
 	loadFaces();
 }
 
@@ -33,12 +78,24 @@ QRobot::QRobot(QWidget *parent) : QGLWidget(parent)
 /*! Frees allocated objects needed by QRobot. */
 QRobot::~QRobot()
 {
+	/* the loaders write to faces and the cache */
+	loaders->waitForDone();
+	delete loaders;
+	/* the Cube frees its textures and the meshes their buffers, which needs the context */
+	makeCurrent();
 	delete robot;
+	delete floor;
+	Shading::destroy();
 	delete lights;
 	delete currLightCoords;
-	for (unsigned short i=0; i<6; i++)
-		delete faces[i];
-	delete faces;
+	/* the faces may point into the cache's mappings */
+	delete[] faces;
+	delete[] ready;
+	delete cache;
+	if (LinAlgStats::enabled())
+		LinAlgStats::report(std::cerr);
+	if (RenderStats::enabled())
+		RenderStats::report(std::cerr);
 }
 
 //! Sets Minimum Size
@@ -64,15 +121,15 @@ Lighting *QRobot::getLights()
 }
 
 //! Get Textures
-/*! Returns Pointer to an array of pointers of type QImage containing OpenGL compatible texture data. This is used to send the Cube class the texture data it needs.
-  \return pointer to the array of pointers */
-QImage **QRobot::getFaces()
+/*! Returns Pointer to an array of 6 mip chains containing OpenGL compatible texture data. This is used to send the Cube class the texture data it needs.
+  \return pointer to the array of mip chains */
+std::vector<QImage> *QRobot::getFaces()
 {
 	return faces;
 }
 
 //! Get Texture Flag
-/*! Returns the texture flag. This flag is true when loadFaces() exits sucessfully. It is false otherwise. This method is used to tell Cube and QWindow as to whether the textures are ready.
+/*! Returns the texture flag. This flag is true when loadFaces() finds all six images, and turns false if one of them later fails to decode. This method is used to tell Cube and QWindow as to whether the textures are ready.
   \return true if the textures are ready, false if not */
 bool QRobot::texturesLoaded()
 {
@@ -108,19 +165,20 @@ void QRobot::dropCube()
 }
 
 //! Load Cube Textures
-/*! This method reads \c textures/diceN.png (for \f$n=1,2,\cdots,6\f$) and converts them from PNG to OpenGL format. The OpenGL images are then stored in the faces array. */
+/*! This method starts loading \c textures/diceN.png (for \f$n=1,2,\cdots,6\f$) on the loaders and returns without waiting. Only the image headers are read here, for the size of the Cube's texture atlas. Each face is decoded, converted to OpenGL format and given a mip chain through the TextureCache on a worker thread, and arrives in faceLoaded(). Until then the Cube shows placeholders.
+  \sa faceLoaded() */
 void QRobot::loadFaces()
 {
-	QImage buffer;
 	QString fileName;
+	QString fileNames[6];
+	faceWidth = faceHeight = 0;
 	for (unsigned short i=0; i<6; i++)
 	{
 		fileName = "textures/dice";
 		fileName += ('1' + i);
 		fileName += ".png";
-		if (buffer.load(fileName))
-			(*faces[i]) = QGLWidget::convertToGLFormat(buffer);
-		else
+		QSize size = QImageReader(fileName).size();
+		if (!size.isValid())
 		{
 			fileName = "Unable to load texture image ";
 			fileName += ('1' + i);
@@ -128,8 +186,15 @@ void QRobot::loadFaces()
 			Error((char *)fileName.toStdString().data());
 			return;
 		}
+		if (size.width() > faceWidth)
+			faceWidth = size.width();
+		if (size.height() > faceHeight)
+			faceHeight = size.height();
+		fileNames[i] = fileName;
 	}
 	textures = true;
+	for (unsigned short i=0; i<6; i++)
+		loaders->start(new faceLoader(this, cache, fileNames[i], i, &faces[i]));
 }
 
 //! Set Current Light
@@ -195,6 +260,39 @@ void QRobot::setMaterial(unsigned short newMat)
 	updateGL();
 }
 
+//! Face Loaded Slot
+/*! Receives a face from the loaders started by loadFaces(). The face is uploaded into the Cube's atlas right away if the GL context exists; otherwise initializeGL() uploads it.
+  \param face the face, from 0 to 5
+  \param loaded true if the face was decoded, false if it failed
+  \param cached true if the face came from the TextureCache, false if it was decoded */
+void QRobot::faceLoaded(int face, bool loaded, bool cached)
+{
+	/* counted here since RenderStats belongs to the GUI thread */
+	if (loaded)
+		RENDER_COUNT(cached ? RENDER_CACHE_HITS : RENDER_CACHE_MISSES, 1);
+	if (!loaded)
+	{
+		/* only complain once */
+		if (textures)
+		{
+			QString message = "Unable to load texture image ";
+			message += ('1' + face);
+			message += '.';
+			textures = false;
+			if (robot)
+				robot->setTexturing(false);
+			Error((char *)message.toStdString().data());
+		}
+		return;
+	}
+	ready[face] = true;
+	if (!robot)
+		return;
+	makeCurrent();
+	robot->loadFace(face, faces[face]);
+	updateGL();
+}
+
 //! Mode Slot
 /*! This is used by QWindow to set whether the Robot is in view/rotate mode or control mode.
   \param whichMode the new mode */
@@ -241,13 +339,33 @@ void QRobot::setTemperature(double newTemp)
 /*! This method is overloaded from QGLWidget and is used to setup the initial OpenGL environment. The constructors from Robot and Lighting is all that's really needed here. */
 void QRobot::initializeGL()
 {
+	GLState::invalidate();
 	robot=new Robot();
-	robot->loadFaces(faces);
+	/* the floor is a square standing on one corner, with its corners a unit from the center */
+	MeshData square;
+	const GLfloat corners[4][2] = {{1.0, 0.0}, {0.0, 1.0}, {-1.0, 0.0}, {0.0, -1.0}};
+	for (unsigned short i=0; i<4; i++)
+	{
+		MeshVertex vertex = {{corners[i][0], corners[i][1], 0.0}, {0.0, 1.0, 0.0}, {0.5f * (corners[i][0] + 1.0f), 0.5f * (corners[i][1] + 1.0f)}};
+		square.vertices.push_back(vertex);
+	}
+	const GLuint triangles[6] = {0, 1, 2, 0, 2, 3};
+	const double floorColor[3] = {0.0, 0.5, 0.25};
+	square.indices.assign(triangles, triangles + 6);
+	floor = new PaletteMesh(1);
+	floor->add(0, square, floorColor);
+	floor->upload();
+	robot->setTexturing(textures);
+	robot->reserveFaces(faceWidth, faceHeight);
+	/* faces that finished loading before there was a context */
+	for (unsigned short i=0; i<6; i++)
+		if (ready[i])
+			robot->loadFace(i, faces[i]);
 	lights->enable();
 }
 
 //! Resize Event Handler
-/*! This method is overloaded from QGLWidget and is called whenever the widget is resized (programatically disabled) or when the user zooms in or out.
+/*! This method is overloaded from QGLWidget and is called whenever the widget is resized (programatically disabled) or when the user zooms in or out. The Robot is told the new projection so it can pick how finely to draw its cylinders.
   \param w new widget width
   \param h new widget height */
 void QRobot::resizeGL(int w, int h)
@@ -256,12 +374,17 @@ void QRobot::resizeGL(int w, int h)
 	window_height = h;
 	glViewport(0, 0, (GLsizei) w, (GLsizei) h);
 
+	Mat4 lens = Mat4::perspective(60.0, 1.0, 1.0, zoomDistance);
+	projection = lens
+		* Mat4::lookAt(0.0, -zoomDistance/2.0, 30.0,
+			       0.0, 0.0, 0.0,
+			       0.0, 0.0, 1.0);
+	/* the lens maps a unit length at unit distance to lens.m[5] half viewports */
+	if (robot)
+		robot->setProjection(projection, lens.m[5] * h / 2.0);
+	lights->setProjection(projection, 1.0, zoomDistance, w, h);
 	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(60.0, 1.0, 1.0, zoomDistance);
-	gluLookAt(0.0, -zoomDistance/2.0, 30.0,
-			  0.0, 0.0, 0.0,
-			  0.0, 0.0, 1.0);
+	glLoadMatrixd(projection.m);
 	glMatrixMode(GL_MODELVIEW);
 }
 
@@ -269,16 +392,17 @@ void QRobot::resizeGL(int w, int h)
 /*! This method is overloaded from QGLWidget and is called whenever updateGL() is called or whenever the GLDraw signal is received from Lighting. This method will also move the current light in unison with the camera. */
 void QRobot::paintGL()
 {
+	LinAlgScope stats=LinAlgStats::scope("paintGL");
 	/* save old flag states */
 	bool oldGrab = robot->grabbed(), oldRange = robot->inRange(), oldDrop = robot->dropped();
 
 	/* clear the screen and rotate the world */
 	glClearColor(0.0, 0.8, 1.0, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glLoadIdentity();
-	glRotated(xRot, 1.0, 0.0, 0.0);
-	glRotated(yRot, 0.0, 1.0, 0.0);
-	glRotated(zRot, 0.0, 0.0, 1.0);
+	Mat4 view = Mat4::rotate(xRot, 1.0, 0.0, 0.0)
+		* Mat4::rotate(yRot, 0.0, 1.0, 0.0)
+		* Mat4::rotate(zRot, 0.0, 0.0, 1.0);
+	glLoadMatrixd(view.m);
 	if (currLight != NONE)
 	{
 		try
@@ -289,32 +413,29 @@ void QRobot::paintGL()
 				M is the modelview matrix
 				P is the projection matrix
 				O is the origin (i.e. O = [0 0 0 1]^T */
-			double values[16];
-			glGetDoublev(GL_PROJECTION_MATRIX, values);
-			Matrix projection(values, 16);
-			glGetDoublev(GL_MODELVIEW_MATRIX, values);
-			Matrix modelview(values, 16);
+			Matrix P(projection.m, 16);
+			Matrix modelview(view.m, 16);
 			Matrix transformation(4, 4);
 			Matrix camera(4, 1), origin(4, 1);
 			origin[3][0] = 1.0;
-			transformation = modelview.inverse() * projection;
+			transformation = modelview.inverse() * P;
 			camera = transformation * origin;
 			currLightCoords[0] = camera[0][0];
 			currLightCoords[1] = camera[1][0];
 			currLightCoords[2] = camera[2][0];
 			currLightCoords[3] = 1.0;
-			glLightfv(GL_LIGHT0 + (currLight - 1), GL_POSITION, currLightCoords);
 		}
 		catch (LinAlgException e)
 		{
 			Error(e.what());
 		}
 	}
+	lights->apply(view, currLight, currLightCoords);
 	/* draw the floor and run the robot/cube through its paces */
-	glDisable(GL_DEPTH_TEST);
-	drawFloor();
-	glEnable(GL_DEPTH_TEST);
-	robot->draw();
+	GLState::disable(GL_DEPTH_TEST);
+	drawFloor(view);
+	GLState::enable(GL_DEPTH_TEST);
+	robot->draw(view);
 	robot->grabCube();
 	/* cube was dropped */
 	if (robot->dropped() && oldDrop != robot->dropped())
@@ -339,6 +460,7 @@ void QRobot::paintGL()
 			emit cubeGrabbed(tr("Cube is on the floor."));
 	}
 	swapBuffers();
+	RenderStats::frame();
 }
 
 //! Mouse Click Event Handler
@@ -437,34 +559,22 @@ void QRobot::Error(char *msg)
 }
 
 //! Draw Floor Function
-/*! This method draws the floor. It is called by paintGL().
+/*! This method draws the floor, unless it is out of view. It is called by paintGL().
+  \param view the viewing transform the scene is drawn under
   \sa paintGL() */
-void QRobot::drawFloor()
+void QRobot::drawFloor(const Mat4 &view)
 {
-	/* cartoon style parameters */
-	GLfloat black[] = {0.0, 0.0, 0.0, 1.0};
-	GLfloat cartoon_ambient[] = {0.2, 0.2, 0.2, 1.0};
-	GLfloat cartoon_diffuse[] = {0.8, 0.8, 0.8, 1.0};
-	GLfloat cartoon_shininess = 16.0;
 	GLdouble floorSize = zoomDistance / 2.0;
+	Mat4 palette[1] = {Mat4::scale(floorSize, floorSize, floorSize)};
+	std::vector<unsigned int> pieces(1, 0);
+	const double corners[2][3] = {{-floorSize, -floorSize, 0.0}, {floorSize, floorSize, 0.0}};
+
+	if (Frustum(projection * view).test(boundsOf(corners[0], corners[1])) == CULL_OUTSIDE)
+	{
+		RENDER_COUNT(RENDER_PARTS_CULLED, 1);
+		return;
+	}
 
-	glPushMatrix();
-	/* foce the floor to be drawn in the cartoon style */
-	glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
-	glMaterialfv(GL_FRONT, GL_AMBIENT, cartoon_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, cartoon_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, black);
-	glMaterialf(GL_FRONT, GL_SHININESS, cartoon_shininess);
-	glEnable(GL_COLOR_MATERIAL);
-
-	/* define the floor */
-	glBegin(GL_QUADS);
-		glNormal3d(0.0, 1.0, 0.0);
-		glColor3d(0.0, 0.5, 0.25);
-		glVertex3d(floorSize, 0.0, 0.0);
-		glVertex3d(0.0, floorSize, 0.0);
-		glVertex3d(-floorSize, 0.0, 0.0);
-		glVertex3d(0.0, -floorSize, 0.0);
-	glEnd();
-	glPopMatrix();
+	/* the floor is drawn in the cartoon style whatever the robot's material */
+	floor->draw(pieces, palette, 1, 0);
 }
@@ -0,0 +1,45 @@
+# robot rendering benchmark: qmake render_bench.pro && make
+# draws the robot offscreen with 0 to 500 local lights; prints ms per frame as JSON on stdout
+SOURCES = renderbench.cpp \
+	  lighting.cpp \
+	  robot.cpp \
+	  shapes.cpp \
+	  mesh.cpp \
+	  glstate.cpp \
+	  shading.cpp \
+	  clusters.cpp \
+	  frustum.cpp \
+	  palettemesh.cpp \
+	  texture.cpp \
+	  texturecache.cpp \
+	  mipmap.cpp \
+	  matrix.cpp \
+	  banded.cpp \
+	  mixed.cpp \
+	  svd.cpp \
+	  vector.cpp \
+	  simd.cpp \
+	  parallel.cpp \
+	  linalgstats.cpp \
+	  renderstats.cpp \
+	  qrobot.cpp \
+	  robotwindow.cpp
+HEADERS = robot.h \
+	  linalg.h \
+	  linalgstats.h \
+	  renderstats.h \
+	  mipmap.h \
+	  simd.h \
+	  parallel.h \
+	  mat4.h
+TARGET = render_bench
+CONFIG += console release warn_on c++14
+CONFIG -= app_bundle
+QT += opengl widgets
+unix {
+	LIBS += -lGL -lGLU
+}
+# qmake CONFIG+=render_stats adds the draw calls, triangles and culled parts of the last frame
+render_stats {
+	DEFINES += RENDER_STATS
+}
@@ -0,0 +1,226 @@
+#include <QApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "robot.h"
+
+/*! \file renderbench.cpp
+  \brief Robot Rendering Benchmark
+
+  Standalone program (the \c render_bench target) that draws the Robot, the floor and any number of local lights with the same classes as QRobot, into an offscreen framebuffer, and prints the time per frame as JSON. Every frame turns the view a little further, so the light clusters are rebuilt and the culling changes from frame to frame as they would while the user drags.
+
+  For each light count it reports the mean wall clock time per frame, waiting for the GPU to finish, and the part of it spent binning the lights on the CPU. With <tt>CONFIG+=render_stats</tt> it also reports the draw calls, triangles and culled parts of the last frame. The \c checksum is a hash of the pixels of the last frame, so two builds can be checked for identical output by running both with the same options.
+
+  Usage: <tt>render_bench [--width n] [--height n] [--zoom d] [--lights n1,n2,...] [--frames n]</tt>. The default light counts are 0, 5, 50 and 500. Without a display, <tt>QT_QPA_PLATFORM=offscreen</tt> or another platform plugin with OpenGL support is needed. */
+
+//! Benchmark Options
+/*! Command line settings. */
+struct options
+{
+	int width; /*!< Viewport Width In Pixels */
+	int height; /*!< Viewport Height In Pixels */
+	double zoom; /*!< Distance Of The Camera, As QRobot's Zoom */
+	std::string lights; /*!< Comma Separated Local Light Counts */
+	unsigned int frames; /*!< Frames Per Light Count */
+};
+
+//! Benchmark Scene
+/*! What QRobot draws, without the widget around it. */
+struct scene
+{
+	Robot *robot; /*!< The Robot */
+	PaletteMesh *floor; /*!< The Floor At Unit Size */
+	Lighting *lights; /*!< The Lights */
+	Mat4 projection; /*!< Perspective And Camera Transform */
+};
+
+//! Build The Scene
+/*! Sets up the Robot, the floor and the lights as QRobot::initializeGL() and QRobot::resizeGL() do, with the first light on.
+  \param opts the viewport and zoom
+  \param s the scene to fill */
+static void build(const options &opts, scene &s)
+{
+	GLState::invalidate();
+	s.robot = new Robot();
+	MeshData square;
+	const GLfloat corners[4][2] = {{1.0, 0.0}, {0.0, 1.0}, {-1.0, 0.0}, {0.0, -1.0}};
+	for (unsigned short i=0; i<4; i++)
+	{
+		MeshVertex vertex = {{corners[i][0], corners[i][1], 0.0}, {0.0, 1.0, 0.0}, {0.5f * (corners[i][0] + 1.0f), 0.5f * (corners[i][1] + 1.0f)}};
+		square.vertices.push_back(vertex);
+	}
+	const GLuint triangles[6] = {0, 1, 2, 0, 2, 3};
+	const double floorColor[3] = {0.0, 0.5, 0.25};
+	square.indices.assign(triangles, triangles + 6);
+	s.floor = new PaletteMesh(1);
+	s.floor->add(0, square, floorColor);
+	s.floor->upload();
+	s.lights = new Lighting();
+	s.lights->enable();
+	s.lights->lightSwitch1(Qt::Checked);
+	s.robot->setMaterial(GOLD);
+
+	Mat4 lens = Mat4::perspective(60.0, (double)opts.width / opts.height, 1.0, opts.zoom);
+	s.projection = lens * Mat4::lookAt(0.0, -opts.zoom / 2.0, 30.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0);
+	s.robot->setProjection(s.projection, lens.m[5] * opts.height / 2.0);
+	s.lights->setProjection(s.projection, 1.0, opts.zoom, opts.width, opts.height);
+	glViewport(0, 0, opts.width, opts.height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixd(s.projection.m);
+	glMatrixMode(GL_MODELVIEW);
+	GLState::enable(GL_CULL_FACE);
+}
+
+//! Draw A Frame
+/*! Draws the scene as QRobot::paintGL() does, turned \a angle degrees about the vertical axis, and waits for it to finish.
+  \param opts the zoom
+  \param s the scene
+  \param angle the turn about the vertical axis in degrees
+  \return milliseconds spent handing the lights to Shading, including binning them */
+static double drawFrame(const options &opts, scene &s, double angle)
+{
+	typedef std::chrono::steady_clock clock;
+	glClearColor(0.0, 0.8, 1.0, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	Mat4 view = Mat4::rotate(-20.0, 1.0, 0.0, 0.0) * Mat4::rotate(angle, 0.0, 0.0, 1.0);
+	glLoadMatrixd(view.m);
+	clock::time_point start = clock::now();
+	s.lights->apply(view);
+	double binning = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	GLdouble floorSize = opts.zoom / 2.0;
+	const double bounds[2][3] = {{-floorSize, -floorSize, 0.0}, {floorSize, floorSize, 0.0}};
+	if (Frustum(s.projection * view).test(boundsOf(bounds[0], bounds[1])) != CULL_OUTSIDE)
+	{
+		Mat4 palette[1] = {Mat4::scale(floorSize, floorSize, floorSize)};
+		std::vector<unsigned int> pieces(1, 0);
+		GLState::disable(GL_DEPTH_TEST);
+		s.floor->draw(pieces, palette, 1, 0);
+	}
+	GLState::enable(GL_DEPTH_TEST);
+	s.robot->draw(view);
+	glFinish();
+	RenderStats::frame();
+	return binning;
+}
+
+//! Frame Checksum
+/*! \param opts the viewport size
+  \return the FNV-1a hash of the pixels of the frame just drawn */
+static unsigned long checksum(const options &opts)
+{
+	std::vector<unsigned char> pixels(4 * opts.width * opts.height);
+	glReadPixels(0, 0, opts.width, opts.height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	unsigned long hash = 2166136261ul;
+	for (size_t i=0; i<pixels.size(); i++)
+		hash = ((hash ^ pixels[i]) * 16777619ul) & 0xfffffffful;
+	return hash;
+}
+
+//! Measure A Light Count
+/*! Strews \a count local lights as <tt>ROBOT_LIGHTS</tt> would, draws one frame to settle uploads and levels of detail, then times opts.frames frames and prints one result.
+  \param opts the command line options
+  \param s the scene
+  \param count the number of local lights
+  \param first whether this is the first result printed */
+static void measure(const options &opts, scene &s, unsigned int count, bool first)
+{
+	typedef std::chrono::steady_clock clock;
+	double binning = 0.0;
+	s.lights->scatterLocalLights(count, opts.zoom / 2.0);
+	drawFrame(opts, s, 0.0);
+	clock::time_point start = clock::now();
+	for (unsigned int i=0; i<opts.frames; i++)
+		binning += drawFrame(opts, s, 360.0 * (i + 1) / opts.frames);
+	double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	printf("%s\n    {\"lights\": %u, \"frames\": %u, \"ms_per_frame\": %.3f, \"binning_ms_per_frame\": %.3f, \"checksum\": \"%08lx\"",
+		first ? "" : ",", count, opts.frames, elapsed / opts.frames, binning / opts.frames, checksum(opts));
+	if (RenderStats::enabled())
+	{
+		RenderCounters counters = RenderStats::lastFrame();
+		printf(", \"draw_calls\": %lu, \"triangles\": %lu, \"parts_culled\": %lu",
+			counters.events[RENDER_DRAW_CALLS], counters.events[RENDER_TRIANGLES], counters.events[RENDER_PARTS_CULLED]);
+	}
+	printf("}");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	QApplication application(argc, argv);
+	options opts;
+	opts.width = 1024;
+	opts.height = 768;
+	opts.zoom = 300.0;
+	opts.lights = "0,5,50,500";
+	opts.frames = 100;
+	for (int i=1; i<argc; i++)
+	{
+		if (!strcmp(argv[i], "--width") && i + 1 < argc)
+			opts.width = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--height") && i + 1 < argc)
+			opts.height = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--zoom") && i + 1 < argc)
+			opts.zoom = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--lights") && i + 1 < argc)
+			opts.lights = argv[++i];
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			opts.frames = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [--width n] [--height n] [--zoom d] [--lights n1,n2,...] [--frames n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (opts.width < 1 || opts.height < 1 || opts.zoom <= 1.0 || opts.frames < 1)
+	{
+		fprintf(stderr, "%s: the viewport, zoom and frames must be positive\n", argv[0]);
+		return 1;
+	}
+
+	/* a compatibility profile, as QGLWidget gives QRobot */
+	QSurfaceFormat format;
+	format.setVersion(3, 1);
+	format.setProfile(QSurfaceFormat::CompatibilityProfile);
+	format.setDepthBufferSize(24);
+	QOpenGLContext context;
+	context.setFormat(format);
+	QOffscreenSurface surface;
+	surface.setFormat(format);
+	surface.create();
+	if (!context.create() || !context.makeCurrent(&surface))
+	{
+		fprintf(stderr, "%s: can't create an offscreen OpenGL context\n", argv[0]);
+		return 1;
+	}
+	QOpenGLFramebufferObject framebuffer(opts.width, opts.height, QOpenGLFramebufferObject::Depth);
+	framebuffer.bind();
+	scene s;
+	build(opts, s);
+	printf("{\n  \"benchmark\": \"render\",\n  \"renderer\": \"%s\",\n  \"viewport\": [%d, %d],\n  \"zoom\": %g,\n  \"results\": [",
+		(const char *)glGetString(GL_RENDERER), opts.width, opts.height, opts.zoom);
+	bool first = true;
+	for (const char *count=opts.lights.c_str(); *count; )
+	{
+		measure(opts, s, atoi(count), first);
+		first = false;
+		count = strchr(count, ',');
+		if (!count)
+			break;
+		count++;
+	}
+	printf("\n  ]\n}\n");
+	delete s.robot;
+	delete s.floor;
+	delete s.lights;
+	Shading::destroy();
+	framebuffer.release();
+	context.doneCurrent();
+	return 0;
+}
@@ -0,0 +1,162 @@
+#include <chrono>
+#include "renderstats.h"
+
+/*! \file renderstats.cpp
+  \brief Rendering Instrumentation
+
+  Storage for the counters declared in renderstats.h. */
+
+#ifdef RENDER_STATS
+
+//! Event Names
+/*! Names used by RenderStats::report(), indexed by renderEvents. */
+static const char *eventNames[RENDER_EVENT_COUNT]={"texture uploads","texture cache hits","texture cache misses","mesh uploads","draw calls","triangles","state changes","redundant state changes filtered","parts culled"};
+
+//! Global Counters
+/*! Running totals since the program started or since the last RenderStats::reset(). */
+static RenderCounters running;
+
+//! Current Frame
+/*! Events counted since the last frame was closed. */
+static unsigned long current[RENDER_EVENT_COUNT];
+
+//! Previous Frame
+/*! Events of the most recently closed frame. */
+static RenderCounters previous;
+
+//! First Frame
+/*! Events of the first frame, including everything counted before it was closed. */
+static unsigned long first[RENDER_EVENT_COUNT];
+
+//! Steady State Peak
+/*! Largest number of events of each type in any frame after the first. */
+static unsigned long steady[RENDER_EVENT_COUNT];
+
+//! Start Time
+/*! When start() was called. */
+static std::chrono::steady_clock::time_point started;
+
+//! Time To First Frame
+/*! Milliseconds from start() to the end of the first frame; negative until then. */
+static double ttff=-1.0;
+
+//! Event Hook
+/*! Adds \a n events of type \a event to the current frame.
+  \param event the event, one of renderEvents
+  \param n the number of events */
+void RenderStats::count(unsigned int event,unsigned long n)
+{
+	running.events[event]+=n;
+	current[event]+=n;
+}
+
+#endif
+
+//! Statistics Flag
+/*! Tells whether the program was built with \c RENDER_STATS.
+  \return true if counters are being collected */
+bool RenderStats::enabled()
+{
+#ifdef RENDER_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+//! Start The Clock
+/*! Marks the start of the program for firstFrame(). */
+void RenderStats::start()
+{
+#ifdef RENDER_STATS
+	started=std::chrono::steady_clock::now();
+	ttff=-1.0;
+#endif
+}
+
+//! Close A Frame
+/*! Called once at the end of every frame. The events counted since the previous call become lastFrame(). */
+void RenderStats::frame()
+{
+#ifdef RENDER_STATS
+	running.frames++;
+	if (running.frames==1)
+		ttff=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-started).count();
+	previous.frames=running.frames;
+	for (unsigned int i=0;i<RENDER_EVENT_COUNT;i++)
+	{
+		previous.events[i]=current[i];
+		if (running.frames==1)
+			first[i]=current[i];
+		else if (current[i]>steady[i])
+			steady[i]=current[i];
+		current[i]=0;
+	}
+#endif
+}
+
+//! Time To First Frame
+/*! \return milliseconds from start() to the end of the first frame, or a negative number if statistics are disabled or no frame has been closed */
+double RenderStats::firstFrame()
+{
+#ifdef RENDER_STATS
+	return ttff;
+#else
+	return -1.0;
+#endif
+}
+
+//! Counter Totals
+/*! Returns the global counters.
+  \return the counters; all zero if statistics are disabled */
+RenderCounters RenderStats::totals()
+{
+#ifdef RENDER_STATS
+	return running;
+#else
+	RenderCounters c={};
+	return c;
+#endif
+}
+
+//! Last Frame Counters
+/*! Returns the events of the most recently closed frame. Its frames field is the number of that frame.
+  \return the counters; all zero if statistics are disabled or no frame has been closed */
+RenderCounters RenderStats::lastFrame()
+{
+#ifdef RENDER_STATS
+	return previous;
+#else
+	RenderCounters c={};
+	return c;
+#endif
+}
+
+//! Print Statistics
+/*! Prints the totals of every event with the part charged to the first frame and the most seen in any later frame.
+  \param os the output stream */
+void RenderStats::report(std::ostream &os)
+{
+#ifdef RENDER_STATS
+	os<<"render: "<<running.frames<<" frames, first after "<<ttff<<" ms"<<std::endl;
+	for (unsigned int i=0;i<RENDER_EVENT_COUNT;i++)
+		os<<"  "<<eventNames[i]<<": "<<running.events[i]<<" total, "<<first[i]<<" in the first frame, at most "
+		  <<steady[i]<<" per frame after it"<<std::endl;
+#else
+	os<<"render: statistics disabled (build with CONFIG+=render_stats)"<<std::endl;
+#endif
+}
+
+//! Reset Statistics
+/*! Zeroes every counter, so the next frame closed counts as the first. */
+void RenderStats::reset()
+{
+#ifdef RENDER_STATS
+	RenderCounters c={};
+	running=c;
+	previous=c;
+	ttff=-1.0;
+	for (unsigned int i=0;i<RENDER_EVENT_COUNT;i++)
+		current[i]=first[i]=steady[i]=0;
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <iostream>
+
+/*! \file renderstats.h
+  \brief Rendering Instrumentation
+
+  Optional per frame counters for work the renderer should only do once, such as texture and mesh uploads, and the time to the first frame. Like linalgstats.h, the counters are only compiled in when \c RENDER_STATS is defined (<tt>qmake CONFIG+=render_stats</tt>) and every hook expands to nothing otherwise.
+
+  QRobot::paintGL() closes a frame with RenderStats::frame(). Work done before the first frame is closed, such as the uploads made by initializeGL(), is charged to the first frame, so RenderStats::report() can separate startup cost from the steady state. The time to the first frame is measured from RenderStats::start(), which main() calls before anything else. */
+
+//! Rendering Events
+/*! Enumeration of the events RenderStats counts. */
+enum renderEvents {RENDER_TEXTURE_UPLOADS, RENDER_CACHE_HITS, RENDER_CACHE_MISSES, RENDER_MESH_UPLOADS, RENDER_DRAW_CALLS, RENDER_TRIANGLES, RENDER_STATE_CHANGES, RENDER_STATE_FILTERED, RENDER_PARTS_CULLED, RENDER_EVENT_COUNT};
+
+//! Rendering Counters
+/*! A snapshot of the counters. */
+struct RenderCounters
+{
+	unsigned long frames; /*!< Frames Completed */
+	unsigned long events[RENDER_EVENT_COUNT]; /*!< Events By Type */
+};
+
+//! Rendering Statistics
+/*! Static interface to the rendering counters. */
+class RenderStats
+{
+public:
+	static bool enabled();
+	static void start();
+	static void frame();
+	static double firstFrame();
+	static RenderCounters totals();
+	static RenderCounters lastFrame();
+	static void report(std::ostream &os);
+	static void reset();
+#ifdef RENDER_STATS
+	static void count(unsigned int event,unsigned long n);
+#endif
+};
+
+/* hook used by the renderer; this vanishes unless RENDER_STATS is defined */
+#ifdef RENDER_STATS
+#define RENDER_COUNT(event,n) RenderStats::count(event,n)
+#else
+#define RENDER_COUNT(event,n) ((void)(event),(void)(n))
+#endif
+
+#endif
@@ -1,5 +1,60 @@
 #include "robot.h"
 #include <cmath>
+#include <QOpenGLContext>
+
+/* fixed offsets between the joints of the arm, folded at compile time */
+static constexpr Mat4 baseLift = Mat4::translate(0.0, 0.0, 10.0);
+static constexpr Mat4 shoulderMount = Mat4::translate(-10.0, 0.0, 30.0);
+static constexpr Mat4 shoulderJoint = Mat4::translate(20.0, 0.0, 0.0);
+
+//! Shared Body
+/*! One Robot mesh and the Robots drawing it. */
+struct sharedBody
+{
+	QOpenGLContext *context; /*!< The Context Holding Its Buffers */
+	PaletteMesh *mesh; /*!< The Mesh */
+	unsigned int holders; /*!< Number Of Robots Drawing It */
+};
+
+//! Shared Bodies
+/*! Every Robot mesh in use, each uploaded once for every Robot in its context that builds the same one. Robots sharing a mesh each draw it with their own palette and pieces; its index buffer is only rewritten when a draw chooses different pieces than the one before. */
+static std::vector<sharedBody> sharedBodies;
+
+//! Acquire A Body
+/*! Looks for a mesh in the current context that matches \a mesh. If there is one, \a mesh is deleted and the shared one is handed out instead; otherwise \a mesh is uploaded and shared from now on. Every call must be matched by releaseBody(). The GL context must be current.
+  \param mesh a Robot mesh that has been built but not uploaded
+  \return the mesh to draw */
+static PaletteMesh *acquireBody(PaletteMesh *mesh)
+{
+	QOpenGLContext *context = QOpenGLContext::currentContext();
+	for (unsigned int i=0; i<sharedBodies.size(); i++)
+		if (sharedBodies[i].context == context && sharedBodies[i].mesh->matches(*mesh))
+		{
+			delete mesh;
+			sharedBodies[i].holders++;
+			return sharedBodies[i].mesh;
+		}
+	mesh->upload();
+	sharedBody body = {context, mesh, 1};
+	sharedBodies.push_back(body);
+	return mesh;
+}
+
+//! Release A Body
+/*! Gives up one hold on a mesh from acquireBody(), freeing it when it was the last. The GL context it was uploaded in must be current.
+  \param mesh the mesh */
+static void releaseBody(PaletteMesh *mesh)
+{
+	for (unsigned int i=0; i<sharedBodies.size(); i++)
+		if (sharedBodies[i].mesh == mesh)
+		{
+			if (--sharedBodies[i].holders)
+				return;
+			delete mesh;
+			sharedBodies.erase(sharedBodies.begin() + i);
+			return;
+		}
+}
 
 //! Robot Constructor
 /*! Allocates objects needed by the Robot. Also sets up initial parameters. */
@@ -18,12 +73,17 @@ Robot::Robot()
 		c1 = new Cylinder(20.0, 10.0, 0.0, 0.0, 1.0);
 		c2 = new Cylinder(10.0, 20.0, 1.0, 0.0, 0.0);
 		c3 = new Cylinder(10.0, 20.0, 1.0, 1.0, 0.0, 90.0, j_hat);
-		c4 = new Cylinder(5.0, 30.0, 1.0, 0.0, 1.0, 90.0, j_hat);
-		c5 = new Cylinder(3.0, 30.0, 1.0, 0.0, 1.0, 90.0, j_hat);
+		/* the joints c4 to c8 are turned by draw() */
+		c4 = new Cylinder(5.0, 30.0, 1.0, 0.0, 1.0);
+		c5 = new Cylinder(3.0, 30.0, 1.0, 0.0, 1.0);
 		c6 = new Cylinder(1.0, 15.0, 1.0, 0.0, 0.0);
-		c7 = new Cylinder(1.0, 10.0, 1.0, 0.0, 0.0, 90.0, j_hat);
-		c8 = new Cylinder(1.0, 10.0, 1.0, 0.0, 0.0, 90.0, j_hat);
+		c7 = new Cylinder(1.0, 10.0, 1.0, 0.0, 0.0);
+		c8 = new Cylinder(1.0, 10.0, 1.0, 0.0, 0.0);
 		cube = new Cube(5.0);
+		body = NULL;
+		built = false;
+		projection = Mat4::identity();
+		lodScale = 0.0;
 		cubeModel = new Matrix(4, 4);
 		fingerModel = new Matrix(4, 4);
 		cubeOffset[0] = 40.0;
@@ -41,7 +101,7 @@ Robot::Robot()
 }
 
 //! Robot Destructor.
-/*! Frees allocated objects used by the Robot. */
+/*! Frees allocated objects used by the Robot and lets go of its mesh, so the GL context it was drawn in must be current. */
 Robot::~Robot()
 {
 	delete c1;
@@ -53,6 +113,8 @@ Robot::~Robot()
 	delete c7;
 	delete c8;
 	delete cube;
+	if (body)
+		releaseBody(body);
 	delete cubeModel;
 	delete fingerModel;
 }
@@ -82,9 +144,10 @@ bool Robot::inRange()
 }
 
 //! Mathematically grab the Cube
-/*! In general, the Cube is grabbed if \f$P=M_C^{-1}M_F\left[0\quad0\quad0\quad1\right]^T\f$. If \f$P_i<\epsilon\f$, the Cube is close enough and is considered grabbed. */
+/*! In general, the Cube is grabbed if \f$P=M_C^{-1}M_F\left[0\quad0\quad0\quad1\right]^T\f$, where \f$M_C\f$ and \f$M_F\f$ are the model matrices saved by draw(). If \f$P_i<\epsilon\f$, the Cube is close enough and is considered grabbed. */
 void Robot::grabCube()
 {
+	LinAlgScope stats=LinAlgStats::scope("grabCube");
 	try
 	{
 		double dx, dy, dz;
@@ -143,20 +206,20 @@ void Robot::grabCube()
 }
 
 //! Draw the Robot
-/*! OpenGL commands to define and draw the robot. */
-void Robot::draw()
+/*! OpenGL commands to define and draw the robot. Every transform is built on the CPU, so the model matrices used by grabCube() never have to be read back from OpenGL. The cylinders and the cube are parts of one PaletteMesh, each posed by its own matrix in the palette, so the whole Robot is a single draw call. Parts outside the view frustum are left out of it, and nothing is drawn if the whole Robot is. The cube keeps its cartoon material whatever the Robot is made of.
+  \param view the viewing transform the scene is drawn under */
+void Robot::draw(const Mat4 &view)
 {
+	LinAlgScope stats=LinAlgStats::scope("Robot::draw");
 	/* mathematical variables */
-	unsigned int material = robotMaterial;
-	double model[16];
+	Cylinder *cylinders[8] = {c1, c2, c3, c4, c5, c6, c7, c8};
+	Mat4 model, palette[ROBOT_PARTS], clip = projection * view;
+	std::vector<unsigned int> pieces;
 	double forearmOffsetX, forearmOffsetZ, shoulderRise, shoulderRun;
 	double cosPhi, sinPhi, phi;
 	double values[3] = {1.0, 0.0, 0.0};
 	Vector i_hat(values, 3);
 	values[0] = 0.0;
-	values[1] = 1.0;
-	Vector j_hat(values, 3);
-	values[1] = 0.0;
 	values[2] = 1.0;
 	Vector k_hat(values, 3);
 	Vector h(3), v_hat(3);
@@ -175,121 +238,130 @@ void Robot::draw()
 	v_hat.set(2, sinPhi);
 	h = v_hat % k_hat;
 	
-	/* draw the cube and save the transformation matrices */
-	glPushMatrix();
-	setMaterial(CARTOON);
-	glTranslated(cubeOffset[0], cubeOffset[1], cubeOffset[2]);
-	glRotated(cubeRotation[0], 1.0, 0.0, 0.0);
-	glRotated(cubeRotation[1], 0.0, 1.0, 0.0);
-	glRotated(cubeRotation[2], 0.0, 0.0, 1.0);
-	cube->draw();
-	glGetDoublev(GL_MODELVIEW_MATRIX, model);
-	cubeModel->load(model, 16);
-	glPopMatrix();
+	/* pose the cube and save its model matrix */
+	model = Mat4::translate(cubeOffset[0], cubeOffset[1], cubeOffset[2])
+		* Mat4::rotate(cubeRotation[0], 1.0, 0.0, 0.0)
+		* Mat4::rotate(cubeRotation[1], 0.0, 1.0, 0.0)
+		* Mat4::rotate(cubeRotation[2], 0.0, 0.0, 1.0);
+	palette[8] = model;
+	cubeModel->load(model.m, 16);
+	
+	/* pose the main robot */
+	model = Mat4::identity();
+	palette[0] = c1->place(model);
+	model = baseLift;
+	palette[1] = c2->place(model);
+	model = model * Mat4::rotate(armAngle, 0.0, 0.0, 1.0) * shoulderMount;
+	palette[2] = c3->place(model);
+	/* the joints turn the cylinders about y; their geometry never changes */
+	model = model * shoulderJoint;
+	palette[3] = c4->place(model * Mat4::rotate(90.0 + shoulderAngle, 0.0, 1.0, 0.0));
+	model = model * Mat4::translate(shoulderRun - forearmOffsetX, 1.0, shoulderRise - forearmOffsetZ);
+	palette[4] = c5->place(model * Mat4::rotate(90.0 + shoulderAngle, 0.0, 1.0, 0.0));
+	model = model * Mat4::translate(h[0] + shoulderRun, h[1], h[2] + shoulderRise)
+		* Mat4::rotate(forearmAngle, 1.0, 0.0, 0.0)
+		* Mat4::translate(-7.5 * sinPhi, 0.0, -7.5 * cosPhi);
+	palette[5] = c6->place(model * Mat4::rotate(shoulderAngle, 0.0, 1.0, 0.0));
+	palette[6] = c7->place(model * Mat4::rotate(90.0 + shoulderAngle - fingerAngle, 0.0, 1.0, 0.0));
+	model = model * Mat4::translate(15.0 * sinPhi, 0.0, 15.0 * cosPhi);
+	palette[7] = c8->place(model * Mat4::rotate(90.0 + shoulderAngle + fingerAngle, 0.0, 1.0, 0.0));
+	fingerModel->load(model.m, 16);
+	
+	/* cull the whole robot, then each part if the frustum cuts through it */
+	Frustum frustum(clip);
+	Bounds bounds[ROBOT_PARTS], whole;
+	for (unsigned short i=0; i<ROBOT_PARTS; i++)
+	{
+		bounds[i] = transformBounds(i < 8 ? cylinders[i]->getBounds() : cube->getBounds(), palette[i]);
+		if (i == 0)
+			whole = bounds[i];
+		else
+			mergeBounds(whole, bounds[i]);
+	}
+	unsigned short visible = frustum.test(whole);
+	bool shown[ROBOT_PARTS];
+	for (unsigned short i=0; i<ROBOT_PARTS; i++)
+	{
+		shown[i] = visible == CULL_INSIDE || (visible == CULL_INTERSECT && frustum.test(bounds[i]) != CULL_OUTSIDE);
+		if (!shown[i])
+			RENDER_COUNT(RENDER_PARTS_CULLED, 1);
+	}
 	
-	/* main robot */
-	glPushMatrix();
-	setMaterial(material);
-	c1->draw();
-	glTranslated(0.0, 0.0, 10.0);
-	c2->draw();
-	glRotated(armAngle, 0.0, 0.0, 1.0);
-	glTranslated(-10.0, 0.0, 30.0);
-	c3->draw();
-	glTranslated(20.0, 0.0, 0.0);
-	c4->build(5.0, 30.0, 1.0, 0.0, 1.0, 90.0 + shoulderAngle, j_hat);
-	c4->draw();
-	glTranslated(shoulderRun - forearmOffsetX, 1.0, shoulderRise - forearmOffsetZ);
-	c5->build(3.0, 30.0, 1.0, 0.0, 1.0, 90.0 + shoulderAngle, j_hat);
-	c5->draw();
-	glTranslated(h[0] + shoulderRun, h[1], h[2] + shoulderRise);
-	glRotated(forearmAngle, 1.0, 0.0, 0.0);
-	glTranslated(-7.5 * sinPhi, 0.0, -7.5 * cosPhi);
-	c6->build(1.0, 15.0, 1.0, 0.0, 0.0, shoulderAngle, j_hat);
-	c6->draw();
-	c7->build(1.0, 10.0, 1.0, 0.0, 0.0, 90.0 + shoulderAngle - fingerAngle, j_hat);
-	c7->draw();
-	glTranslated(15.0 * sinPhi, 0.0, 15.0 * cosPhi);
-	c8->build(1.0, 10.0, 1.0, 0.0, 0.0, 90.0 + shoulderAngle + fingerAngle, j_hat);
-	c8->draw();
-	glGetDoublev(GL_MODELVIEW_MATRIX, model);
-	fingerModel->load(model, 16);
-	glPopMatrix();
+	/* draw every part left in one call, each cylinder at the level of detail its size on screen calls for */
+	if (!built)
+		build();
+	for (unsigned short i=0; i<8; i++)
+		if (shown[i])
+			pieces.push_back(cylinderPieces[i][cylinders[i]->selectLod(clip * palette[i], lodScale)]);
+	if (shown[8])
+		pieces.push_back(cubePiece);
+	if (pieces.empty())
+		return;
+	glLoadMatrixd(view.m);
+	body->draw(pieces, palette, 1 << 8, cube->bind() ? 1 << 8 : 0);
+}
+
+//! Build the Robot Mesh
+/*! Merges every level of detail of every cylinder, as parts 0 to 7, and the cube, as part 8, into a PaletteMesh. Only the first Robot to build a given mesh in a context uploads it; the others share it. */
+void Robot::build()
+{
+	Cylinder *cylinders[8] = {c1, c2, c3, c4, c5, c6, c7, c8};
+	PaletteMesh *mesh = new PaletteMesh(ROBOT_PARTS);
+	for (unsigned short i=0; i<8; i++)
+		for (unsigned int j=0; j<CYLINDER_LODS; j++)
+		{
+			MeshData data;
+			cylinders[i]->geometry(data, j);
+			cylinderPieces[i][j] = mesh->add(i, data, cylinders[i]->getColor());
+		}
+	MeshData data;
+	cube->geometry(data);
+	cubePiece = mesh->add(8, data, cube->getColor());
+	/* take hold of the new mesh before letting go of the old one, which may be the same */
+	mesh = acquireBody(mesh);
+	if (body)
+		releaseBody(body);
+	body = mesh;
+	built = true;
 }
 
-//! Load Cube Textures
-/*! This method exists solely to receive the textures from QRobot and pass them to the Cube.
-  \param newFaces the textures to pass along */
-void Robot::loadFaces(QImage **newFaces)
+//! Set Projection
+/*! Used by QRobot to tell the Robot how it is projected onto the screen, which decides how finely the cylinders are drawn.
+  \param newProjection the perspective and camera transform applied after the view
+  \param newScale pixels covered by a unit length facing the camera at unit distance */
+void Robot::setProjection(const Mat4 &newProjection, GLdouble newScale)
 {
-	cube->loadFaces(newFaces);
+	projection = newProjection;
+	lodScale = newScale;
+}
+
+//! Reserve Cube Textures
+/*! This method exists solely to pass the size of the textures still being loaded to the Cube.
+  \param width the width of the largest texture
+  \param height the height of the largest texture */
+void Robot::reserveFaces(int width, int height)
+{
+	cube->reserveFaces(width, height);
+	built = false;
+}
+
+//! Load One Cube Texture
+/*! This method exists solely to pass a texture that has finished loading to the Cube.
+  \param face the face, from 0 to 5
+  \param chain the texture to pass along */
+void Robot::loadFace(unsigned short face, std::vector<QImage> &chain)
+{
+	if (cube->loadFace(face, chain))
+		built = false;
 }
 
 //! Set Robot Material
-/*! This method switches the material the Robot is made of
+/*! This method switches the material the Robot is made of. Shading keeps it current until the next call.
   \param newMat the new material flag */
 void Robot::setMaterial(unsigned short newMat)
 {
-	GLfloat black[] = {0.0, 0.0, 0.0, 1.0};
-	GLfloat cartoon_ambient[] = {0.2, 0.2, 0.2, 1.0};
-	GLfloat cartoon_diffuse[] = {0.8, 0.8, 0.8, 1.0};
-	GLfloat cartoon_shininess = 16.0;
-	GLfloat gold_ambient[] = {0.24725, 0.1995, 0.0745, 1.0};
-	GLfloat gold_diffuse[] = {0.75164, 0.60648, 0.22648, 1.0};
-	GLfloat gold_specular[] = {0.628281, 0.555802, 0.366065, 1.0};
-	GLfloat gold_shininess = 51.2;
-	GLfloat obsidian_ambient[] = {0.05375, 0.05, 0.06625, 1.0};
-	GLfloat obsidian_diffuse[] = {0.18275, 0.17, 0.22525, 1.0};
-	GLfloat obsidian_specular[] = {0.332741, 0.328634, 0.346435, 1.0};
-	GLfloat obsidian_shininess = 38.4;
-	GLfloat silver_ambient[] = {0.19225, 0.19225, 0.19225, 1.0};
-	GLfloat silver_diffuse[] = {0.50754, 0.50754, 0.50754, 1.0};
-	GLfloat silver_specular[] = {0.508273, 0.508273, 0.508273, 1.0};
-	GLfloat silver_shininess = 51.2;
-	
 	robotMaterial = newMat;
-	glMaterialfv(GL_FRONT, GL_EMISSION, black);
-	switch (robotMaterial)
-	{
-		case SILVER:
-		{
-			glDisable(GL_COLOR_MATERIAL);
-			glMaterialfv(GL_FRONT, GL_AMBIENT, silver_ambient);
-			glMaterialfv(GL_FRONT, GL_DIFFUSE, silver_diffuse);
-			glMaterialfv(GL_FRONT, GL_SPECULAR, silver_specular);
-			glMaterialf(GL_FRONT, GL_SHININESS, silver_shininess);
-			break;
-		}
-		case OBSIDIAN:
-		{
-			glDisable(GL_COLOR_MATERIAL);
-			glMaterialfv(GL_FRONT, GL_AMBIENT, obsidian_ambient);
-			glMaterialfv(GL_FRONT, GL_DIFFUSE, obsidian_diffuse);
-			glMaterialfv(GL_FRONT, GL_SPECULAR, obsidian_specular);
-			glMaterialf(GL_FRONT, GL_SHININESS, obsidian_shininess);
-			break;
-		}
-		case GOLD:
-		{
-			glDisable(GL_COLOR_MATERIAL);
-			glMaterialfv(GL_FRONT, GL_AMBIENT, gold_ambient);
-			glMaterialfv(GL_FRONT, GL_DIFFUSE, gold_diffuse);
-			glMaterialfv(GL_FRONT, GL_SPECULAR, gold_specular);
-			glMaterialf(GL_FRONT, GL_SHININESS, gold_shininess);
-			break;
-		}
-		case CARTOON:
-		default:
-		{
-			glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
-			glMaterialfv(GL_FRONT, GL_AMBIENT, cartoon_ambient);
-			glMaterialfv(GL_FRONT, GL_DIFFUSE, cartoon_diffuse);
-			glMaterialfv(GL_FRONT, GL_SPECULAR, black);
-			glMaterialf(GL_FRONT, GL_SHININESS, cartoon_shininess);
-			glEnable(GL_COLOR_MATERIAL);
-			break;
-		}
-	}
+	Shading::setMaterial(robotMaterial);
 }
 
 //! Set Drop Flag
@@ -15,16 +15,24 @@
 #endif
 
 #include <QActionGroup>
+#include <QFileInfo>
 #include <QCheckBox>
 #include <QDoubleSpinBox>
 #include <QGLWidget>
 #include <QGridLayout>
 #include <QGroupBox>
 #include <QLabel>
+#include <QMutex>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QSlider>
+#include <QThreadPool>
+#include <vector>
 #include "linalg.h"
+#include "renderstats.h"
 
 /*! \file robot.h
   \brief Main Robot Header File
@@ -55,6 +63,10 @@ enum states {ON, OFF};
 /*! Enumeration with all supported light types. */
 enum types {DIRECTIONAL, POSITIONAL, SPOTLIGHT};
 
+//! Cull Results
+/*! Enumeration of where a Frustum finds a bounding volume. */
+enum cullResults {CULL_OUTSIDE, CULL_INTERSECT, CULL_INSIDE};
+
 //! Light Related Flags
 /*! A bit field with five light switches, a master switch, and five light types. */
 struct switches
@@ -72,6 +84,71 @@ struct switches
 	unsigned type5: 2; /*!< Light Type 5 */
 };
 
+//! Cluster Columns
+/*! Number of columns the viewport is cut into for clustered lighting. */
+#define CLUSTER_COLUMNS 16
+
+//! Cluster Rows
+/*! Number of rows the viewport is cut into for clustered lighting. */
+#define CLUSTER_ROWS 16
+
+//! Cluster Slices
+/*! Number of slices the view frustum is cut into along the depth, each the same factor deeper than the last. */
+#define CLUSTER_SLICES 16
+
+//! Cluster Count
+/*! Number of clusters in the grid. */
+#define CLUSTER_COUNT (CLUSTER_COLUMNS * CLUSTER_ROWS * CLUSTER_SLICES)
+
+//! Local Light
+/*! A small positional light that only reaches a limited distance, as the local light buffer holds it. Any number of them can be lit through LightClusters. */
+struct LocalLight
+{
+	GLfloat position[4]; /*!< Position, With The Radius Of Influence In w */
+	GLfloat color[4]; /*!< Diffuse And Specular Color */
+};
+
+//! Light Clusters Class
+/*! Bins local lights into the cells of a grid over the view frustum, CLUSTER_COLUMNS by CLUSTER_ROWS across the viewport and CLUSTER_SLICES deep, so a fragment only lights itself with the lights that reach its cell. Each light's bounding sphere is tested against the planes between columns and rows with simdPlaneDistances(), and the lights are spread over the LinAlgThreads pool. The result is a list of light indices per cell, cell after cell, with the first index and count of each cell. */
+class LightClusters
+{
+public:
+	LightClusters();
+	void setFrustum(const Mat4 &projection, double nearPlane, double farPlane, int width, int height);
+	void bin(const std::vector<LocalLight> &lights);
+	const std::vector<GLuint> &getCells() const;
+	const std::vector<GLuint> &getIndices() const;
+	const GLfloat *getScale() const;
+protected:
+	unsigned int slice(double depth) const;
+	//! Boundary Planes
+	/*! The \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ rows of the CLUSTER_COLUMNS+1 planes between columns followed by the CLUSTER_ROWS+1 planes between rows, in eye coordinates, as simdPlaneDistances() takes them. */
+	std::vector<double> planes;
+	//! Depth Row
+	/*! The row of the projection that gives a point's clip \f$w\f$, its depth in front of the camera. */
+	double depth[4];
+	//! Depth Scale
+	/*! Length of the normal of depth, by which a radius stretches in \f$w\f$. */
+	double depthScale;
+	//! Near Plane
+	/*! Depth of the near clipping plane, where the first slice starts. */
+	double nearPlane;
+	//! Far Plane
+	/*! Depth of the far clipping plane, where the last slice ends. */
+	double farPlane;
+	//! Shader Scale
+	/*! Columns per pixel, rows per pixel, and the scale and offset that turn the log of a depth into a slice. */
+	GLfloat scale[4];
+	//! Light Ranges
+	/*! The first and last column, row and slice each light of the last bin() reaches; empty if the first column is past the last. */
+	std::vector<int> ranges;
+	//! Cells
+	/*! The first index and the number of indices of every cell, by \f$(slice\cdot CLUSTER\_ROWS+row)\cdot CLUSTER\_COLUMNS+column\f$. */
+	std::vector<GLuint> cells;
+	//! Indices
+	/*! The lights of every cell, cell after cell. */
+	std::vector<GLuint> indices;
+};
 
 //! OpenGL Lighting Class
 /*! A class with 5 fully customizable lights. Designed to interact with the QWindow class to change its parameters. */
@@ -85,6 +162,13 @@ public:
 	void enable();
 	void disable();
 	unsigned short getType(unsigned short lightNum);
+	bool getSwitch(unsigned short lightNum);
+	unsigned int addLocalLight(const GLfloat *position, const GLfloat *color, GLfloat radius);
+	void clearLocalLights();
+	unsigned int localLightCount();
+	void scatterLocalLights(unsigned int count, GLfloat extent);
+	void setProjection(const Mat4 &projection, double nearPlane, double farPlane, int width, int height);
+	void apply(const Mat4 &view, unsigned short follow = NONE, const GLfloat *position = NULL);
 
 signals:
 	//! GLDraw Signal
@@ -143,14 +227,282 @@ protected:
 	//! Light Positions
 	/*! Pointer to an array of 5 light positions in the form \f$(x,y,z,w)\f$.*/
 	GLfloat **coords;
+	//! Local Lights
+	/*! Any number of small positional lights in world coordinates, on top of the 5 lights. */
+	std::vector<LocalLight> localLights;
+	//! Local Lights In Eye Coordinates
+	/*! The local lights under the view of the last apply(), as they are binned and uploaded. */
+	std::vector<LocalLight> eyeLights;
+	//! Light Clusters
+	/*! Bins the local lights by where they reach on screen every apply(). */
+	LightClusters clusters;
 
 private:
 	/* functions that actually process QT's input */
-	void lightSwitch(bool state, unsigned short type, unsigned short lightNum);
-	void setAngle(unsigned short lightNum);
 	void setColor(unsigned short lightNum);
 	void setType(unsigned short type, unsigned short lightNum);
-	void repositionLight(unsigned short type, unsigned short lightNum);
+};
+
+//! OpenGL State Cache Class
+/*! Static interface that shadows the OpenGL state the renderer changes most, namely capabilities, the front material, the bound texture and the bound shader program, and drops calls that would set it to the value it already has. Each method stands in for the OpenGL call of the same name. The cache only stays correct if this state is changed through it, or restored before the cache is used again, as \c glPopAttrib() does. With \c RENDER_STATS, calls that reach OpenGL and calls that are filtered out are counted per frame. */
+class GLState
+{
+public:
+	static void enable(GLenum cap);
+	static void disable(GLenum cap);
+	static bool isEnabled(GLenum cap);
+	static void colorMaterial(GLenum face, GLenum mode);
+	static void material(GLenum face, GLenum pname, const GLfloat *params);
+	static void material(GLenum face, GLenum pname, GLfloat param);
+	static void bindTexture(GLenum target, GLuint name);
+	static void deleteTexture(GLuint name);
+	static void useProgram(QOpenGLShaderProgram *newProgram);
+	static void invalidate();
+};
+
+//! Light Uniforms
+/*! One light as the \c Lights uniform block holds it, in the std140 layout. */
+struct LightUniforms
+{
+	GLfloat position[4]; /*!< Position In Eye Coordinates, With \f$w=0\f$ For A Directional Light */
+	GLfloat color[4]; /*!< Diffuse And Specular Color */
+	GLfloat spot[4]; /*!< Unit Spot Direction In Eye Coordinates, And The Cosine Of The Cutoff Or Less Than -1 For None */
+};
+
+//! Light Block
+/*! The whole \c Lights uniform block, in the std140 layout. */
+struct LightBlock
+{
+	LightUniforms lights[5]; /*!< The Five Lights */
+	GLfloat ambient[4]; /*!< Global Ambient Color */
+	GLint enabled; /*!< Bitmask Of The Lights That Are On */
+	GLint lighting; /*!< Master Switch */
+	GLint padding[2]; /*!< Aligns clusterScale To A Whole vec4 */
+	GLfloat clusterScale[4]; /*!< Cluster Columns And Rows Per Pixel, And The Scale And Offset From Log Depth To Slice */
+	GLint clusterGrid[4]; /*!< Cluster Columns, Rows And Slices, And Nonzero If There Are Local Lights */
+};
+
+//! Material Uniforms
+/*! One material as the \c Materials uniform block holds it, in the std140 layout. */
+struct MaterialUniforms
+{
+	GLfloat ambient[4]; /*!< Ambient Color */
+	GLfloat diffuse[4]; /*!< Diffuse Color */
+	GLfloat specular[4]; /*!< Specular Color */
+	GLfloat shininess; /*!< Specular Exponent */
+	GLint colored; /*!< Nonzero If The Ambient And Diffuse Colors Follow The Vertex Color */
+	GLint padding[2]; /*!< Rounds The Material Up To A Whole vec4 */
+};
+
+//! Shading Class
+/*! Static interface to the lights and materials every program built on lightingShader reads. The five lights are kept in one uniform buffer and the materials in another, so relighting the scene is a single buffer update and switching materials a single uniform. Local lights and their LightClusters go to texture buffers. Where the context has no uniform buffers, the lights and materials go to the fixed function pipeline instead, without the local lights. */
+class Shading
+{
+public:
+	static bool available();
+	static void bind(QOpenGLShaderProgram *program);
+	static void setLights(const LightBlock &block);
+	static void setLocalLights(const std::vector<LocalLight> &lights, const LightClusters &clusters);
+	static void setMaterial(unsigned short newMaterial);
+	static unsigned short getMaterial();
+	static void destroy();
+};
+
+/* GLSL for per pixel lighting from the uniform buffers (see shading.cpp) */
+extern const char *lightingShader;
+
+//! Texture Atlas Class
+/*! Packs several images into one texture so that an object with several textured faces can be drawn with a single bind and a single batch. Each image sits in its own cell surrounded by a gutter of copies of its edge texels, so filtering at the edge of one image never picks up its neighbour. The atlas is mipmapped from the images' own mip chains and sampled trilinearly. Texture coordinates within an image are mapped into the atlas with map(). */
+class TextureAtlas
+{
+public:
+	TextureAtlas();
+	~TextureAtlas();
+	void bind();
+	void map(unsigned int image, GLdouble s, GLdouble t, GLdouble *st);
+	void reserve(unsigned int count, int w, int h);
+	bool update(unsigned int image, std::vector<QImage> &chain);
+protected:
+	//! Texture Handle
+	/*! The texture object holding the atlas; 0 until reserve() is called. */
+	GLuint texture;
+	//! Image Count
+	/*! Number of images packed into the atlas. */
+	unsigned int images;
+	//! Image Rectangles
+	/*! Pointer to an array of \f$(s_0,t_0,s_1,t_1)\f$ rectangles in atlas coordinates, one per image. */
+	GLdouble *rects;
+	GLsizei width; /*!< Atlas Width In Texels */
+	GLsizei height; /*!< Atlas Height In Texels */
+	unsigned int columns; /*!< Cells Per Row */
+	unsigned int cellWidth; /*!< Cell Width Including The Gutters */
+	unsigned int cellHeight; /*!< Cell Height Including The Gutters */
+private:
+	TextureAtlas(const TextureAtlas &other);
+	TextureAtlas &operator=(const TextureAtlas &other);
+};
+
+//! Texture Cache Class
+/*! Keeps preprocessed textures on disk so that later starts don't have to decode them. An entry holds the OpenGL-ready image and its mip chain, exactly as they are uploaded, and is memory mapped when it is used again. Entries are keyed by the path of the source image and checked against its size and modification time. load() may be called from several threads at once. */
+class TextureCache
+{
+public:
+	TextureCache(const QString &directory = QString());
+	~TextureCache();
+	bool load(const QString &source, std::vector<QImage> &levels, bool &cached);
+protected:
+	//! Cache Directory
+	/*! Directory the entries are stored in. */
+	QString path;
+	//! Mapped Entries
+	/*! The open entries; the QImages returned by load() point into their mappings. */
+	std::vector<QFile *> mapped;
+	//! Mapping Lock
+	/*! Guards mapped against concurrent load() calls. */
+	QMutex lock;
+private:
+	QString entryName(const QString &source);
+	bool map(const QString &entry, const QFileInfo &source, std::vector<QImage> &levels);
+	void store(const QString &entry, const QFileInfo &source, std::vector<QImage> &levels);
+};
+
+/* mip chain generation (see texture.cpp) */
+void mipChain(std::vector<QImage> &levels);
+
+//! Mesh Vertex
+/*! One vertex of MeshData. */
+struct MeshVertex
+{
+	GLfloat position[3]; /*!< Position */
+	GLfloat normal[3]; /*!< Unit Normal */
+	GLfloat st[2]; /*!< Texture Coordinates */
+};
+
+//! Mesh Data
+/*! Vertices and indexed triangles built on the CPU, ready for PaletteMesh::add(). */
+struct MeshData
+{
+	std::vector<MeshVertex> vertices; /*!< Interleaved Vertices */
+	std::vector<GLuint> indices; /*!< Three Vertex Indices Per Triangle */
+};
+
+/* shape generation (see mesh.cpp) */
+void meshCylinder(MeshData &data, GLfloat radius, GLfloat height, int slices, int stacks);
+void meshDisk(MeshData &data, GLfloat radius, GLfloat z, bool up, int slices, int loops);
+
+//! Palette Vertex
+/*! One interleaved vertex of a PaletteMesh, laid out as the buffer object holds it. */
+struct PaletteVertex
+{
+	GLfloat position[3]; /*!< Position In The Part's Own Coordinates */
+	GLfloat normal[3]; /*!< Unit Normal */
+	GLfloat st[2]; /*!< Texture Coordinates */
+	GLfloat color[3]; /*!< Color In The Form \f$(r,g,b)\f$ */
+	GLfloat part; /*!< Index Into The Matrix Palette */
+};
+
+//! Palette Piece
+/*! A range of a PaletteMesh's triangles that belongs to one part. */
+struct PalettePiece
+{
+	unsigned int part; /*!< Index Into The Matrix Palette */
+	GLuint first; /*!< First Index */
+	GLsizei count; /*!< Number Of Indices */
+};
+
+//! Palette Mesh Class
+/*! Several rigid parts merged into one vertex buffer, posed by a palette of one matrix per part as in rigid skinning. Every vertex carries the index of its part's matrix, so the whole posed model is drawn by a single \c glDrawElements whatever the number of parts. A part may be added as several pieces, such as one per level of detail, and each draw() chooses which pieces to show. At most 32 parts are supported. */
+class PaletteMesh
+{
+public:
+	PaletteMesh(unsigned int size);
+	~PaletteMesh();
+	unsigned int add(unsigned int part, const MeshData &data, const double *color);
+	void upload();
+	void draw(const std::vector<unsigned int> &pieces, const Mat4 *palette, unsigned int colored, unsigned int textured);
+	bool matches(const PaletteMesh &other) const;
+protected:
+	void select(const std::vector<unsigned int> &pieces);
+	void bindArrays();
+	//! Palette Size
+	/*! Number of parts, and of matrices in the palette. */
+	unsigned int parts;
+	//! Vertices
+	/*! Every piece's vertices, as upload() copies them to vertexBuffer. */
+	std::vector<PaletteVertex> vertices;
+	//! Indices
+	/*! Every piece's triangles, piece after piece. */
+	std::vector<GLuint> indices;
+	//! Pieces
+	/*! The pieces added, by the number add() returned. */
+	std::vector<PalettePiece> pieces;
+	//! Selected Pieces
+	/*! The pieces whose triangles are in indexBuffer, in order. */
+	std::vector<unsigned int> selection;
+	//! Selected Index Count
+	/*! Number of indices in indexBuffer. */
+	GLsizei count;
+	//! Vertex Buffer
+	/*! Buffer object holding the interleaved PaletteVertex array. */
+	QOpenGLBuffer vertexBuffer;
+	//! Index Buffer
+	/*! Buffer object holding the triangles of the selected pieces, rewritten only when the selection changes. */
+	QOpenGLBuffer indexBuffer;
+	//! Vertex Array Object
+	/*! Records the arrays read by the program. */
+	QOpenGLVertexArrayObject array;
+	//! Shader Program
+	/*! The program, shared by every PaletteMesh, that poses and lights the parts; NULL until the first draw(). */
+	QOpenGLShaderProgram *program;
+	//! Shader Flag
+	/*! Flag that indicates whether the program and vertex array object are usable; if not, the pieces are drawn one at a time by the fixed function pipeline. */
+	bool shaded;
+private:
+	void initialize();
+	PaletteMesh(const PaletteMesh &other);
+	PaletteMesh &operator=(const PaletteMesh &other);
+};
+
+//! Cylinder Detail Levels
+/*! Number of tessellations of the unit cylinder, from finest to coarsest, that a Cylinder chooses between by its size on screen. */
+#define CYLINDER_LODS 3
+
+//! Cylinder Detail Hysteresis
+/*! How much larger on screen than the size at which it dropped to a coarser level a Cylinder must grow before it goes back, so a Cylinder near a threshold doesn't pop back and forth. */
+#define CYLINDER_LOD_HYSTERESIS 1.25
+
+//! Frustum Planes
+/*! Number of planes a Frustum tests against: left, right, bottom, top, near and far, padded to a whole number of vectors of four with planes every point is inside. */
+#define FRUSTUM_PLANES 8
+
+//! Bounding Volume
+/*! An axis aligned box and a sphere that both enclose the same geometry. The sphere is the quicker test and the box the tighter one. */
+struct Bounds
+{
+	double min[3]; /*!< Minimum Corner Of The Box */
+	double max[3]; /*!< Maximum Corner Of The Box */
+	double center[3]; /*!< Center Of The Sphere */
+	double radius; /*!< Radius Of The Sphere */
+};
+
+Bounds boundsOf(const double *min, const double *max);
+Bounds transformBounds(const Bounds &bounds, const Mat4 &model);
+void mergeBounds(Bounds &bounds, const Bounds &other);
+
+//! View Frustum Class
+/*! The six planes of the volume a transform to clip coordinates keeps, for culling whatever lies outside it before it is drawn. Each test measures a point against every plane at once with simdPlaneDistances(), four planes at a time where the processor allows. */
+class Frustum
+{
+public:
+	Frustum(const Mat4 &clip);
+	unsigned short test(const Bounds &bounds) const;
+protected:
+	//! Planes
+	/*! The \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ rows of the planes, normals inward and of unit length, as simdPlaneDistances() takes them. */
+	double planes[4 * FRUSTUM_PLANES];
+	//! Plane Reach
+	/*! The planes with the absolute values of their normals and no offset, which measure how far a box of a given half size reaches toward each plane. */
+	double reach[4 * FRUSTUM_PLANES];
 };
 
 //! OpenGL Cube Class
@@ -158,51 +510,70 @@ private:
 class Cube
 {
 public:
-	Cube(GLdouble length, bool light=true);
+	Cube(GLdouble length);
 	~Cube();
-	void draw();
-	void loadFaces(QImage **newFaces);
+	bool bind();
+	void geometry(MeshData &data);
+	Bounds getBounds();
+	const GLdouble *getColor();
+	void reserveFaces(int width, int height);
+	bool loadFace(unsigned short face, std::vector<QImage> &chain);
 	void setTexturing(bool newText);
 protected:
-	//! Lighting Flag
-	/*! Flag that indicates whether lighting is enabled. */
-	bool lighting;
 	//! Texturing Flag
 	/*! Flag that indicates whether texturing is enabled. */
 	bool texturing;
 	//! Side Length
 	/*! Length of one side of the cube. */
 	GLdouble side;
-	//! Texturing Handles
-	/*! Pointer to an array of texture handles. */
-	GLuint *textures;
-	//! Texture Images
-	/*! Pointer to an array of pointers to QImages containing OpenGL-compatible textures for the face of the cube. */
-	QImage **faces;
+	//! Face Textures
+	/*! The six faces packed into one texture by reserveFaces() and loadFace(). */
+	TextureAtlas atlas;
 };
 
 //! OpenGL Cylinder Class
-/*! A class that defines a cylinder with lighting support. */
+/*! A class that defines a closed cylinder with lighting support. */
 class Cylinder
 {
 public:
-	Cylinder(double radius, double height, double red, double green, double blue, double angle, Vector &axis, bool rotate=true, bool light=true);
-	Cylinder(double radius, double height, double red, double green, double blue, bool light=true);
+	Cylinder(double radius, double height, double red, double green, double blue, double angle, Vector &axis, bool rotate=true);
+	Cylinder(double radius, double height, double red, double green, double blue);
 	~Cylinder();
-	void build(double radius, double height, double red, double green, double blue, double angle, Vector &axis, bool rotate=true);
-	void draw();
+	void build(double radius, double height, double red, double green, double blue, double angle, const double *axis, bool rotate=true);
+	void geometry(MeshData &data, unsigned int level);
+	Bounds getBounds();
+	const double *getColor();
+	Mat4 place(const Mat4 &model);
+	unsigned int selectLod(const Mat4 &clip, double scale);
+	static int lodSlices(unsigned int level);
 protected:
-	//! Lighting Flag
-	/*! Flag that indicates whether lighting is enabled. */
-	bool lighting;
-	//! GLU Quadric Objects
-	/*! Pointer to an array of Quadric objects that make up the cylinder. */
-	GLUquadricObj *qobj;
-	//! OpenGL Start List Handle
-	/*! Handle for using the array of Quadric objects. */
-	GLuint startList;
+	//! Rotation Flag
+	/*! Flag that indicates whether the cylinder is rotated by angle around axis. */
+	bool rotated;
+	//! Rotation Angle
+	/*! Angle of rotation in degrees. */
+	double angle;
+	//! Rotation Axis
+	/*! Array containing the axis of rotation. */
+	double axis[3];
+	//! Color
+	/*! Array containing the color in the form \f$(r,g,b)\f$. */
+	double color[3];
+	//! Radius
+	/*! Radius of the cylinder. */
+	double radius;
+	//! Height
+	/*! Height of the cylinder. */
+	double height;
+	//! Detail Level
+	/*! The level of detail selectLod() chose last, kept between frames for the hysteresis. */
+	unsigned int lod;
 };
 
+//! Robot Parts
+/*! Number of rigid parts of the Robot, each with its own matrix in the palette: the eight cylinders, then the cube. */
+#define ROBOT_PARTS 9
+
 //! OpenGL Robot Class
 /*! A class that defines a robot with lighting and OpenGL support. This class has is Qt unaware and is the class that QRobot was designed to control. */
 class Robot
@@ -214,8 +585,10 @@ public:
 	bool grabbed();
 	bool inRange();
 	void grabCube();
-	void draw();
-	void loadFaces(QImage **newFaces);
+	void draw(const Mat4 &view);
+	void setProjection(const Mat4 &newProjection, GLdouble newScale);
+	void reserveFaces(int width, int height);
+	void loadFace(unsigned short face, std::vector<QImage> &chain);
 	GLdouble getArm();
 	GLdouble getShoulder();
 	GLdouble getForearm();
@@ -233,6 +606,7 @@ public:
 	void setTexturing(bool newText);
 
 protected:
+	void build();
 	//! Drop Flag
 	/*! If true, the cube has been dropped; if false, the cube has not been dropped. */
 	bool drop;
@@ -269,16 +643,34 @@ protected:
 	//! Cube
 	/*! Pointer to the cube itself */
 	Cube *cube;
+	//! Robot Mesh
+	/*! Every level of detail of every cylinder and the cube, merged and posed by a matrix palette with one entry per part. Shared with every other Robot in the same GL context whose mesh would be the same, so each Robot only brings its own palette and choice of pieces; NULL until the first draw(). */
+	PaletteMesh *body;
+	//! Cylinder Pieces
+	/*! The pieces of body holding each cylinder at each level of detail. */
+	unsigned int cylinderPieces[8][CYLINDER_LODS];
+	//! Cube Piece
+	/*! The piece of body holding the cube. */
+	unsigned int cubePiece;
+	//! Robot Mesh Flag
+	/*! Flag that indicates whether body matches the cube's current texture coordinates. */
+	bool built;
+	//! Projection Matrix
+	/*! Perspective and camera transform the Robot is drawn under, used to measure the cylinders on screen. */
+	Mat4 projection;
+	//! Projection Scale
+	/*! Pixels covered by a unit length facing the camera at unit distance. */
+	GLdouble lodScale;
 	//@{
 	//! Robot Cylinders
 	/*! These Cylinders that make up the building blocks of the Robot. */
 	Cylinder *c1, *c2, *c3, *c4, *c5, *c6, *c7, *c8;
 	//@}
-	//! Cube Modelview Matrix
-	/*! Matrix containing the current modelview matrix for the Cube. */
+	//! Cube Model Matrix
+	/*! Matrix containing the current model transform of the Cube, excluding the view. */
 	Matrix *cubeModel;
-	//! Finger Modelview Matrix
-	/*! Matrix containing the current modelview matrix for the finger. */
+	//! Finger Model Matrix
+	/*! Matrix containing the current model transform of the finger, excluding the view. */
 	Matrix *fingerModel;
 };
 
@@ -293,7 +685,7 @@ public:
 	QSize minimumSizeHint() const;
 	QSize sizeHint() const;
 	Lighting *getLights();
-	QImage **getFaces();
+	std::vector<QImage> *getFaces();
 	bool texturesLoaded();
 	void dropCube();
 	void loadFaces();
@@ -316,6 +708,9 @@ public slots:
 	void setMass(double newMass);
 	void setTemperature(double newTemp);
 
+private slots:
+	void faceLoaded(int face, bool loaded, bool cached);
+
 signals:
 	//! Cube Status Signal
 	/*! This signal changes the status text in the QWindow. */
@@ -376,8 +771,23 @@ private:
 	/*! Pointer to an array of the coordinates of the current light */
 	GLfloat *currLightCoords;
 	//! Textures
-	/*! Pointer to an array of pointers of type QImage containing OpenGL compatible texture data */
-	QImage **faces;
+	/*! Pointer to an array of 6 mip chains containing OpenGL compatible texture data */
+	std::vector<QImage> *faces;
+	//! Texture Cache
+	/*! Preprocessed textures from earlier runs; faces may point into its mappings */
+	TextureCache *cache;
+	//! Texture Loaders
+	/*! Worker threads that fill faces in the background */
+	QThreadPool *loaders;
+	//! Ready Flags
+	/*! Pointer to an array of 6 flags that are true once the matching face has been loaded */
+	bool *ready;
+	//! Face Width
+	/*! Width of the largest face, read from the image headers before decoding */
+	int faceWidth;
+	//! Face Height
+	/*! Height of the largest face, read from the image headers before decoding */
+	int faceHeight;
 	//! Last Position
 	/*! Last position of the mouse, in window coordinates */
 	QPoint lastPos;
@@ -387,9 +797,15 @@ private:
 	//! Lighting
 	/*! The lighting itself */
 	Lighting *lights;
+	//! Projection Matrix
+	/*! Perspective and camera transform built by resizeGL() */
+	Mat4 projection;
+	//! Floor Mesh
+	/*! The floor at unit size, scaled to the zoom distance when it is drawn */
+	PaletteMesh *floor;
 
 	void Error(char *msg);
-	void drawFloor();
+	void drawFloor(const Mat4 &view);
 };
 
 //! Qt Window Class
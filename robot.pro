@@ -2,14 +2,36 @@ SOURCES = lighting.cpp \
 	  main.cpp \
 	  robot.cpp \
 	  shapes.cpp \
+	  mesh.cpp \
+	  glstate.cpp \
+	  shading.cpp \
+	  clusters.cpp \
+	  frustum.cpp \
+	  palettemesh.cpp \
+	  texture.cpp \
+	  texturecache.cpp \
+	  mipmap.cpp \
 	  matrix.cpp \
+	  banded.cpp \
+	  mixed.cpp \
+	  svd.cpp \
 	  vector.cpp \
+	  simd.cpp \
+	  parallel.cpp \
+	  linalgstats.cpp \
+	  renderstats.cpp \
 	  qrobot.cpp \
 	  robotwindow.cpp
 HEADERS = robot.h \
-	  linalg.h
+	  linalg.h \
+	  linalgstats.h \
+	  renderstats.h \
+	  mipmap.h \
+	  simd.h \
+	  parallel.h \
+	  mat4.h
 TARGET = robot
-CONFIG += qt debug
+CONFIG += qt debug c++14
 QT += opengl widgets
 macx {
 	DEFINES = MacOSX
@@ -23,3 +45,11 @@ win32 {
 	DEFINES = Win32
 	LIBS += opengl32.lib glu32.lib
 }
+# qmake CONFIG+=linalg_stats counts Matrix/Vector allocations and FLOPs
+linalg_stats {
+	DEFINES += LINALG_STATS
+}
+# qmake CONFIG+=render_stats counts per frame rendering work such as texture and mesh uploads and times the first frame
+render_stats {
+	DEFINES += RENDER_STATS
+}
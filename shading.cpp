@@ -0,0 +1,324 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include "robot.h"
+
+/*! \file shading.cpp
+  \brief Per Pixel Shading
+
+  Implements Shading and lightingShader. The lights live in one uniform buffer and the four materials in another, bound once to fixed binding points that every program's blocks are tied to by Shading::bind(). Changing the lights costs one \c glBufferSubData per frame at most, and changing the material only the index a program reads, instead of dozens of \c glLight and \c glMaterial calls. Local lights, with the cells LightClusters bins them into, go to three buffer textures that are only rewritten when they change. Where uniform buffers aren't available, the same lights and materials are handed to the fixed function pipeline, and the local lights are left out. */
+
+//! Light Block Binding
+/*! Uniform buffer binding point of the \c Lights block. */
+#define LIGHT_BINDING 0
+
+//! Material Block Binding
+/*! Uniform buffer binding point of the \c Materials block. */
+#define MATERIAL_BINDING 1
+
+//! First Local Light Unit
+/*! Texture unit of the \c localLights buffer texture, followed by \c clusters and \c clusterLights. Unit 0 is left to the images. */
+#define LOCAL_UNIT 1
+
+//! Per Pixel Lighting Shader
+/*! The start of a fragment shader that lights fragments from the \c Lights and \c Materials blocks, with a non-local viewer as the fixed function pipeline uses. Local lights are looked up through the fragment's cluster, so only those that reach it are evaluated, and fade out smoothly to nothing at their radius. It declares the index of the current material as the uniform \c material, and a function \c shade() that returns the lit color of a fragment from its eye coordinates, interpolated normal and color, and whether its material follows the color without highlights whatever the current material is. A program appends its own \c main(). */
+const char *lightingShader =
+	"#version 140\n"
+	"struct Light\n"
+	"{\n"
+	"	vec4 position;\n"
+	"	vec4 color;\n"
+	"	vec4 spot;\n"
+	"};\n"
+	"layout(std140) uniform Lights\n"
+	"{\n"
+	"	Light lights[5];\n"
+	"	vec4 ambient;\n"
+	"	int enabled;\n"
+	"	int lighting;\n"
+	"	vec4 clusterScale;\n"
+	"	ivec4 clusterGrid;\n"
+	"};\n"
+	"uniform samplerBuffer localLights;\n"
+	"uniform usamplerBuffer clusters;\n"
+	"uniform usamplerBuffer clusterLights;\n"
+	"struct Material\n"
+	"{\n"
+	"	vec4 ambient;\n"
+	"	vec4 diffuse;\n"
+	"	vec4 specular;\n"
+	"	float shininess;\n"
+	"	int colored;\n"
+	"};\n"
+	"layout(std140) uniform Materials\n"
+	"{\n"
+	"	Material materials[4];\n"
+	"};\n"
+	"uniform int material;\n"
+	"vec4 shade(vec3 eye, vec3 normal, vec4 color, bool colored)\n"
+	"{\n"
+	"	if (lighting == 0)\n"
+	"		return color;\n"
+	"	Material m = materials[material];\n"
+	"	bool tracked = colored || m.colored != 0;\n"
+	"	vec4 diffuse = tracked ? color : m.diffuse;\n"
+	"	vec4 specular = colored ? vec4(0.0) : m.specular;\n"
+	"	vec3 n = normalize(normal);\n"
+	"	vec4 sum = ambient * (tracked ? color : m.ambient);\n"
+	"	for (int i=0; i<5; i++)\n"
+	"	{\n"
+	"		if ((enabled & (1 << i)) == 0)\n"
+	"			continue;\n"
+	"		vec4 position = lights[i].position;\n"
+	"		vec3 l = normalize(position.w != 0.0 ? position.xyz / position.w - eye : position.xyz);\n"
+	"		if (dot(-l, lights[i].spot.xyz) < lights[i].spot.w)\n"
+	"			continue;\n"
+	"		float lambert = max(dot(n, l), 0.0);\n"
+	"		sum += lambert * lights[i].color * diffuse;\n"
+	"		if (lambert > 0.0)\n"
+	"			sum += pow(max(dot(n, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0), m.shininess) * lights[i].color * specular;\n"
+	"	}\n"
+	"	if (clusterGrid.w == 0)\n"
+	"		return vec4(clamp(sum.rgb, 0.0, 1.0), diffuse.a);\n"
+	"	ivec3 c = clamp(ivec3(gl_FragCoord.xy * clusterScale.xy, log(1.0 / gl_FragCoord.w) * clusterScale.z + clusterScale.w), ivec3(0), clusterGrid.xyz - 1);\n"
+	"	uvec2 cell = texelFetch(clusters, (c.z * clusterGrid.y + c.y) * clusterGrid.x + c.x).xy;\n"
+	"	for (uint k=0u; k<cell.y; k++)\n"
+	"	{\n"
+	"		int j = int(texelFetch(clusterLights, int(cell.x + k)).x);\n"
+	"		vec4 position = texelFetch(localLights, 2 * j);\n"
+	"		vec3 d = position.xyz - eye;\n"
+	"		float reach = dot(d, d) / (position.w * position.w);\n"
+	"		if (reach >= 1.0)\n"
+	"			continue;\n"
+	"		vec4 light = (1.0 - reach) * (1.0 - reach) * texelFetch(localLights, 2 * j + 1);\n"
+	"		vec3 l = normalize(d);\n"
+	"		float lambert = max(dot(n, l), 0.0);\n"
+	"		sum += lambert * light * diffuse;\n"
+	"		if (lambert > 0.0)\n"
+	"			sum += pow(max(dot(n, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0), m.shininess) * light * specular;\n"
+	"	}\n"
+	"	return vec4(clamp(sum.rgb, 0.0, 1.0), diffuse.a);\n"
+	"}\n";
+
+//! Material Table
+/*! The materials by their materials entry, as the \c Materials block holds them. The cartoon material takes its ambient and diffuse colors from the vertex color. */
+static const MaterialUniforms materialTable[4] =
+{
+	{{0.2, 0.2, 0.2, 1.0}, {0.8, 0.8, 0.8, 1.0}, {0.0, 0.0, 0.0, 1.0}, 16.0, 1, {0, 0}},
+	{{0.24725, 0.1995, 0.0745, 1.0}, {0.75164, 0.60648, 0.22648, 1.0}, {0.628281, 0.555802, 0.366065, 1.0}, 51.2, 0, {0, 0}},
+	{{0.05375, 0.05, 0.06625, 1.0}, {0.18275, 0.17, 0.22525, 1.0}, {0.332741, 0.328634, 0.346435, 1.0}, 38.4, 0, {0, 0}},
+	{{0.19225, 0.19225, 0.19225, 1.0}, {0.50754, 0.50754, 0.50754, 1.0}, {0.508273, 0.508273, 0.508273, 1.0}, 51.2, 0, {0, 0}}
+};
+
+//! Initialized Flag
+/*! Flag that indicates whether available() has looked at the context yet. */
+static bool initialized;
+
+//! Shaded Flag
+/*! Flag that indicates whether the uniform buffers exist. */
+static bool shaded;
+
+//! Uniform Buffers
+/*! The light buffer and the material buffer. */
+static GLuint buffers[2];
+
+//! Local Light Buffers
+/*! The buffers behind the \c localLights, \c clusters and \c clusterLights buffer textures. */
+static GLuint localBuffers[3];
+
+//! Local Light Textures
+/*! The buffer textures, bound to their units for good. */
+static GLuint localTextures[3];
+
+//! Last Local Lights
+/*! The contents last uploaded to each of localBuffers. */
+static std::vector<unsigned char> lastLocal[3];
+
+//! Current Material
+/*! The materials entry set by setMaterial(). */
+static unsigned short current;
+
+//! Last Lights
+/*! The lights last passed to setLights(), valid if lightsKnown is set. */
+static LightBlock lastLights;
+
+//! Known Lights
+/*! Flag that indicates whether lastLights is valid. */
+static bool lightsKnown;
+
+//! Available Method
+/*! Creates the uniform buffers the first time it is called. The GL context must be current.
+  \return true if programs can read the lights and materials from uniform buffers, false if the fixed function pipeline is lit instead */
+bool Shading::available()
+{
+	if (initialized)
+		return shaded;
+	initialized = true;
+	QOpenGLContext *context = QOpenGLContext::currentContext();
+	if (!context || context->format().version() < qMakePair(3, 1))
+		return false;
+	QOpenGLExtraFunctions *gl = context->extraFunctions();
+	gl->glGenBuffers(2, buffers);
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, buffers[0]);
+	gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), NULL, GL_DYNAMIC_DRAW);
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, buffers[1]);
+	gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(materialTable), materialTable, GL_STATIC_DRAW);
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	gl->glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, buffers[0]);
+	gl->glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BINDING, buffers[1]);
+	/* the cells start out empty, so nothing is read until there are local lights */
+	const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+	std::vector<GLuint> empty(2 * CLUSTER_COUNT, 0);
+	gl->glGenBuffers(3, localBuffers);
+	glGenTextures(3, localTextures);
+	for (unsigned short i=0; i<3; i++)
+	{
+		gl->glBindBuffer(GL_TEXTURE_BUFFER, localBuffers[i]);
+		gl->glBufferData(GL_TEXTURE_BUFFER, empty.size() * sizeof(GLuint), &empty[0], GL_DYNAMIC_DRAW);
+		gl->glActiveTexture(GL_TEXTURE0 + LOCAL_UNIT + i);
+		glBindTexture(GL_TEXTURE_BUFFER, localTextures[i]);
+		gl->glTexBuffer(GL_TEXTURE_BUFFER, formats[i], localBuffers[i]);
+	}
+	gl->glActiveTexture(GL_TEXTURE0);
+	gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	shaded = true;
+	return true;
+}
+
+//! Upload A Local Light Buffer
+/*! Replaces the contents of one of localBuffers unless they are the same already.
+  \param buffer the index into localBuffers
+  \param data the new contents
+  \param size the size of the contents in bytes */
+static void uploadLocal(unsigned short buffer, const void *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	bool same = lastLocal[buffer].size() == size && (!size || !memcmp(&lastLocal[buffer][0], bytes, size));
+	RENDER_COUNT(same ? RENDER_STATE_FILTERED : RENDER_STATE_CHANGES, 1);
+	if (same || !size)
+		return;
+	lastLocal[buffer].assign(bytes, bytes + size);
+	QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+	gl->glBindBuffer(GL_TEXTURE_BUFFER, localBuffers[buffer]);
+	gl->glBufferData(GL_TEXTURE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+	gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+//! Bind Method
+/*! Ties the \c Lights and \c Materials blocks of a program built on lightingShader to the buffers, and its local light samplers to their units. Call it once, after the program is linked; it leaves the program bound.
+  \param program the linked program */
+void Shading::bind(QOpenGLShaderProgram *program)
+{
+	QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+	gl->glUniformBlockBinding(program->programId(), gl->glGetUniformBlockIndex(program->programId(), "Lights"), LIGHT_BINDING);
+	gl->glUniformBlockBinding(program->programId(), gl->glGetUniformBlockIndex(program->programId(), "Materials"), MATERIAL_BINDING);
+	GLState::useProgram(program);
+	program->setUniformValue("localLights", LOCAL_UNIT);
+	program->setUniformValue("clusters", LOCAL_UNIT + 1);
+	program->setUniformValue("clusterLights", LOCAL_UNIT + 2);
+}
+
+//! Set Lights
+/*! Replaces every light with one upload to the light buffer, or sets them up in the fixed function pipeline where there is none. Lights that haven't changed since the last call cost nothing. The GL context must be current.
+  \param block the lights in eye coordinates */
+void Shading::setLights(const LightBlock &block)
+{
+	bool same = lightsKnown && !memcmp(&block, &lastLights, sizeof(LightBlock));
+	RENDER_COUNT(same ? RENDER_STATE_FILTERED : RENDER_STATE_CHANGES, 1);
+	if (same)
+		return;
+	lastLights = block;
+	lightsKnown = true;
+	if (available())
+	{
+		QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+		gl->glBindBuffer(GL_UNIFORM_BUFFER, buffers[0]);
+		gl->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &block);
+		gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		return;
+	}
+	/* the positions are in eye coordinates already */
+	glPushMatrix();
+	glLoadIdentity();
+	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, block.ambient);
+	for (unsigned short i=0; i<5; i++)
+	{
+		const LightUniforms &light = block.lights[i];
+		if (!(block.enabled & (1 << i)))
+		{
+			GLState::disable(GL_LIGHT0 + i);
+			continue;
+		}
+		glLightfv(GL_LIGHT0 + i, GL_POSITION, light.position);
+		glLightfv(GL_LIGHT0 + i, GL_DIFFUSE, light.color);
+		glLightfv(GL_LIGHT0 + i, GL_SPECULAR, light.color);
+		glLightfv(GL_LIGHT0 + i, GL_SPOT_DIRECTION, light.spot);
+		glLightf(GL_LIGHT0 + i, GL_SPOT_CUTOFF, light.spot[3] < -1.0 ? 180.0 : RAD2DEG(acos(light.spot[3])));
+		GLState::enable(GL_LIGHT0 + i);
+	}
+	glPopMatrix();
+	if (block.lighting)
+		GLState::enable(GL_LIGHTING);
+	else
+		GLState::disable(GL_LIGHTING);
+}
+
+//! Set Local Lights
+/*! Uploads the local lights and the cells they were binned into, each buffer only if it changed. Programs only read them if the last setLights() said there are local lights. Without uniform buffers there is nowhere to put them, and they are ignored. The GL context must be current.
+  \param lights the local lights in eye coordinates
+  \param clusters the lights binned for the current frustum */
+void Shading::setLocalLights(const std::vector<LocalLight> &lights, const LightClusters &clusters)
+{
+	if (!available())
+		return;
+	uploadLocal(0, lights.empty() ? NULL : &lights[0], lights.size() * sizeof(LocalLight));
+	uploadLocal(1, &clusters.getCells()[0], clusters.getCells().size() * sizeof(GLuint));
+	uploadLocal(2, clusters.getIndices().empty() ? NULL : &clusters.getIndices()[0], clusters.getIndices().size() * sizeof(GLuint));
+}
+
+//! Set Material
+/*! Makes a material current for everything drawn after it. Programs read it from the material buffer by the index getMaterial() returns; where there is none, it is set up in the fixed function pipeline through GLState.
+  \param newMaterial one of materials; anything else is taken as CARTOON */
+void Shading::setMaterial(unsigned short newMaterial)
+{
+	GLfloat black[] = {0.0, 0.0, 0.0, 1.0};
+	current = newMaterial <= SILVER ? newMaterial : (unsigned short)CARTOON;
+	if (available())
+		return;
+	const MaterialUniforms &params = materialTable[current];
+	GLState::material(GL_FRONT, GL_EMISSION, black);
+	if (params.colored)
+		GLState::colorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+	else
+		GLState::disable(GL_COLOR_MATERIAL);
+	GLState::material(GL_FRONT, GL_AMBIENT, params.ambient);
+	GLState::material(GL_FRONT, GL_DIFFUSE, params.diffuse);
+	GLState::material(GL_FRONT, GL_SPECULAR, params.specular);
+	GLState::material(GL_FRONT, GL_SHININESS, params.shininess);
+	if (params.colored)
+		GLState::enable(GL_COLOR_MATERIAL);
+}
+
+//! Get Material
+/*! \return the materials entry last set by setMaterial() */
+unsigned short Shading::getMaterial()
+{
+	return current;
+}
+
+//! Destroy Method
+/*! Frees the uniform buffers and forgets everything, before the GL context goes away. The GL context must be current. */
+void Shading::destroy()
+{
+	if (shaded)
+	{
+		QOpenGLContext::currentContext()->extraFunctions()->glDeleteBuffers(2, buffers);
+		QOpenGLContext::currentContext()->extraFunctions()->glDeleteBuffers(3, localBuffers);
+		glDeleteTextures(3, localTextures);
+	}
+	for (unsigned short i=0; i<3; i++)
+		lastLocal[i].clear();
+	initialized = shaded = lightsKnown = false;
+}
@@ -1,139 +1,135 @@
 #include "robot.h"
+#include <cmath>
+
+//! Cube Face
+/*! One face of the Cube: its normal, which texture image it shows, and its four corners as multiples of the half side with the texture coordinates within that image. */
+struct cubeFace
+{
+	GLdouble normal[3]; /*!< Face Normal */
+	unsigned short image; /*!< Index Of The Face's Image */
+	GLdouble st[4][2]; /*!< Texture Coordinates Of The Corners Within The Image */
+	GLdouble corner[4][3]; /*!< Corners In Units Of The Half Side */
+};
+
+//! Cube Faces
+/*! The six faces in the order they are drawn. Face $n$ of the die shows image $n-1$. */
+static const cubeFace cubeFaces[6] =
+{
+	/* top face: 6 */
+	{{0.0, 1.0, 0.0}, 5, {{0.0, 0.0}, {1.0, 0.0}, {1.0, 1.0}, {0.0, 1.0}},
+	 {{-1.0, -1.0,  1.0}, { 1.0, -1.0,  1.0}, { 1.0,  1.0,  1.0}, {-1.0,  1.0,  1.0}}},
+	/* bottom face: 1 */
+	{{0.0, -1.0, 0.0}, 0, {{1.0, 0.0}, {1.0, 1.0}, {0.0, 1.0}, {0.0, 0.0}},
+	 {{-1.0, -1.0, -1.0}, {-1.0,  1.0, -1.0}, { 1.0,  1.0, -1.0}, { 1.0, -1.0, -1.0}}},
+	/* back face: 5 */
+	{{0.0, 0.0, -1.0}, 4, {{0.0, 1.0}, {0.0, 0.0}, {1.0, 0.0}, {1.0, 1.0}},
+	 {{-1.0,  1.0, -1.0}, {-1.0,  1.0,  1.0}, { 1.0,  1.0,  1.0}, { 1.0,  1.0, -1.0}}},
+	/* front face: 2 */
+	{{0.0, 0.0, 1.0}, 1, {{1.0, 1.0}, {0.0, 1.0}, {0.0, 0.0}, {1.0, 0.0}},
+	 {{-1.0, -1.0, -1.0}, { 1.0, -1.0, -1.0}, { 1.0, -1.0,  1.0}, {-1.0, -1.0,  1.0}}},
+	/* right face: 4 */
+	{{1.0, 0.0, 0.0}, 3, {{1.0, 0.0}, {1.0, 1.0}, {0.0, 1.0}, {0.0, 0.0}},
+	 {{ 1.0, -1.0, -1.0}, { 1.0,  1.0, -1.0}, { 1.0,  1.0,  1.0}, { 1.0, -1.0,  1.0}}},
+	/* left face: 3 */
+	{{-1.0, 0.0, 0.0}, 2, {{0.0, 0.0}, {1.0, 0.0}, {1.0, 1.0}, {0.0, 1.0}},
+	 {{-1.0, -1.0, -1.0}, {-1.0, -1.0,  1.0}, {-1.0,  1.0,  1.0}, {-1.0,  1.0, -1.0}}}
+};
+
+//! Cylinder Detail Level
+/*! One tessellation of the unit cylinder. */
+struct cylinderLod
+{
+	int slices; /*!< Subdivisions Around The Axis */
+	double minimum; /*!< Smallest Projected Radius In Pixels Drawn At This Level */
+};
+
+//! Cylinder Detail Levels
+/*! The CYLINDER_LODS levels from finest to coarsest. Each level is used down to the radius at which the flat sides of the next level would stray less than half a pixel from the true silhouette, \f$r(1-\cos\frac\pi{slices})<\frac12\f$. There is only ever one stack: the side of a cylinder is straight along its length, so more stacks add vertices without changing its shape. */
+static const cylinderLod cylinderLods[CYLINDER_LODS] = {{32, 24.0}, {16, 6.0}, {8, 0.0}};
+
+//! Cube Color
+/*! The color of the Cube in the form \f$(r,g,b)\f$, shown where it isn't textured. */
+static const GLdouble cubeColor[3] = {1.0, 0.0, 0.0};
 
 //! Cube Constructor
 /*! Sets up initial parameters for the Cube
-  \param length the length of a side of the cube
-  \param light will use lighting if true (default), won't use lighting if false */
-Cube::Cube(GLdouble length, bool light)
+  \param length the length of a side of the cube */
+Cube::Cube(GLdouble length)
 {
 	side = length;
-	lighting = light;
 	texturing = true;
-	textures = new GLuint[6];
 }
 
 //! Cube Destructor
-/*! Frees allocated objects needed by the Cube */
+/*! Frees allocated objects needed by the Cube. The atlas frees the texture on the GPU, so the GL context it was created in must be current. */
 Cube::~Cube()
 {
-	delete textures;
 }
 
-//! Draw Method
-/*! Draws the cube using GL_QUADS. Sets normals if lighting is enabled. Loads and maps textures if texturing is enabled. */
-void Cube::draw()
+//! Bind Method
+/*! Binds the atlas if texturing is enabled, for drawing the Cube's geometry() elsewhere.
+  \return true if the Cube is textured */
+bool Cube::bind()
 {
-	/* color for the cube */
-	glColor3d(1.0, 0.0, 0.0);
-
-	/* top face: 6 */
-	if (texturing)
-	{
-		glEnable(GL_TEXTURE_2D);
-		glGenTextures(1, &textures[5]);
-		glBindTexture(GL_TEXTURE, textures[5]);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, faces[5]->width(), faces[5]->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[5]->bits());
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	}
-	glBegin(GL_QUADS);
-		if (lighting)
-			glNormal3d(0.0, 1.0, 0.0);
-		glTexCoord2d(0.0, 0.0); glVertex3d(-side, -side,  side);
-		glTexCoord2d(1.0, 0.0); glVertex3d( side, -side,  side);
-		glTexCoord2d(1.0, 1.0); glVertex3d( side,  side,  side);
-		glTexCoord2d(0.0, 1.0); glVertex3d(-side,  side,  side);
-	glEnd();
-
-	/* bottom face: 1 */
 	if (texturing)
-	{
-		glGenTextures(1, &textures[0]);
-		glBindTexture(GL_TEXTURE, textures[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, faces[0]->width(), faces[0]->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[0]->bits());
-	}
-	glBegin(GL_QUADS);
-		if (lighting)
-			glNormal3d(0.0, -1.0, 0.0);
-		glTexCoord2d(1.0, 0.0); glVertex3d(-side, -side, -side);
-		glTexCoord2d(1.0, 1.0); glVertex3d(-side,  side, -side);
-		glTexCoord2d(0.0, 1.0); glVertex3d( side,  side, -side);
-		glTexCoord2d(0.0, 0.0); glVertex3d( side, -side, -side);
-	glEnd();
+		atlas.bind();
+	return texturing;
+}
 
-	/* back face: 5 */
-	if (texturing)
-	{
-		glGenTextures(1, &textures[4]);
-		glBindTexture(GL_TEXTURE, textures[4]);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, faces[4]->width(), faces[4]->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[4]->bits());
-	}
-	glBegin(GL_QUADS);
-		if (lighting)
-			glNormal3d(0.0, 0.0, -1.0);
-		glTexCoord2d(0.0, 1.0); glVertex3d(-side,  side, -side);
-		glTexCoord2d(0.0, 0.0); glVertex3d(-side,  side,  side);
-		glTexCoord2d(1.0, 0.0); glVertex3d( side,  side,  side);
-		glTexCoord2d(1.0, 1.0); glVertex3d( side,  side, -side);
-	glEnd();
+//! Get Bounds
+/*! \return the box and sphere around the Cube's geometry(), in its own coordinates */
+Bounds Cube::getBounds()
+{
+	double min[3] = {-side, -side, -side}, max[3] = {side, side, side};
+	return boundsOf(min, max);
+}
 
-	/* front face: 2 */
-	if (texturing)
-	{
-		glGenTextures(1, &textures[1]);
-		glBindTexture(GL_TEXTURE, textures[1]);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, faces[1]->width(), faces[1]->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[1]->bits());
-	}
-	glBegin(GL_QUADS);
-		if (lighting)
-			glNormal3d(0.0, 0.0, 1.0);
-		glTexCoord2d(1.0, 1.0); glVertex3d(-side, -side, -side);
-		glTexCoord2d(0.0, 1.0); glVertex3d( side, -side, -side);
-		glTexCoord2d(0.0, 0.0); glVertex3d( side, -side,  side);
-		glTexCoord2d(1.0, 0.0); glVertex3d(-side, -side,  side);
-	glEnd();
+//! Get Color
+/*! \return array containing the color of the Cube in the form \f$(r,g,b)\f$ */
+const GLdouble *Cube::getColor()
+{
+	return cubeColor;
+}
 
-	/* right face: 4 */
-	if (texturing)
+//! Geometry Method
+/*! Generates the six faces around the origin with their texture coordinates mapped into the atlas, two triangles each. The texture coordinates change when the atlas' layout does, which reserveFaces() and loadFace() report.
+  \param data the mesh to add the faces to */
+void Cube::geometry(MeshData &data)
+{
+	GLdouble st[2];
+	for (unsigned short i=0; i<6; i++)
 	{
-		glGenTextures(1, &textures[3]);
-		glBindTexture(GL_TEXTURE, textures[3]);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, faces[3]->width(), faces[3]->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[3]->bits());
+		const cubeFace &face = cubeFaces[i];
+		GLuint first = data.vertices.size();
+		for (unsigned short j=0; j<4; j++)
+		{
+			atlas.map(face.image, face.st[j][0], face.st[j][1], st);
+			MeshVertex vertex = {{(GLfloat)(side * face.corner[j][0]), (GLfloat)(side * face.corner[j][1]), (GLfloat)(side * face.corner[j][2])},
+				{(GLfloat)face.normal[0], (GLfloat)face.normal[1], (GLfloat)face.normal[2]}, {(GLfloat)st[0], (GLfloat)st[1]}};
+			data.vertices.push_back(vertex);
+		}
+		GLuint quad[6] = {first, first + 1, first + 2, first, first + 2, first + 3};
+		data.indices.insert(data.indices.end(), quad, quad + 6);
 	}
-	glBegin(GL_QUADS);
-		if (lighting)
-			glNormal3d(1.0, 0.0, 0.0);
-		glTexCoord2d(1.0, 0.0); glVertex3d( side, -side, -side);
-		glTexCoord2d(1.0, 1.0); glVertex3d( side,  side, -side);
-		glTexCoord2d(0.0, 1.0); glVertex3d( side,  side,  side);
-		glTexCoord2d(0.0, 0.0); glVertex3d( side, -side,  side);
-	glEnd();
+}
 
-	/* left face: 3 */
-	if (texturing)
-	{
-		glGenTextures(1, &textures[2]);
-		glBindTexture(GL_TEXTURE, textures[2]);
-		glTexImage2D(GL_TEXTURE_2D, 0, 3, faces[2]->width(), faces[2]->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[2]->bits());
-	}
-	glBegin(GL_QUADS);
-		if (lighting)
-			glNormal3d(-1.0, 0.0, 0.0);
-		glTexCoord2d(0.0, 0.0); glVertex3d(-side, -side, -side);
-		glTexCoord2d(1.0, 0.0); glVertex3d(-side, -side,  side);
-		glTexCoord2d(1.0, 1.0); glVertex3d(-side,  side,  side);
-		glTexCoord2d(0.0, 1.0); glVertex3d(-side,  side, -side);
-	glEnd();
-	if (texturing)
-		glDisable(GL_TEXTURE_2D);
+//! ReserveFaces Method
+/*! Sets up the atlas with placeholders for six faces of up to \f$width\times height\f$ texels, so the Cube can be drawn before its faces have been decoded. Each face is then uploaded with loadFace() when it is ready. Must be called with the GL context current.
+ \param width the width of the largest face
+ \param height the height of the largest face */
+void Cube::reserveFaces(int width, int height)
+{
+	atlas.reserve(6, width, height);
 }
 
-//! LoadFaces Method
-/*! Loads an array of textures into an array of pointers of type QImage that contain OpenGL-compatible image data. 
- \param newFaces pointer to an array of QImages containing the textures */
-void Cube::loadFaces(QImage **newFaces)
+//! LoadFace Method
+/*! Replaces the placeholder of one face set up by reserveFaces(). Must be called with the GL context current.
+ \param face the face, from 0 to 5
+ \param chain the mip chain of the face in OpenGL format
+ \return true if the atlas' layout changed, so the texture coordinates of the geometry() did too */
+bool Cube::loadFace(unsigned short face, std::vector<QImage> &chain)
 {
-	faces = newFaces;
+	return atlas.update(face, chain);
 }
 
 //! setTexturing Method
@@ -151,14 +147,11 @@ void Cube::setTexturing(bool newText)
   \param red the red component of the cylinder
   \param green the green component of the cylinder
   \param blue the blue component of the cylinder
-  \param light if true, lighting is used (default); if false, lighting is not used 
   \sa build() */
-Cylinder::Cylinder(double radius, double height, double red, double green, double blue, bool light)
+Cylinder::Cylinder(double radius, double height, double red, double green, double blue)
 {
-	startList = glGenLists(3);
-	qobj = gluNewQuadric();
-	lighting = light;
-	build(radius, height, red, green, blue, 0.0, *(Vector *)NULL, false);
+	lod = 0;
+	build(radius, height, red, green, blue, 0.0, NULL, false);
 }
 
 //! Cylinder Constructor
@@ -171,90 +164,109 @@ Cylinder::Cylinder(double radius, double height, double red, double green, doubl
   \param angle angle of rotation
   \param axis reference to a Vector containing the axis of rotation
   \param rotate if true, the Cylinder will be rotated by \a angle around \a axis (default); if false, the Cylinder is not rotated
-  \param light if true, lighting is used (default); if false, lighting is not used 
   \sa build() */
-Cylinder::Cylinder(double radius, double height, double red, double green, double blue, double angle, Vector &axis, bool rotate, bool light)
+Cylinder::Cylinder(double radius, double height, double red, double green, double blue, double angle, Vector &axis, bool rotate)
 {
-	startList = glGenLists(3);
-	qobj = gluNewQuadric();
-	lighting = light;
-	build(radius, height, red, green, blue, angle, axis, rotate);
+	lod = 0;
+	double direction[3] = {axis[0], axis[1], axis[2]};
+	build(radius, height, red, green, blue, angle, direction, rotate);
 }
 
 //! Cylinder Destructor
-/*! Frees objects needed by the Cylinder. */
+/*! Frees allocated objects needed by the Cylinder. */
 Cylinder::~Cylinder()
 {
-	gluDeleteQuadric(qobj);
 }
 
 //! Cylinder Builder
-/*! Called by the constructor to setup the Cylinder before it is drawn.
+/*! Called by the constructor to setup the Cylinder before it is drawn. Only records the size, color and rotation; the geometry is generated by geometry(), tessellated like \c gluCylinder() and \c gluDisk() at one of the levels of lodSlices().
   \param radius the radius of the cylinder
   \param height the height of the cylinder
   \param red the red component of the cylinder
   \param green the green component of the cylinder
   \param blue the blue component of the cylinder
   \param angle angle of rotation
-  \param axis reference to a Vector containing the axis of rotation
+  \param axis array of 3 values, the axis of rotation; may be NULL if \a rotate is false
   \param rotate if true, the Cylinder will be rotated by \a angle around \a axis (default); if false, the Cylinder is not rotated */
-void Cylinder::build(double radius, double height, double red, double green, double blue, double angle, Vector &axis, bool rotate)
+void Cylinder::build(double radius, double height, double red, double green, double blue, double angle, const double *axis, bool rotate)
 {
-	gluQuadricDrawStyle(qobj, GLU_FILL);
-	gluQuadricNormals(qobj, GLU_SMOOTH);
-	glNewList(startList, GL_COMPILE);
-	if (lighting)
-		glNormal3d(0.0, -1.0, 0.0);
-	glColor3d(red, green, blue);
-	if (rotate)
-	{
-		glPushMatrix();
-		glRotated(angle, axis[0], axis[1], axis[2]);
-	}
-	gluDisk(qobj, 0.0, radius, 32, 32);
-	if (rotate)
-		glPopMatrix();
-	glEndList();
-	
-	gluQuadricDrawStyle(qobj, GLU_FILL);
-	gluQuadricNormals(qobj, GLU_SMOOTH);
-	glNewList(startList+1, GL_COMPILE);
-	if (lighting)
-		glNormal3d(0.0, 1.0, 0.0);
-	glColor3d(red, green, blue);
-	glPushMatrix();
-	if (rotate)
-		glRotated(angle, axis[0], axis[1], axis[2]);
-	else
-		glTranslated(0.0, 0.0, height);
-	gluDisk(qobj, 0.0, radius, 32, 32);
-	glPopMatrix();
-	glEndList();
-	
-	gluQuadricDrawStyle(qobj, GLU_FILL);
-	gluQuadricNormals(qobj, GLU_SMOOTH);
-	glNewList(startList+2, GL_COMPILE);
-	if (lighting)
-		glNormal3d(0.0, 0.0, 1.0);
-	glColor3d(red, green, blue);
+	this->radius = radius;
+	this->height = height;
+	color[0] = red;
+	color[1] = green;
+	color[2] = blue;
+	rotated = rotate;
+	this->angle = angle;
 	if (rotate)
 	{
-		glPushMatrix();
-		glRotated(angle, axis[0], axis[1], axis[2]);
+		this->axis[0] = axis[0];
+		this->axis[1] = axis[1];
+		this->axis[2] = axis[2];
 	}
-	gluCylinder(qobj, radius, radius, height, 32, 32);
-	if (rotate)
-		glPopMatrix();
-	glEndList();
 }
 
-//! Draw Method
-/*! Executes the startList to render the Cylinder */
-void Cylinder::draw()
+//! Geometry Method
+/*! Generates the Cylinder at its own size, unrotated, as the unit cylinder of a level of detail is generated.
+  \param data the mesh to add the Cylinder to
+  \param level the level of detail, from 0 (finest) to CYLINDER_LODS-1 */
+void Cylinder::geometry(MeshData &data, unsigned int level)
+{
+	int slices = lodSlices(level);
+	meshDisk(data, radius, 0.0, false, slices, 1);
+	meshDisk(data, radius, height, true, slices, 1);
+	meshCylinder(data, radius, height, slices, 1);
+}
+
+//! Get Bounds
+/*! \return the box and sphere around the Cylinder's geometry(), in its own coordinates */
+Bounds Cylinder::getBounds()
+{
+	double min[3] = {-radius, -radius, 0.0}, max[3] = {radius, radius, height};
+	Bounds bounds = boundsOf(min, max);
+	/* the sphere around the cylinder itself is tighter than the one around its box */
+	bounds.radius = sqrt(radius * radius + height * height / 4.0);
+	return bounds;
+}
+
+//! Get Color
+/*! \return array containing the color of the Cylinder in the form \f$(r,g,b)\f$ */
+const double *Cylinder::getColor()
+{
+	return color;
+}
+
+//! Place Method
+/*! \param model the transform of the Cylinder's part of the Robot
+  \return the transform from the Cylinder's geometry() to the coordinates of \a model, including its rotation */
+Mat4 Cylinder::place(const Mat4 &model)
+{
+	if (rotated)
+		return model * Mat4::rotate(angle, axis[0], axis[1], axis[2]);
+	return model;
+}
+
+//! Detail Level Slices
+/*! \param level the level of detail, from 0 (finest) to CYLINDER_LODS-1
+  \return the number of slices of the unit cylinder at \a level */
+int Cylinder::lodSlices(unsigned int level)
+{
+	return cylinderLods[level].slices;
+}
+
+//! Select Method
+/*! Chooses the level of detail from the radius the Cylinder would have on screen at the middle of its axis. A Cylinder drops to a coarser level as soon as it is smaller than its level's minimum, but only goes back once it is CYLINDER_LOD_HYSTERESIS times larger than that.
+  \param clip the transform from the Cylinder's own coordinates to clip coordinates
+  \param scale pixels covered by a unit length facing the camera at unit distance
+  \return the level of detail */
+unsigned int Cylinder::selectLod(const Mat4 &clip, double scale)
 {
-	glPushMatrix();
-	glCallList(startList);
-	glCallList(startList+1);
-	glCallList(startList+2);
-	glPopMatrix();
+	double center[4];
+	clip.apply(0.0, 0.0, height / 2.0, center);
+	/* w is the distance in front of the camera; anything behind it gets the coarsest level */
+	double pixels = center[3] > 0.0 ? radius * scale / center[3] : 0.0;
+	while (lod > 0 && pixels >= cylinderLods[lod-1].minimum * CYLINDER_LOD_HYSTERESIS)
+		lod--;
+	while (lod < CYLINDER_LODS - 1 && pixels < cylinderLods[lod].minimum)
+		lod++;
+	return lod;
 }
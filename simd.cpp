@@ -0,0 +1,843 @@
+#include <cmath>
+#include <cstdio>
+
+#if defined(__x86_64__)||defined(_M_X64)||defined(__SSE2__)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#endif
+#endif
+#if defined(__aarch64__)||defined(_M_ARM64)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#include "simd.h"
+
+/*! \file simd.cpp
+  \brief SIMD Vector Kernels
+
+  Every kernel exists in a portable version and in the vector versions the platform supports. The vector versions handle the bulk of the array in full registers and finish the remainder with scalar code. The AVX2 versions are compiled with a per function target attribute so the rest of the program doesn't require AVX2; they are only called after the processor has been checked for it. */
+
+//! Kernel Table
+/*! One implementation of every kernel. */
+struct simdKernels
+{
+	const char *name; /*!< Name Of The Instruction Set */
+	double (*dot)(const double *a,const double *b,unsigned int n); /*!< Dot Product */
+	void (*scale)(double *a,double k,unsigned int n); /*!< In Place Scaling */
+	void (*axpy)(double k,const double *x,double *y,unsigned int n); /*!< \f$y\leftarrow kx+y\f$ */
+	void (*cross3)(const double *a,const double *b,double *c,unsigned int count); /*!< Batched Cross Product */
+	void (*normalize3)(double *v,unsigned int count); /*!< Batched Normalization */
+	void (*rankUpdate)(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld); /*!< Single Precision \f$C\leftarrow C-AB\f$ */
+	void (*planes)(const double *planes,unsigned int count,const double *point,double *out); /*!< Point To Plane Distances */
+};
+
+//! Portable Dot Product
+/*! Four independent sums so the additions pipeline even without vector instructions.
+  \param a the first array
+  \param b the second array
+  \param n the number of elements
+  \return \f$\sum a_ib_i\f$ */
+static double dotScalar(const double *a,const double *b,unsigned int n)
+{
+	double s0=0.0,s1=0.0,s2=0.0,s3=0.0;
+	unsigned int i=0;
+	for (;i+4<=n;i+=4)
+	{
+		s0+=a[i]*b[i];
+		s1+=a[i+1]*b[i+1];
+		s2+=a[i+2]*b[i+2];
+		s3+=a[i+3]*b[i+3];
+	}
+	for (;i<n;i++)
+		s0+=a[i]*b[i];
+	return (s0+s1)+(s2+s3);
+}
+
+//! Portable Scaling
+/*! \param a the array to scale in place
+  \param k the scalar
+  \param n the number of elements */
+static void scaleScalar(double *a,double k,unsigned int n)
+{
+	for (unsigned int i=0;i<n;i++)
+		a[i]*=k;
+}
+
+//! Portable AXPY
+/*! \param k the scalar
+  \param x the array to add
+  \param y the array to accumulate into
+  \param n the number of elements */
+static void axpyScalar(double k,const double *x,double *y,unsigned int n)
+{
+	for (unsigned int i=0;i<n;i++)
+		y[i]+=k*x[i];
+}
+
+//! Portable Batched Cross Product
+/*! \param a packed \f$(x,y,z)\f$ left operands
+  \param b packed \f$(x,y,z)\f$ right operands
+  \param c packed \f$(x,y,z)\f$ results; may alias \a a or \a b
+  \param count the number of triples */
+static void cross3Scalar(const double *a,const double *b,double *c,unsigned int count)
+{
+	for (unsigned int i=0;i<count;i++,a+=3,b+=3,c+=3)
+		simdCross(a,b,c);
+}
+
+//! Portable Batched Normalization
+/*! Zero vectors are left as they are.
+  \param v packed \f$(x,y,z)\f$ triples to normalize in place
+  \param count the number of triples */
+static void normalize3Scalar(double *v,unsigned int count)
+{
+	for (unsigned int i=0;i<count;i++,v+=3)
+	{
+		double k=v[0]*v[0]+v[1]*v[1]+v[2]*v[2];
+		if (k>0.0)
+		{
+			k=1.0/sqrt(k);
+			v[0]*=k;
+			v[1]*=k;
+			v[2]*=k;
+		}
+	}
+}
+
+//! Portable Rank Update
+/*! Row by row so the innermost loop runs along contiguous rows of \a b and \a c. Also finishes the edges the vector versions leave over.
+  \param c the \f$rows\times cols\f$ block to update
+  \param a the \f$rows\times depth\f$ left factor
+  \param b the \f$depth\times cols\f$ right factor
+  \param rows the number of rows of \a c
+  \param cols the number of columns of \a c
+  \param depth the inner dimension
+  \param ld the row stride of all three blocks */
+static void rankUpdateScalar(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	for (unsigned int i=0;i<rows;i++)
+	{
+		float *ci=c+(size_t)i*ld;
+		for (unsigned int k=0;k<depth;k++)
+		{
+			float aik=a[(size_t)i*ld+k];
+			const float *bk=b+(size_t)k*ld;
+			for (unsigned int j=0;j<cols;j++)
+				ci[j]-=aik*bk[j];
+		}
+	}
+}
+
+//! Portable Plane Distances
+/*! Also finishes the planes the vector versions leave over.
+  \param planes the \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ coefficients of every plane, one row of \a count after the other
+  \param count the number of planes
+  \param point the point \f$(x,y,z)\f$
+  \param out the \a count values \f$ax+by+cz+d\f$ */
+static void planesScalar(const double *planes,unsigned int count,const double *point,double *out)
+{
+	for (unsigned int i=0;i<count;i++)
+		out[i]=planes[i]*point[0]+planes[count+i]*point[1]+planes[2*count+i]*point[2]+planes[3*count+i];
+}
+
+static const simdKernels scalarKernels={"scalar",dotScalar,scaleScalar,axpyScalar,cross3Scalar,normalize3Scalar,rankUpdateScalar,planesScalar};
+
+#ifdef SIMD_SSE2
+//! SSE2 Dot Product
+/*! Two registers of two sums each.
+  \param a the first array
+  \param b the second array
+  \param n the number of elements
+  \return \f$\sum a_ib_i\f$ */
+static double dotSSE2(const double *a,const double *b,unsigned int n)
+{
+	__m128d s0=_mm_setzero_pd(),s1=_mm_setzero_pd();
+	unsigned int i=0;
+	for (;i+4<=n;i+=4)
+	{
+		s0=_mm_add_pd(s0,_mm_mul_pd(_mm_loadu_pd(a+i),_mm_loadu_pd(b+i)));
+		s1=_mm_add_pd(s1,_mm_mul_pd(_mm_loadu_pd(a+i+2),_mm_loadu_pd(b+i+2)));
+	}
+	s0=_mm_add_pd(s0,s1);
+	s0=_mm_add_sd(s0,_mm_unpackhi_pd(s0,s0));
+	double answer=_mm_cvtsd_f64(s0);
+	for (;i<n;i++)
+		answer+=a[i]*b[i];
+	return answer;
+}
+
+//! SSE2 Scaling
+/*! \param a the array to scale in place
+  \param k the scalar
+  \param n the number of elements */
+static void scaleSSE2(double *a,double k,unsigned int n)
+{
+	__m128d kk=_mm_set1_pd(k);
+	unsigned int i=0;
+	for (;i+2<=n;i+=2)
+		_mm_storeu_pd(a+i,_mm_mul_pd(_mm_loadu_pd(a+i),kk));
+	for (;i<n;i++)
+		a[i]*=k;
+}
+
+//! SSE2 AXPY
+/*! \param k the scalar
+  \param x the array to add
+  \param y the array to accumulate into
+  \param n the number of elements */
+static void axpySSE2(double k,const double *x,double *y,unsigned int n)
+{
+	__m128d kk=_mm_set1_pd(k);
+	unsigned int i=0;
+	for (;i+2<=n;i+=2)
+		_mm_storeu_pd(y+i,_mm_add_pd(_mm_loadu_pd(y+i),_mm_mul_pd(kk,_mm_loadu_pd(x+i))));
+	for (;i<n;i++)
+		y[i]+=k*x[i];
+}
+
+//! SSE2 Rank Update
+/*! Blocks of \f$4\times8\f$ held in eight registers for the whole inner dimension, so each element of \a c is loaded and stored once per call.
+  \param c the \f$rows\times cols\f$ block to update
+  \param a the \f$rows\times depth\f$ left factor
+  \param b the \f$depth\times cols\f$ right factor
+  \param rows the number of rows of \a c
+  \param cols the number of columns of \a c
+  \param depth the inner dimension
+  \param ld the row stride of all three blocks */
+static void rankUpdateSSE2(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	unsigned int i=0;
+	for (;i+4<=rows;i+=4)
+	{
+		unsigned int j=0;
+		for (;j+8<=cols;j+=8)
+		{
+			float *c0=c+(size_t)i*ld+j;
+			__m128 r[8];
+			for (unsigned int q=0;q<4;q++)
+			{
+				r[2*q]=_mm_loadu_ps(c0+q*ld);
+				r[2*q+1]=_mm_loadu_ps(c0+q*ld+4);
+			}
+			for (unsigned int k=0;k<depth;k++)
+			{
+				__m128 b0=_mm_loadu_ps(b+(size_t)k*ld+j),b1=_mm_loadu_ps(b+(size_t)k*ld+j+4);
+				for (unsigned int q=0;q<4;q++)
+				{
+					__m128 aq=_mm_set1_ps(a[(size_t)(i+q)*ld+k]);
+					r[2*q]=_mm_sub_ps(r[2*q],_mm_mul_ps(aq,b0));
+					r[2*q+1]=_mm_sub_ps(r[2*q+1],_mm_mul_ps(aq,b1));
+				}
+			}
+			for (unsigned int q=0;q<4;q++)
+			{
+				_mm_storeu_ps(c0+q*ld,r[2*q]);
+				_mm_storeu_ps(c0+q*ld+4,r[2*q+1]);
+			}
+		}
+		rankUpdateScalar(c+(size_t)i*ld+j,a+(size_t)i*ld,b+j,4,cols-j,depth,ld);
+	}
+	rankUpdateScalar(c+(size_t)i*ld,a+(size_t)i*ld,b,rows-i,cols,depth,ld);
+}
+
+//! SSE2 Plane Distances
+/*! Two planes per register.
+  \param planes the \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ coefficients of every plane, one row of \a count after the other
+  \param count the number of planes
+  \param point the point \f$(x,y,z)\f$
+  \param out the \a count values \f$ax+by+cz+d\f$ */
+static void planesSSE2(const double *planes,unsigned int count,const double *point,double *out)
+{
+	__m128d x=_mm_set1_pd(point[0]),y=_mm_set1_pd(point[1]),z=_mm_set1_pd(point[2]);
+	unsigned int i=0;
+	for (;i+2<=count;i+=2)
+	{
+		__m128d r=_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(planes+i),x),_mm_mul_pd(_mm_loadu_pd(planes+count+i),y));
+		r=_mm_add_pd(r,_mm_mul_pd(_mm_loadu_pd(planes+2*count+i),z));
+		_mm_storeu_pd(out+i,_mm_add_pd(r,_mm_loadu_pd(planes+3*count+i)));
+	}
+	for (;i<count;i++)
+		out[i]=planes[i]*point[0]+planes[count+i]*point[1]+planes[2*count+i]*point[2]+planes[3*count+i];
+}
+
+static const simdKernels sse2Kernels={"sse2",dotSSE2,scaleSSE2,axpySSE2,cross3Scalar,normalize3Scalar,rankUpdateSSE2,planesSSE2};
+#endif
+
+#ifdef SIMD_AVX2
+#define SIMD_AVX2_TARGET __attribute__((target("avx2,fma")))
+
+//! AVX2 Dot Product
+/*! Four registers of four fused multiply-add sums each.
+  \param a the first array
+  \param b the second array
+  \param n the number of elements
+  \return \f$\sum a_ib_i\f$ */
+SIMD_AVX2_TARGET static double dotAVX2(const double *a,const double *b,unsigned int n)
+{
+	__m256d s0=_mm256_setzero_pd(),s1=_mm256_setzero_pd(),s2=_mm256_setzero_pd(),s3=_mm256_setzero_pd();
+	unsigned int i=0;
+	for (;i+16<=n;i+=16)
+	{
+		s0=_mm256_fmadd_pd(_mm256_loadu_pd(a+i),_mm256_loadu_pd(b+i),s0);
+		s1=_mm256_fmadd_pd(_mm256_loadu_pd(a+i+4),_mm256_loadu_pd(b+i+4),s1);
+		s2=_mm256_fmadd_pd(_mm256_loadu_pd(a+i+8),_mm256_loadu_pd(b+i+8),s2);
+		s3=_mm256_fmadd_pd(_mm256_loadu_pd(a+i+12),_mm256_loadu_pd(b+i+12),s3);
+	}
+	for (;i+4<=n;i+=4)
+		s0=_mm256_fmadd_pd(_mm256_loadu_pd(a+i),_mm256_loadu_pd(b+i),s0);
+	s0=_mm256_add_pd(_mm256_add_pd(s0,s1),_mm256_add_pd(s2,s3));
+	__m128d h=_mm_add_pd(_mm256_castpd256_pd128(s0),_mm256_extractf128_pd(s0,1));
+	h=_mm_add_sd(h,_mm_unpackhi_pd(h,h));
+	double answer=_mm_cvtsd_f64(h);
+	for (;i<n;i++)
+		answer+=a[i]*b[i];
+	return answer;
+}
+
+//! AVX2 Scaling
+/*! \param a the array to scale in place
+  \param k the scalar
+  \param n the number of elements */
+SIMD_AVX2_TARGET static void scaleAVX2(double *a,double k,unsigned int n)
+{
+	__m256d kk=_mm256_set1_pd(k);
+	unsigned int i=0;
+	for (;i+4<=n;i+=4)
+		_mm256_storeu_pd(a+i,_mm256_mul_pd(_mm256_loadu_pd(a+i),kk));
+	for (;i<n;i++)
+		a[i]*=k;
+}
+
+//! AVX2 AXPY
+/*! \param k the scalar
+  \param x the array to add
+  \param y the array to accumulate into
+  \param n the number of elements */
+SIMD_AVX2_TARGET static void axpyAVX2(double k,const double *x,double *y,unsigned int n)
+{
+	__m256d kk=_mm256_set1_pd(k);
+	unsigned int i=0;
+	for (;i+4<=n;i+=4)
+		_mm256_storeu_pd(y+i,_mm256_fmadd_pd(kk,_mm256_loadu_pd(x+i),_mm256_loadu_pd(y+i)));
+	for (;i<n;i++)
+		y[i]+=k*x[i];
+}
+
+//! Deinterleave Four Triples
+/*! Turns the registers \f$(x_0,y_0,z_0,x_1)\f$, \f$(y_1,z_1,x_2,y_2)\f$, \f$(z_2,x_3,y_3,z_3)\f$ into \f$(x_0..x_3)\f$, \f$(y_0..y_3)\f$, \f$(z_0..z_3)\f$. */
+SIMD_AVX2_TARGET static inline void unpackXYZ(__m256d r0,__m256d r1,__m256d r2,__m256d &x,__m256d &y,__m256d &z)
+{
+	x=_mm256_blend_pd(_mm256_blend_pd(_mm256_permute4x64_pd(r0,_MM_SHUFFLE(3,3,3,0)),_mm256_permute4x64_pd(r1,_MM_SHUFFLE(2,2,2,2)),0x4),_mm256_permute4x64_pd(r2,_MM_SHUFFLE(1,1,1,1)),0x8);
+	y=_mm256_blend_pd(_mm256_blend_pd(_mm256_permute4x64_pd(r0,_MM_SHUFFLE(1,1,1,1)),_mm256_permute4x64_pd(r1,_MM_SHUFFLE(3,3,0,0)),0x6),_mm256_permute4x64_pd(r2,_MM_SHUFFLE(2,2,2,2)),0x8);
+	z=_mm256_blend_pd(_mm256_blend_pd(_mm256_permute4x64_pd(r0,_MM_SHUFFLE(2,2,2,2)),_mm256_permute4x64_pd(r1,_MM_SHUFFLE(1,1,1,1)),0x2),_mm256_permute4x64_pd(r2,_MM_SHUFFLE(3,0,0,0)),0xc);
+}
+
+//! Interleave Four Triples
+/*! Inverse of unpackXYZ(). */
+SIMD_AVX2_TARGET static inline void packXYZ(__m256d x,__m256d y,__m256d z,__m256d &r0,__m256d &r1,__m256d &r2)
+{
+	r0=_mm256_blend_pd(_mm256_blend_pd(_mm256_permute4x64_pd(x,_MM_SHUFFLE(1,0,0,0)),_mm256_permute4x64_pd(y,_MM_SHUFFLE(0,0,0,0)),0x2),_mm256_permute4x64_pd(z,_MM_SHUFFLE(0,0,0,0)),0x4);
+	r1=_mm256_blend_pd(_mm256_blend_pd(_mm256_permute4x64_pd(y,_MM_SHUFFLE(2,1,1,1)),_mm256_permute4x64_pd(z,_MM_SHUFFLE(1,1,1,1)),0x2),_mm256_permute4x64_pd(x,_MM_SHUFFLE(2,2,2,2)),0x4);
+	r2=_mm256_blend_pd(_mm256_blend_pd(_mm256_permute4x64_pd(z,_MM_SHUFFLE(3,2,2,2)),_mm256_permute4x64_pd(x,_MM_SHUFFLE(3,3,3,3)),0x2),_mm256_permute4x64_pd(y,_MM_SHUFFLE(3,3,3,3)),0x4);
+}
+
+//! AVX2 Batched Cross Product
+/*! Four triples per iteration, deinterleaved into \f$x\f$, \f$y\f$ and \f$z\f$ registers.
+  \param a packed \f$(x,y,z)\f$ left operands
+  \param b packed \f$(x,y,z)\f$ right operands
+  \param c packed \f$(x,y,z)\f$ results; may alias \a a or \a b
+  \param count the number of triples */
+SIMD_AVX2_TARGET static void cross3AVX2(const double *a,const double *b,double *c,unsigned int count)
+{
+	unsigned int i=0;
+	for (;i+4<=count;i+=4,a+=12,b+=12,c+=12)
+	{
+		__m256d ax,ay,az,bx,by,bz,r0,r1,r2;
+		unpackXYZ(_mm256_loadu_pd(a),_mm256_loadu_pd(a+4),_mm256_loadu_pd(a+8),ax,ay,az);
+		unpackXYZ(_mm256_loadu_pd(b),_mm256_loadu_pd(b+4),_mm256_loadu_pd(b+8),bx,by,bz);
+		packXYZ(_mm256_fmsub_pd(ay,bz,_mm256_mul_pd(az,by)),
+			_mm256_fmsub_pd(az,bx,_mm256_mul_pd(ax,bz)),
+			_mm256_fmsub_pd(ax,by,_mm256_mul_pd(ay,bx)),r0,r1,r2);
+		_mm256_storeu_pd(c,r0);
+		_mm256_storeu_pd(c+4,r1);
+		_mm256_storeu_pd(c+8,r2);
+	}
+	cross3Scalar(a,b,c,count-i);
+}
+
+//! AVX2 Batched Normalization
+/*! Four triples per iteration. The reciprocal lengths are spread back over the interleaved layout so the triples never have to be repacked. Zero vectors are left as they are.
+  \param v packed \f$(x,y,z)\f$ triples to normalize in place
+  \param count the number of triples */
+SIMD_AVX2_TARGET static void normalize3AVX2(double *v,unsigned int count)
+{
+	const __m256d zero=_mm256_setzero_pd(),one=_mm256_set1_pd(1.0);
+	unsigned int i=0;
+	for (;i+4<=count;i+=4,v+=12)
+	{
+		__m256d r0=_mm256_loadu_pd(v),r1=_mm256_loadu_pd(v+4),r2=_mm256_loadu_pd(v+8),x,y,z;
+		unpackXYZ(r0,r1,r2,x,y,z);
+		__m256d k=_mm256_fmadd_pd(x,x,_mm256_fmadd_pd(y,y,_mm256_mul_pd(z,z)));
+		__m256d live=_mm256_cmp_pd(k,zero,_CMP_GT_OQ);
+		k=_mm256_blendv_pd(one,_mm256_div_pd(one,_mm256_sqrt_pd(k)),live);
+		_mm256_storeu_pd(v,_mm256_mul_pd(r0,_mm256_permute4x64_pd(k,_MM_SHUFFLE(1,0,0,0))));
+		_mm256_storeu_pd(v+4,_mm256_mul_pd(r1,_mm256_permute4x64_pd(k,_MM_SHUFFLE(2,2,1,1))));
+		_mm256_storeu_pd(v+8,_mm256_mul_pd(r2,_mm256_permute4x64_pd(k,_MM_SHUFFLE(3,3,3,2))));
+	}
+	normalize3Scalar(v,count-i);
+}
+
+//! AVX2 Rank Update
+/*! Blocks of \f$4\times16\f$ held in eight registers for the whole inner dimension: two loads of \a b and four broadcasts of \a a feed eight fused multiply-adds.
+  \param c the \f$rows\times cols\f$ block to update
+  \param a the \f$rows\times depth\f$ left factor
+  \param b the \f$depth\times cols\f$ right factor
+  \param rows the number of rows of \a c
+  \param cols the number of columns of \a c
+  \param depth the inner dimension
+  \param ld the row stride of all three blocks */
+SIMD_AVX2_TARGET static void rankUpdateAVX2(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	unsigned int i=0;
+	for (;i+4<=rows;i+=4)
+	{
+		unsigned int j=0;
+		for (;j+16<=cols;j+=16)
+		{
+			float *c0=c+(size_t)i*ld+j;
+			__m256 r[8];
+			for (unsigned int q=0;q<4;q++)
+			{
+				r[2*q]=_mm256_loadu_ps(c0+q*ld);
+				r[2*q+1]=_mm256_loadu_ps(c0+q*ld+8);
+			}
+			for (unsigned int k=0;k<depth;k++)
+			{
+				__m256 b0=_mm256_loadu_ps(b+(size_t)k*ld+j),b1=_mm256_loadu_ps(b+(size_t)k*ld+j+8);
+				for (unsigned int q=0;q<4;q++)
+				{
+					__m256 aq=_mm256_broadcast_ss(a+(size_t)(i+q)*ld+k);
+					r[2*q]=_mm256_fnmadd_ps(aq,b0,r[2*q]);
+					r[2*q+1]=_mm256_fnmadd_ps(aq,b1,r[2*q+1]);
+				}
+			}
+			for (unsigned int q=0;q<4;q++)
+			{
+				_mm256_storeu_ps(c0+q*ld,r[2*q]);
+				_mm256_storeu_ps(c0+q*ld+8,r[2*q+1]);
+			}
+		}
+		rankUpdateScalar(c+(size_t)i*ld+j,a+(size_t)i*ld,b+j,4,cols-j,depth,ld);
+	}
+	rankUpdateScalar(c+(size_t)i*ld,a+(size_t)i*ld,b,rows-i,cols,depth,ld);
+}
+
+//! AVX2 Plane Distances
+/*! Four planes per register, in three fused multiply-adds.
+  \param planes the \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ coefficients of every plane, one row of \a count after the other
+  \param count the number of planes
+  \param point the point \f$(x,y,z)\f$
+  \param out the \a count values \f$ax+by+cz+d\f$ */
+SIMD_AVX2_TARGET static void planesAVX2(const double *planes,unsigned int count,const double *point,double *out)
+{
+	__m256d x=_mm256_set1_pd(point[0]),y=_mm256_set1_pd(point[1]),z=_mm256_set1_pd(point[2]);
+	unsigned int i=0;
+	for (;i+4<=count;i+=4)
+	{
+		__m256d r=_mm256_fmadd_pd(_mm256_loadu_pd(planes+i),x,_mm256_loadu_pd(planes+3*count+i));
+		r=_mm256_fmadd_pd(_mm256_loadu_pd(planes+count+i),y,r);
+		_mm256_storeu_pd(out+i,_mm256_fmadd_pd(_mm256_loadu_pd(planes+2*count+i),z,r));
+	}
+	for (;i<count;i++)
+		out[i]=planes[i]*point[0]+planes[count+i]*point[1]+planes[2*count+i]*point[2]+planes[3*count+i];
+}
+
+static const simdKernels avx2Kernels={"avx2",dotAVX2,scaleAVX2,axpyAVX2,cross3AVX2,normalize3AVX2,rankUpdateAVX2,planesAVX2};
+#endif
+
+#ifdef SIMD_NEON
+//! NEON Dot Product
+/*! Two registers of two fused multiply-add sums each.
+  \param a the first array
+  \param b the second array
+  \param n the number of elements
+  \return \f$\sum a_ib_i\f$ */
+static double dotNEON(const double *a,const double *b,unsigned int n)
+{
+	float64x2_t s0=vdupq_n_f64(0.0),s1=vdupq_n_f64(0.0);
+	unsigned int i=0;
+	for (;i+4<=n;i+=4)
+	{
+		s0=vfmaq_f64(s0,vld1q_f64(a+i),vld1q_f64(b+i));
+		s1=vfmaq_f64(s1,vld1q_f64(a+i+2),vld1q_f64(b+i+2));
+	}
+	double answer=vaddvq_f64(vaddq_f64(s0,s1));
+	for (;i<n;i++)
+		answer+=a[i]*b[i];
+	return answer;
+}
+
+//! NEON Scaling
+/*! \param a the array to scale in place
+  \param k the scalar
+  \param n the number of elements */
+static void scaleNEON(double *a,double k,unsigned int n)
+{
+	unsigned int i=0;
+	for (;i+2<=n;i+=2)
+		vst1q_f64(a+i,vmulq_n_f64(vld1q_f64(a+i),k));
+	for (;i<n;i++)
+		a[i]*=k;
+}
+
+//! NEON AXPY
+/*! \param k the scalar
+  \param x the array to add
+  \param y the array to accumulate into
+  \param n the number of elements */
+static void axpyNEON(double k,const double *x,double *y,unsigned int n)
+{
+	float64x2_t kk=vdupq_n_f64(k);
+	unsigned int i=0;
+	for (;i+2<=n;i+=2)
+		vst1q_f64(y+i,vfmaq_f64(vld1q_f64(y+i),kk,vld1q_f64(x+i)));
+	for (;i<n;i++)
+		y[i]+=k*x[i];
+}
+
+//! NEON Batched Cross Product
+/*! Two triples per iteration using the deinterleaving loads.
+  \param a packed \f$(x,y,z)\f$ left operands
+  \param b packed \f$(x,y,z)\f$ right operands
+  \param c packed \f$(x,y,z)\f$ results; may alias \a a or \a b
+  \param count the number of triples */
+static void cross3NEON(const double *a,const double *b,double *c,unsigned int count)
+{
+	unsigned int i=0;
+	for (;i+2<=count;i+=2,a+=6,b+=6,c+=6)
+	{
+		float64x2x3_t p=vld3q_f64(a),q=vld3q_f64(b),r;
+		r.val[0]=vfmsq_f64(vmulq_f64(p.val[1],q.val[2]),p.val[2],q.val[1]);
+		r.val[1]=vfmsq_f64(vmulq_f64(p.val[2],q.val[0]),p.val[0],q.val[2]);
+		r.val[2]=vfmsq_f64(vmulq_f64(p.val[0],q.val[1]),p.val[1],q.val[0]);
+		vst3q_f64(c,r);
+	}
+	cross3Scalar(a,b,c,count-i);
+}
+
+//! NEON Batched Normalization
+/*! Two triples per iteration using the deinterleaving loads. Zero vectors are left as they are.
+  \param v packed \f$(x,y,z)\f$ triples to normalize in place
+  \param count the number of triples */
+static void normalize3NEON(double *v,unsigned int count)
+{
+	const float64x2_t one=vdupq_n_f64(1.0);
+	unsigned int i=0;
+	for (;i+2<=count;i+=2,v+=6)
+	{
+		float64x2x3_t p=vld3q_f64(v);
+		float64x2_t k=vfmaq_f64(vfmaq_f64(vmulq_f64(p.val[2],p.val[2]),p.val[1],p.val[1]),p.val[0],p.val[0]);
+		k=vbslq_f64(vcgtzq_f64(k),vdivq_f64(one,vsqrtq_f64(k)),one);
+		p.val[0]=vmulq_f64(p.val[0],k);
+		p.val[1]=vmulq_f64(p.val[1],k);
+		p.val[2]=vmulq_f64(p.val[2],k);
+		vst3q_f64(v,p);
+	}
+	normalize3Scalar(v,count-i);
+}
+
+//! NEON Rank Update
+/*! Blocks of \f$4\times8\f$ held in eight registers for the whole inner dimension.
+  \param c the \f$rows\times cols\f$ block to update
+  \param a the \f$rows\times depth\f$ left factor
+  \param b the \f$depth\times cols\f$ right factor
+  \param rows the number of rows of \a c
+  \param cols the number of columns of \a c
+  \param depth the inner dimension
+  \param ld the row stride of all three blocks */
+static void rankUpdateNEON(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	unsigned int i=0;
+	for (;i+4<=rows;i+=4)
+	{
+		unsigned int j=0;
+		for (;j+8<=cols;j+=8)
+		{
+			float *c0=c+(size_t)i*ld+j;
+			float32x4_t r[8];
+			for (unsigned int q=0;q<4;q++)
+			{
+				r[2*q]=vld1q_f32(c0+q*ld);
+				r[2*q+1]=vld1q_f32(c0+q*ld+4);
+			}
+			for (unsigned int k=0;k<depth;k++)
+			{
+				float32x4_t b0=vld1q_f32(b+(size_t)k*ld+j),b1=vld1q_f32(b+(size_t)k*ld+j+4);
+				for (unsigned int q=0;q<4;q++)
+				{
+					float32x4_t aq=vdupq_n_f32(a[(size_t)(i+q)*ld+k]);
+					r[2*q]=vfmsq_f32(r[2*q],aq,b0);
+					r[2*q+1]=vfmsq_f32(r[2*q+1],aq,b1);
+				}
+			}
+			for (unsigned int q=0;q<4;q++)
+			{
+				vst1q_f32(c0+q*ld,r[2*q]);
+				vst1q_f32(c0+q*ld+4,r[2*q+1]);
+			}
+		}
+		rankUpdateScalar(c+(size_t)i*ld+j,a+(size_t)i*ld,b+j,4,cols-j,depth,ld);
+	}
+	rankUpdateScalar(c+(size_t)i*ld,a+(size_t)i*ld,b,rows-i,cols,depth,ld);
+}
+
+//! NEON Plane Distances
+/*! Two planes per register.
+  \param planes the \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ coefficients of every plane, one row of \a count after the other
+  \param count the number of planes
+  \param point the point \f$(x,y,z)\f$
+  \param out the \a count values \f$ax+by+cz+d\f$ */
+static void planesNEON(const double *planes,unsigned int count,const double *point,double *out)
+{
+	unsigned int i=0;
+	for (;i+2<=count;i+=2)
+	{
+		float64x2_t r=vfmaq_n_f64(vld1q_f64(planes+3*count+i),vld1q_f64(planes+i),point[0]);
+		r=vfmaq_n_f64(r,vld1q_f64(planes+count+i),point[1]);
+		vst1q_f64(out+i,vfmaq_n_f64(r,vld1q_f64(planes+2*count+i),point[2]));
+	}
+	for (;i<count;i++)
+		out[i]=planes[i]*point[0]+planes[count+i]*point[1]+planes[2*count+i]*point[2]+planes[3*count+i];
+}
+
+static const simdKernels neonKernels={"neon",dotNEON,scaleNEON,axpyNEON,cross3NEON,normalize3NEON,rankUpdateNEON,planesNEON};
+#endif
+
+//! Kernel Selection
+/*! Picks the widest implementation the processor supports.
+  \return the kernel table */
+static const simdKernels *selectKernels()
+{
+	const simdKernels *selected=&scalarKernels;
+#if defined(SIMD_NEON)
+	selected=&neonKernels;
+#elif defined(SIMD_SSE2)
+	selected=&sse2Kernels;
+#endif
+#ifdef SIMD_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")&&__builtin_cpu_supports("fma"))
+		selected=&avx2Kernels;
+#endif
+	return selected;
+}
+
+//! Active Kernels
+/*! The table chosen by selectKernels() the first time any kernel is called.
+  \return the kernel table */
+static const simdKernels &kernels()
+{
+	static const simdKernels *selected=selectKernels();
+	return *selected;
+}
+
+//! Dot Product
+/*! \param a the first array
+  \param b the second array
+  \param n the number of elements
+  \return \f$\sum_{i=0}^{n-1}a_ib_i\f$ */
+double simdDot(const double *a,const double *b,unsigned int n)
+{
+	return kernels().dot(a,b,n);
+}
+
+//! Scale
+/*! \param a the array to scale in place
+  \param k the scalar
+  \param n the number of elements */
+void simdScale(double *a,double k,unsigned int n)
+{
+	kernels().scale(a,k,n);
+}
+
+//! AXPY
+/*! Computes \f$y\leftarrow kx+y\f$ in place.
+  \param k the scalar
+  \param x the array to add
+  \param y the array to accumulate into
+  \param n the number of elements */
+void simdAxpy(double k,const double *x,double *y,unsigned int n)
+{
+	kernels().axpy(k,x,y,n);
+}
+
+//! Cross Product
+/*! Cross product of a single pair of triples; too small to be worth vectorizing so there is only one version.
+  \param a the left operand
+  \param b the right operand
+  \param c the result; may alias \a a or \a b */
+void simdCross(const double *a,const double *b,double *c)
+{
+	double x=a[1]*b[2]-a[2]*b[1];
+	double y=a[2]*b[0]-a[0]*b[2];
+	double z=a[0]*b[1]-a[1]*b[0];
+	c[0]=x;
+	c[1]=y;
+	c[2]=z;
+}
+
+//! Batched Cross Product
+/*! Computes \f$c_i=a_i\times b_i\f$ over arrays of packed \f$(x,y,z)\f$ triples.
+  \param a the left operands
+  \param b the right operands
+  \param c the results; may alias \a a or \a b
+  \param count the number of triples */
+void simdCross3(const double *a,const double *b,double *c,unsigned int count)
+{
+	kernels().cross3(a,b,c,count);
+}
+
+//! Batched Normalization
+/*! Normalizes an array of packed \f$(x,y,z)\f$ triples in place. Zero vectors are left as they are.
+  \param v the triples
+  \param count the number of triples */
+void simdNormalize3(double *v,unsigned int count)
+{
+	kernels().normalize3(v,count);
+}
+
+//! Single Precision Rank Update
+/*! Computes \f$C\leftarrow C-AB\f$ on row major blocks of one larger array, the trailing update of a blocked LU decomposition.
+  \param c the \f$rows\times cols\f$ block to update
+  \param a the \f$rows\times depth\f$ left factor
+  \param b the \f$depth\times cols\f$ right factor
+  \param rows the number of rows of \a c
+  \param cols the number of columns of \a c
+  \param depth the inner dimension
+  \param ld the row stride of all three blocks */
+void simdRankUpdate(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld)
+{
+	kernels().rankUpdate(c,a,b,rows,cols,depth,ld);
+}
+
+//! Point To Plane Distances
+/*! Evaluates the plane equations of many planes at one point, such as the signed distances of a bounding sphere's center to the planes of a frustum. The coefficients are stored as four rows, so consecutive planes fill a register.
+  \param planes the \f$a\f$, \f$b\f$, \f$c\f$ and \f$d\f$ coefficients of every plane, one row of \a count after the other
+  \param count the number of planes
+  \param point the point \f$(x,y,z)\f$
+  \param out the \a count values \f$ax+by+cz+d\f$, which are distances if every \f$(a,b,c)\f$ is a unit vector */
+void simdPlaneDistances(const double *planes,unsigned int count,const double *point,double *out)
+{
+	kernels().planes(planes,count,point,out);
+}
+
+//! Check Tolerance
+/*! Largest difference allowed between a vector kernel and the portable one on values of magnitude up to one, which only sum in a different order. */
+#define SIMD_CHECK_TOLERANCE 1e-10
+
+//! Check Sizes
+/*! Kernels are checked at every size up to this one, so every way of splitting an array between full registers and the remainder is covered. */
+#define SIMD_CHECK_SIZES 37
+
+//! Check One Kernel Table
+/*! Runs every kernel of \a k and of the portable table on the same pseudorandom data.
+  \param k the kernels to check
+  \return the name of the first kernel that disagrees with the portable one, or NULL if none does */
+static const char *checkKernels(const simdKernels &k)
+{
+	const unsigned int n=4*SIMD_CHECK_SIZES;
+	const unsigned int square=SIMD_CHECK_SIZES*SIMD_CHECK_SIZES;
+	double a[n],b[n],x[n],y[n],out[SIMD_CHECK_SIZES],expected[SIMD_CHECK_SIZES];
+	static float fa[square],fb[square],fc[square],fd[square];
+	unsigned long seed=1;
+	for (unsigned int i=0;i<square;i++)
+	{
+		seed=(seed*1103515245+12345)&0x7fffffff;
+		fa[i]=2.0*seed/0x7fffffff-1.0;
+		seed=(seed*1103515245+12345)&0x7fffffff;
+		fb[i]=2.0*seed/0x7fffffff-1.0;
+		if (i<n)
+		{
+			a[i]=fa[i];
+			b[i]=fb[i];
+		}
+	}
+	for (unsigned int m=0;m<=SIMD_CHECK_SIZES;m++)
+	{
+		if (fabs(k.dot(a,b,m)-scalarKernels.dot(a,b,m))>SIMD_CHECK_TOLERANCE)
+			return "dot";
+		for (unsigned int i=0;i<m;i++)
+			x[i]=y[i]=a[i];
+		k.scale(x,0.75,m);
+		scalarKernels.scale(y,0.75,m);
+		k.axpy(-0.5,b,x,m);
+		scalarKernels.axpy(-0.5,b,y,m);
+		for (unsigned int i=0;i<m;i++)
+			if (fabs(x[i]-y[i])>SIMD_CHECK_TOLERANCE)
+				return "scale and axpy";
+		/* the batched kernels take m triples */
+		k.cross3(a,b,x,m);
+		scalarKernels.cross3(a,b,y,m);
+		k.normalize3(x,m);
+		scalarKernels.normalize3(y,m);
+		for (unsigned int i=0;i<3*m;i++)
+			if (fabs(x[i]-y[i])>SIMD_CHECK_TOLERANCE)
+				return "cross3 and normalize3";
+		k.planes(a,m,b,out);
+		scalarKernels.planes(a,m,b,expected);
+		for (unsigned int i=0;i<m;i++)
+			if (fabs(out[i]-expected[i])>SIMD_CHECK_TOLERANCE)
+				return "planes";
+		/* m by m blocks of square arrays, three deep */
+		for (unsigned int i=0;i<square;i++)
+			fc[i]=fd[i]=fb[square-1-i];
+		k.rankUpdate(fc,fa,fb,m,m,3,SIMD_CHECK_SIZES);
+		scalarKernels.rankUpdate(fd,fa,fb,m,m,3,SIMD_CHECK_SIZES);
+		for (unsigned int i=0;i<square;i++)
+			if (fabs(fc[i]-fd[i])>1e-5)
+				return "rankUpdate";
+	}
+	return NULL;
+}
+
+//! Check Kernels
+/*! Compares every vector implementation the processor can run with the portable one, whichever is in use. Benchmarks and tests call this before trusting the vector kernels.
+  \return NULL if they all agree, otherwise a description of the first difference, such as <tt>"avx2 planes"</tt> */
+const char *simdCheck()
+{
+	static char failure[64];
+	const simdKernels *tables[3];
+	unsigned int count=0;
+#ifdef SIMD_SSE2
+	tables[count++]=&sse2Kernels;
+#endif
+#ifdef SIMD_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")&&__builtin_cpu_supports("fma"))
+		tables[count++]=&avx2Kernels;
+#endif
+#ifdef SIMD_NEON
+	tables[count++]=&neonKernels;
+#endif
+	for (unsigned int i=0;i<count;i++)
+	{
+		const char *kernel=checkKernels(*tables[i]);
+		if (kernel)
+		{
+			snprintf(failure,sizeof(failure),"%s %s",tables[i]->name,kernel);
+			return failure;
+		}
+	}
+	return NULL;
+}
+
+//! Active Instruction Set
+/*! \return the name of the kernels in use: \c avx2, \c sse2, \c neon or \c scalar */
+const char *simdPath()
+{
+	return kernels().name;
+}
@@ -0,0 +1,20 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*! \file simd.h
+  \brief SIMD Vector Kernels
+
+  Dense kernels on raw arrays of doubles behind Vector, for bulk work on packed \f$(x,y,z)\f$ arrays such as surface normals, plane tests for culling, and the single precision update at the heart of Matrix::solveMixed(). The implementation is picked once at run time: AVX2/FMA or SSE2 on x86, NEON on ARM, and portable C++ everywhere else. Results may differ in the last bits between implementations since they sum in different orders; for a given machine they are always the same. */
+
+double simdDot(const double *a,const double *b,unsigned int n);
+void simdScale(double *a,double k,unsigned int n);
+void simdAxpy(double k,const double *x,double *y,unsigned int n);
+void simdCross(const double *a,const double *b,double *c);
+void simdCross3(const double *a,const double *b,double *c,unsigned int count);
+void simdNormalize3(double *v,unsigned int count);
+void simdRankUpdate(float *c,const float *a,const float *b,unsigned int rows,unsigned int cols,unsigned int depth,unsigned int ld);
+void simdPlaneDistances(const double *planes,unsigned int count,const double *point,double *out);
+const char *simdPath();
+const char *simdCheck();
+
+#endif
@@ -0,0 +1,442 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+#include "linalg.h"
+
+/*! \file svd.cpp
+  \brief One Sided Jacobi Singular Value Decomposition
+
+  Implements the singular value decomposition \f$A=USV^T\f$ by one sided (Hestenes) Jacobi rotations. Small matrices (\f$3\times3\f$, \f$4\times4\f$ and \f$6\times n\f$) are decomposed by kernels whose dimensions are known at compile time so the compiler can fully unroll them; these never touch the heap. Everything else uses the same kernel with runtime dimensions and a blocked rotation order so the working set of column pairs stays in cache. */
+
+//! Maximum Number Of Sweeps
+/*! Jacobi SVD converges quadratically; a well scaled matrix needs 6 to 10 sweeps. This is only a safety net. */
+#define SVD_MAX_SWEEPS 60
+
+//! Rotation Block Size
+/*! Number of columns in a block of the blocked rotation order. Two blocks of columns are swept against each other before moving on. */
+#define SVD_BLOCK 16
+
+//! Largest Column Count For The Small Path
+/*! \f$6\times n\f$ matrices with \f$n\le\f$ SVD_SMALL_MAX take the unrolled path. */
+#define SVD_SMALL_MAX 8
+
+//! Runtime Dimensions
+/*! Dimensions of the column major working matrix for the general path. */
+struct DynamicDims
+{
+	unsigned int m; /*!< Number Of Rows */
+	unsigned int n; /*!< Number Of Columns */
+	unsigned int rows() const {return m;}
+	unsigned int cols() const {return n;}
+};
+
+//! Compile Time Dimensions
+/*! Dimensions of the column major working matrix for the small path. Since the loop bounds are constants the kernels are unrolled. */
+template<unsigned int M,unsigned int N>
+struct FixedDims
+{
+	unsigned int rows() const {return M;}
+	unsigned int cols() const {return N;}
+};
+
+//! Jacobi Rotation
+/*! Orthogonalizes columns \a p and \a q of the column major working matrix \a a and accumulates the rotation into \a v.
+  \param d the dimensions of \a a
+  \param a the \f$m\times n\f$ working matrix
+  \param v the \f$n\times n\f$ right singular vectors
+  \param p the first column
+  \param q the second column
+  \return true if a rotation was applied, false if the columns were already orthogonal */
+template<class Dims>
+static inline bool jacobiRotate(const Dims &d,double *a,double *v,unsigned int p,unsigned int q)
+{
+	const unsigned int m=d.rows(),n=d.cols();
+	double *ap=a+p*m,*aq=a+q*m,*vp=v+p*n,*vq=v+q*n;
+	double alpha=0.0,beta=0.0,gamma=0.0;
+	for (unsigned int i=0;i<m;i++)
+	{
+		alpha+=ap[i]*ap[i];
+		beta+=aq[i]*aq[i];
+		gamma+=ap[i]*aq[i];
+	}
+	if (gamma==0.0||fabs(gamma)<=DBL_EPSILON*sqrt(alpha*beta))
+		return false;
+	/* t is the smaller root of t^2+2zt-1=0 which zeroes the inner product */
+	double zeta=(beta-alpha)/(2.0*gamma);
+	double t=(zeta>=0.0?1.0:-1.0)/(fabs(zeta)+sqrt(1.0+zeta*zeta));
+	double c=1.0/sqrt(1.0+t*t),s=c*t;
+	for (unsigned int i=0;i<m;i++)
+	{
+		double x=ap[i],y=aq[i];
+		ap[i]=c*x-s*y;
+		aq[i]=s*x+c*y;
+	}
+	for (unsigned int i=0;i<n;i++)
+	{
+		double x=vp[i],y=vq[i];
+		vp[i]=c*x-s*y;
+		vq[i]=s*x+c*y;
+	}
+	return true;
+}
+
+//! Jacobi Sweeps
+/*! Applies sweeps of rotations to every column pair of \a a until the columns are mutually orthogonal. The pairs are visited block by block so that large matrices only stream two blocks of columns at a time.
+  \param d the dimensions of \a a
+  \param a the \f$m\times n\f$ working matrix, \f$m\ge n\f$
+  \param v receives the \f$n\times n\f$ right singular vectors */
+template<class Dims>
+static void jacobiSweeps(const Dims &d,double *a,double *v)
+{
+	const unsigned int m=d.rows(),n=d.cols();
+	unsigned long pairs=0,rotations=0;
+	for (unsigned int i=0;i<n;i++)
+		for (unsigned int j=0;j<n;j++)
+			v[i*n+j]=(i==j)?1.0:0.0;
+	for (unsigned int sweep=0;sweep<SVD_MAX_SWEEPS;sweep++)
+	{
+		bool rotated=false;
+		for (unsigned int bi=0;bi<n;bi+=SVD_BLOCK)
+		{
+			unsigned int pe=(bi+SVD_BLOCK<n)?bi+SVD_BLOCK:n;
+			for (unsigned int bj=bi;bj<n;bj+=SVD_BLOCK)
+			{
+				unsigned int qe=(bj+SVD_BLOCK<n)?bj+SVD_BLOCK:n;
+				for (unsigned int p=bi;p<pe;p++)
+					for (unsigned int q=(bj==bi)?p+1:bj;q<qe;q++)
+					{
+						pairs++;
+						if (jacobiRotate(d,a,v,p,q))
+						{
+							rotations++;
+							rotated=true;
+						}
+					}
+			}
+		}
+		if (!rotated)
+			break;
+	}
+	/* 6m to test a pair, 6(m+n) more to rotate it */
+	LINALG_FLOPS(OP_SVD,pairs*6*m+rotations*6*(m+n));
+}
+
+//! Extract Singular Values
+/*! Turns the orthogonalized columns of \a a into singular values and left singular vectors, sorted by decreasing singular value. Columns belonging to a zero singular value are left as zero.
+  \param d the dimensions of \a a
+  \param a the working matrix; receives the left singular vectors
+  \param v the right singular vectors; permuted along with \a a
+  \param s receives the \f$n\f$ singular values */
+template<class Dims>
+static void jacobiFinish(const Dims &d,double *a,double *v,double *s)
+{
+	const unsigned int m=d.rows(),n=d.cols();
+	for (unsigned int j=0;j<n;j++)
+	{
+		double sum=0.0;
+		for (unsigned int i=0;i<m;i++)
+			sum+=a[j*m+i]*a[j*m+i];
+		s[j]=sqrt(sum);
+	}
+	/* selection sort by swapping columns in place */
+	for (unsigned int j=0;j<n;j++)
+	{
+		unsigned int k=j;
+		for (unsigned int i=j+1;i<n;i++)
+			if (s[i]>s[k])
+				k=i;
+		if (k==j)
+			continue;
+		double temp=s[j];
+		s[j]=s[k];
+		s[k]=temp;
+		for (unsigned int i=0;i<m;i++)
+		{
+			temp=a[j*m+i];
+			a[j*m+i]=a[k*m+i];
+			a[k*m+i]=temp;
+		}
+		for (unsigned int i=0;i<n;i++)
+		{
+			temp=v[j*n+i];
+			v[j*n+i]=v[k*n+i];
+			v[k*n+i]=temp;
+		}
+	}
+	for (unsigned int j=0;j<n;j++)
+		if (s[j]>0.0)
+			for (unsigned int i=0;i<m;i++)
+				a[j*m+i]/=s[j];
+}
+
+//! Fixed Size SVD
+/*! Decomposes an \f$M\times N\f$ matrix (\f$M\ge N\f$) entirely on the stack. If \a trans is true, \a a holds the \f$N\times M\f$ matrix \f$A^T\f$ and the roles of \a u and \a v are swapped so the caller still gets the decomposition of the matrix it passed in.
+  \param a row major input
+  \param trans whether \a a is stored transposed
+  \param u receives the row major left singular vectors
+  \param s receives the singular values
+  \param v receives the row major right singular vectors */
+template<unsigned int M,unsigned int N>
+static void svdFixed(const double *a,bool trans,double *u,double *s,double *v)
+{
+	FixedDims<M,N> d;
+	double w[M*N],x[N*N];
+	for (unsigned int i=0;i<M;i++)
+		for (unsigned int j=0;j<N;j++)
+			w[j*M+i]=trans?a[j*M+i]:a[i*N+j];
+	jacobiSweeps(d,w,x);
+	jacobiFinish(d,w,x,s);
+	double *wOut=trans?v:u,*xOut=trans?u:v;
+	for (unsigned int i=0;i<M;i++)
+		for (unsigned int j=0;j<N;j++)
+			wOut[i*N+j]=w[j*M+i];
+	for (unsigned int i=0;i<N;i++)
+		for (unsigned int j=0;j<N;j++)
+			xOut[i*N+j]=x[j*N+i];
+}
+
+//! General SVD
+/*! Decomposes an \f$m\times n\f$ matrix of any size using heap allocated work space. Wide matrices are decomposed through their transpose.
+  \param a row major input
+  \param m number of rows
+  \param n number of columns
+  \param u receives the row major \f$m\times k\f$ left singular vectors
+  \param s receives the \f$k\f$ singular values
+  \param v receives the row major \f$n\times k\f$ right singular vectors */
+static void svdDynamic(const double *a,unsigned int m,unsigned int n,double *u,double *s,double *v)
+{
+	bool trans=m<n;
+	DynamicDims d;
+	d.m=trans?n:m;
+	d.n=trans?m:n;
+	double *w,*x;
+	try
+	{
+		w=new double[d.m*d.n];
+		x=new double[d.n*d.n];
+	}
+	catch (std::bad_alloc &e)
+	{
+		std::cerr<<"Exception: "<<e.what()<<std::endl;
+		abort();
+	}
+	for (unsigned int i=0;i<m;i++)
+		for (unsigned int j=0;j<n;j++)
+		{
+			if (trans)
+				w[i*d.m+j]=a[i*n+j];
+			else
+				w[j*d.m+i]=a[i*n+j];
+		}
+	jacobiSweeps(d,w,x);
+	jacobiFinish(d,w,x,s);
+	double *wOut=trans?v:u,*xOut=trans?u:v;
+	for (unsigned int i=0;i<d.m;i++)
+		for (unsigned int j=0;j<d.n;j++)
+			wOut[i*d.n+j]=w[j*d.m+i];
+	for (unsigned int i=0;i<d.n;i++)
+		for (unsigned int j=0;j<d.n;j++)
+			xOut[i*d.n+j]=x[j*d.n+i];
+	delete[] w;
+	delete[] x;
+}
+
+//! Pseudo-Inverse From An SVD
+/*! Forms \f$A^+=VS^+U^T\f$ from a thin SVD. Singular values at or below \a tol are treated as zero. If \a damping is nonzero the damped least squares inverse \f$V\,\mathrm{diag}(\frac{s_i}{s_i^2+\lambda^2})\,U^T\f$ is formed instead and \a tol is ignored.
+  \param u row major \f$m\times k\f$ left singular vectors
+  \param s the \f$k\f$ singular values
+  \param v row major \f$n\times k\f$ right singular vectors
+  \param m number of rows of \f$A\f$
+  \param n number of columns of \f$A\f$
+  \param tol singular value cutoff; negative selects \f$\max(m,n)s_1\epsilon\f$
+  \param damping the damping factor \f$\lambda\f$
+  \param p receives the row major \f$n\times m\f$ pseudo-inverse
+  \return the numerical rank */
+static unsigned int pseudoInverse(const double *u,const double *s,const double *v,unsigned int m,unsigned int n,double tol,double damping,double *p)
+{
+	unsigned int k=m<n?m:n,rank=0;
+	double inv[SVD_SMALL_MAX];
+	double *scale=(k<=SVD_SMALL_MAX)?inv:new double[k];
+	if (tol<0.0)
+		tol=(m>n?m:n)*s[0]*DBL_EPSILON;
+	for (unsigned int i=0;i<k;i++)
+	{
+		if (s[i]>tol)
+			rank++;
+		if (damping!=0.0)
+			scale[i]=s[i]/(s[i]*s[i]+damping*damping);
+		else
+			scale[i]=(s[i]>tol)?1.0/s[i]:0.0;
+	}
+	for (unsigned int i=0;i<n;i++)
+		for (unsigned int j=0;j<m;j++)
+		{
+			double sum=0.0;
+			for (unsigned int l=0;l<k;l++)
+				sum+=v[i*k+l]*scale[l]*u[j*k+l];
+			p[i*m+j]=sum;
+		}
+	if (scale!=inv)
+		delete[] scale;
+	return rank;
+}
+
+//! Small Matrix SVD
+/*! Computes the thin SVD \f$A=USV^T\f$ of a \f$3\times3\f$, \f$4\times4\f$ or \f$6\times n\f$ (\f$n\le8\f$) matrix without allocating. With \f$k=\min(m,n)\f$, \a u is \f$m\times k\f$, \a s has \f$k\f$ entries in decreasing order and \a v is \f$n\times k\f$. All arrays are row major.
+  \param a the \f$m\times n\f$ matrix
+  \param m number of rows
+  \param n number of columns
+  \param u receives the left singular vectors
+  \param s receives the singular values
+  \param v receives the right singular vectors
+  \return true on success, false if \f$m\times n\f$ is not a supported small size */
+bool svdSmall(const double *a,unsigned int m,unsigned int n,double *u,double *s,double *v)
+{
+	if (m==3&&n==3)
+		svdFixed<3,3>(a,false,u,s,v);
+	else if (m==4&&n==4)
+		svdFixed<4,4>(a,false,u,s,v);
+	else if (m==6)
+	{
+		switch (n)
+		{
+			case 1: svdFixed<6,1>(a,false,u,s,v); break;
+			case 2: svdFixed<6,2>(a,false,u,s,v); break;
+			case 3: svdFixed<6,3>(a,false,u,s,v); break;
+			case 4: svdFixed<6,4>(a,false,u,s,v); break;
+			case 5: svdFixed<6,5>(a,false,u,s,v); break;
+			case 6: svdFixed<6,6>(a,false,u,s,v); break;
+			case 7: svdFixed<7,6>(a,true,u,s,v); break;
+			case 8: svdFixed<8,6>(a,true,u,s,v); break;
+			default: return false;
+		}
+	}
+	else
+		return false;
+	return true;
+}
+
+//! Small Matrix Pseudo-Inverse
+/*! Computes the Moore-Penrose pseudo-inverse of a small matrix without allocating. See svdSmall() for the supported sizes.
+  \param a the row major \f$m\times n\f$ matrix
+  \param m number of rows
+  \param n number of columns
+  \param p receives the row major \f$n\times m\f$ pseudo-inverse
+  \param tol singular value cutoff; negative selects \f$\max(m,n)s_1\epsilon\f$ (default)
+  \param damping if nonzero, the damped least squares inverse is computed instead (default 0)
+  \throw LinAlgException if the size is not supported by svdSmall()
+  \return the numerical rank
+  \sa svdSmall() */
+unsigned int pinvSmall(const double *a,unsigned int m,unsigned int n,double *p,double tol,double damping)
+{
+	double u[SVD_SMALL_MAX*SVD_SMALL_MAX],s[SVD_SMALL_MAX],v[SVD_SMALL_MAX*SVD_SMALL_MAX];
+	if (!svdSmall(a,m,n,u,s,v))
+		throw LinAlgException("Unsupported small matrix dimensions");
+	return pseudoInverse(u,s,v,m,n,tol,damping,p);
+}
+
+//! Small Matrix Condition Number
+/*! Computes the 2-norm condition number \f$\frac{s_1}{s_k}\f$ of a small matrix without allocating. See svdSmall() for the supported sizes.
+  \param a the row major \f$m\times n\f$ matrix
+  \param m number of rows
+  \param n number of columns
+  \throw LinAlgException if the size is not supported by svdSmall()
+  \return the condition number; infinite if the matrix is rank deficient */
+double condSmall(const double *a,unsigned int m,unsigned int n)
+{
+	double u[SVD_SMALL_MAX*SVD_SMALL_MAX],s[SVD_SMALL_MAX],v[SVD_SMALL_MAX*SVD_SMALL_MAX];
+	if (!svdSmall(a,m,n,u,s,v))
+		throw LinAlgException("Unsupported small matrix dimensions");
+	unsigned int k=m<n?m:n;
+	if (s[k-1]==0.0)
+		return HUGE_VAL;
+	return s[0]/s[k-1];
+}
+
+//! Singular Value Decomposition
+/*! Finds the thin SVD \f$A=USV^T\f$ by one sided Jacobi rotations. Small sizes are handed to svdSmall(); everything else uses the blocked general kernel.
+  \throw LinAlgException if the Matrix is empty
+  \return struct SVDecomposition with the results
+  \sa svdSmall()
+  \sa struct SVDecomposition */
+struct SVDecomposition Matrix::SVD()
+{
+	if (m==0||n==0)
+		throw LinAlgException("Empty matrix");
+	unsigned int k=m<n?m:n;
+	double *a=values(false),*u=new double[m*k],*s=new double[k],*v=new double[n*k];
+	if (!svdSmall(a,m,n,u,s,v))
+		svdDynamic(a,m,n,u,s,v);
+	SVDecomposition svd;
+	svd.U=Matrix(m,k);
+	svd.S=Vector(s,k);
+	svd.V=Matrix(n,k);
+	for (unsigned int i=0;i<m;i++)
+		for (unsigned int j=0;j<k;j++)
+			svd.U.matrix[i][j]=u[i*k+j];
+	for (unsigned int i=0;i<n;i++)
+		for (unsigned int j=0;j<k;j++)
+			svd.V.matrix[i][j]=v[i*k+j];
+	double tol=(m>n?m:n)*s[0]*DBL_EPSILON;
+	svd.rank=0;
+	for (unsigned int i=0;i<k;i++)
+		if (s[i]>tol)
+			svd.rank++;
+	delete[] a;
+	delete[] u;
+	delete[] s;
+	delete[] v;
+	return svd;
+}
+
+//! Pseudo-Inverse
+/*! Finds the Moore-Penrose pseudo-inverse \f$A^+=VS^+U^T\f$. With a nonzero \a damping \f$\lambda\f$ this returns the damped least squares inverse \f$A^T(AA^T+\lambda^2I)^{-1}\f$ instead, which stays bounded near singular configurations.
+  \param tol singular value cutoff; negative selects \f$\max(m,n)s_1\epsilon\f$ (default)
+  \param damping the damping factor (default 0)
+  \throw LinAlgException if the Matrix is empty
+  \return the \f$n\times m\f$ pseudo-inverse
+  \sa SVD()
+  \sa pinvSmall() */
+Matrix Matrix::pinv(double tol,double damping)
+{
+	if (m==0||n==0)
+		throw LinAlgException("Empty matrix");
+	unsigned int k=m<n?m:n;
+	double *a=values(false),*u=new double[m*k],*s=new double[k],*v=new double[n*k],*p=new double[n*m];
+	if (!svdSmall(a,m,n,u,s,v))
+		svdDynamic(a,m,n,u,s,v);
+	pseudoInverse(u,s,v,m,n,tol,damping,p);
+	Matrix answer(n,m);
+	for (unsigned int i=0;i<n;i++)
+		for (unsigned int j=0;j<m;j++)
+			answer.matrix[i][j]=p[i*m+j];
+	delete[] a;
+	delete[] u;
+	delete[] s;
+	delete[] v;
+	delete[] p;
+	return answer;
+}
+
+//! Condition Number
+/*! Finds the 2-norm condition number \f$\frac{s_1}{s_k}\f$ from the singular values.
+  \throw LinAlgException if the Matrix is empty
+  \return the condition number; infinite if the Matrix is rank deficient
+  \sa SVD()
+  \sa condSmall() */
+double Matrix::cond()
+{
+	if (m==0||n==0)
+		throw LinAlgException("Empty matrix");
+	unsigned int k=m<n?m:n;
+	double *a=values(false),*u=new double[m*k],*s=new double[k],*v=new double[n*k];
+	if (!svdSmall(a,m,n,u,s,v))
+		svdDynamic(a,m,n,u,s,v);
+	double answer=(s[k-1]==0.0)?HUGE_VAL:s[0]/s[k-1];
+	delete[] a;
+	delete[] u;
+	delete[] s;
+	delete[] v;
+	return answer;
+}
@@ -0,0 +1,229 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "mipmap.h"
+
+/*! \file texbench.cpp
+  \brief Texture Sampling Benchmark
+
+  Standalone program (the \c texture_bench target) that times texture-bound frames with and without mipmapping and prints the results as JSON. It needs no window system: it renders offscreen to an EGL pbuffer, so under Mesa it runs on llvmpipe, where every texel fetch is done by the CPU and sampling cost shows up directly in the frame time. <tt>LIBGL_ALWAYS_SOFTWARE=1</tt> forces llvmpipe on a machine with a GPU driver.
+
+  Each frame covers the viewport with small tiles textured from an atlas like the robot's Cube's: a \f$512\times512\f$ atlas of six \f$128\times128\f$ faces with the layout and gutters of TextureAtlas. Zooming out by a factor \f$z\f$ fits \f$z\times z\f$ texels of a face into every pixel, as when the Cube is \f$z\f$ times smaller on screen than its textures, up to the whole face in a tile. \c linear samples only level 0 with \c GL_LINEAR, as the Cube did before, and \c trilinear samples the mip chain built by mipHalve() with \c GL_LINEAR_MIPMAP_LINEAR.
+
+  Usage: <tt>texture_bench [--width n] [--height n] [--max-zoom n] [--min-time ms]</tt> */
+
+//! Atlas Size
+/*! Width and height of the test atlas in texels, as TextureAtlas lays out six \f$128\times128\f$ faces. */
+#define BENCH_ATLAS 512
+
+//! Face Size
+/*! Width and height of one face in texels. */
+#define BENCH_FACE 128
+
+//! Face Cell
+/*! Width and height of a face's cell in the atlas, including the gutter. */
+#define BENCH_CELL 160
+
+//! Benchmark Options
+/*! Command line settings. */
+struct options
+{
+	int width; /*!< Viewport Width In Pixels */
+	int height; /*!< Viewport Height In Pixels */
+	int maxZoom; /*!< Largest Zoom Out Factor */
+	double minTime; /*!< Minimum Time Per Measurement In Seconds */
+};
+
+//! Build The Test Atlas
+/*! Fills six faces with high contrast noise, the worst case for both shimmering and texel cache misses, and copies them into their cells with clamped gutters.
+  \param levels receives the atlas levels, largest first, down to \f$1\times1\f$
+  \return milliseconds spent building the mip chain */
+static double buildAtlas(std::vector<std::vector<unsigned char> > &levels)
+{
+	levels.assign(1, std::vector<unsigned char>(4 * BENCH_ATLAS * BENCH_ATLAS, 255));
+	unsigned int seed = 1;
+	for (int face=0; face<6; face++)
+	{
+		int x0 = (face % 3) * BENCH_CELL + 16, y0 = (face / 3) * BENCH_CELL + 16;
+		std::vector<unsigned char> texels(4 * BENCH_FACE * BENCH_FACE);
+		for (size_t i=0; i<texels.size(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			texels[i] = (i & 3) == 3 ? 255 : (seed >> 16) & 255;
+		}
+		for (int y=-16; y<BENCH_FACE+16; y++)
+			for (int x=-16; x<BENCH_FACE+16; x++)
+			{
+				int sx = x < 0 ? 0 : (x >= BENCH_FACE ? BENCH_FACE - 1 : x), sy = y < 0 ? 0 : (y >= BENCH_FACE ? BENCH_FACE - 1 : y);
+				memcpy(&levels[0][4 * ((y0 + y) * BENCH_ATLAS + x0 + x)], &texels[4 * (sy * BENCH_FACE + sx)], 4);
+			}
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int k=1, size=BENCH_ATLAS / 2; size>=1; k++, size/=2)
+	{
+		levels.push_back(std::vector<unsigned char>(4 * size * size));
+		mipHalve(&levels[k-1][0], 2 * size, 2 * size, 8 * size, &levels[k][0], 4 * size);
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//! Upload The Test Atlas
+/*! \param levels the atlas levels
+  \param mipmapped whether to upload the whole chain and sample it trilinearly, or only level 0 with \c GL_LINEAR
+  \return the texture object */
+static GLuint upload(const std::vector<std::vector<unsigned char> > &levels, bool mipmapped)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	unsigned int count = mipmapped ? levels.size() : 1;
+	for (unsigned int k=0; k<count; k++)
+		glTexImage2D(GL_TEXTURE_2D, k, GL_RGB, BENCH_ATLAS >> k, BENCH_ATLAS >> k, 0, GL_RGBA, GL_UNSIGNED_BYTE, &levels[k][0]);
+	return texture;
+}
+
+//! Tile Size
+/*! Width and height of one tile on screen in pixels. */
+#define BENCH_TILE 16
+
+//! Draw A Frame
+/*! Covers the viewport with tiles of BENCH_TILE pixels, each showing a window of \f$zoom\cdot16\f$ texels of one face of the test atlas, then waits for the frame to finish. The number of vertices is the same at every zoom level, so only the cost of sampling changes.
+  \param opts the viewport size
+  \param zoom the zoom out factor */
+static void drawFrame(const options &opts, int zoom)
+{
+	GLdouble window = (GLdouble)BENCH_TILE * zoom / BENCH_ATLAS;
+	int face = 0;
+	glClear(GL_COLOR_BUFFER_BIT);
+	glBegin(GL_QUADS);
+	for (int y=0; y<opts.height; y+=BENCH_TILE)
+		for (int x=0; x<opts.width; x+=BENCH_TILE, face=(face+1)%6)
+		{
+			GLdouble s0 = (GLdouble)((face % 3) * BENCH_CELL + 16) / BENCH_ATLAS, t0 = (GLdouble)((face / 3) * BENCH_CELL + 16) / BENCH_ATLAS;
+			glTexCoord2d(s0, t0);
+			glVertex2i(x, y);
+			glTexCoord2d(s0 + window, t0);
+			glVertex2i(x + BENCH_TILE, y);
+			glTexCoord2d(s0 + window, t0 + window);
+			glVertex2i(x + BENCH_TILE, y + BENCH_TILE);
+			glTexCoord2d(s0, t0 + window);
+			glVertex2i(x, y + BENCH_TILE);
+		}
+	glEnd();
+	glFinish();
+}
+
+//! Time One Configuration
+/*! Draws frames until at least the minimum time has passed and prints the mean frame time.
+  \param opts the command line options
+  \param mode the name of the filtering mode
+  \param texture the texture to sample
+  \param zoom the zoom out factor
+  \param first whether this is the first result printed */
+static void measure(const options &opts, const char *mode, GLuint texture, int zoom, bool first)
+{
+	typedef std::chrono::steady_clock clock;
+	unsigned long frames = 1;
+	double elapsed = 0.0;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	drawFrame(opts, zoom);
+	for (;;)
+	{
+		clock::time_point start = clock::now();
+		for (unsigned long i=0; i<frames; i++)
+			drawFrame(opts, zoom);
+		elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		if (elapsed >= opts.minTime)
+			break;
+		frames *= 2;
+	}
+	printf("%s\n    {\"filter\": \"%s\", \"zoom\": %d, \"frames\": %lu, \"ms_per_frame\": %.3f}",
+		first ? "" : ",", mode, zoom, frames, elapsed * 1e3 / frames);
+	fflush(stdout);
+}
+
+//! Create An Offscreen Context
+/*! Makes a compatibility profile OpenGL context current on a pbuffer of the viewport size, on a surfaceless display when Mesa offers one.
+  \param opts the viewport size
+  \return false if no context could be created */
+static bool createContext(const options &opts)
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC platformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (platformDisplay)
+		display = platformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+		return false;
+	const EGLint attributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE};
+	const EGLint size[] = {EGL_WIDTH, opts.width, EGL_HEIGHT, opts.height, EGL_NONE};
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglChooseConfig(display, attributes, &config, 1, &configs) || !configs)
+		return false;
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+	EGLSurface surface = eglCreatePbufferSurface(display, config, size);
+	return context != EGL_NO_CONTEXT && surface != EGL_NO_SURFACE && eglMakeCurrent(display, surface, surface, context);
+}
+
+int main(int argc, char **argv)
+{
+	options opts;
+	opts.width = 1024;
+	opts.height = 768;
+	opts.maxZoom = BENCH_FACE / BENCH_TILE;
+	opts.minTime = 0.5;
+	for (int i=1; i<argc; i++)
+	{
+		if (!strcmp(argv[i], "--width") && i + 1 < argc)
+			opts.width = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--height") && i + 1 < argc)
+			opts.height = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--max-zoom") && i + 1 < argc)
+			opts.maxZoom = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+			opts.minTime = atof(argv[++i]) / 1000.0;
+		else
+		{
+			fprintf(stderr, "usage: %s [--width n] [--height n] [--max-zoom n] [--min-time ms]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (opts.maxZoom > BENCH_FACE / BENCH_TILE)
+		opts.maxZoom = BENCH_FACE / BENCH_TILE;
+	if (opts.width < 1 || opts.height < 1 || !createContext(opts))
+	{
+		fprintf(stderr, "%s: can't create an offscreen OpenGL context\n", argv[0]);
+		return 1;
+	}
+	glViewport(0, 0, opts.width, opts.height);
+	glMatrixMode(GL_PROJECTION);
+	glOrtho(0, opts.width, 0, opts.height, -1, 1);
+	glEnable(GL_TEXTURE_2D);
+	std::vector<std::vector<unsigned char> > levels;
+	double mipTime = buildAtlas(levels);
+	GLuint linear = upload(levels, false), trilinear = upload(levels, true);
+	printf("{\n  \"benchmark\": \"texture\",\n  \"renderer\": \"%s\",\n  \"viewport\": [%d, %d],\n  \"mip_chain_ms\": %.3f,\n  \"results\": [",
+		(const char *)glGetString(GL_RENDERER), opts.width, opts.height, mipTime);
+	bool first = true;
+	for (int zoom=1; zoom<=opts.maxZoom; zoom*=2)
+	{
+		measure(opts, "linear", linear, zoom, first);
+		measure(opts, "trilinear", trilinear, zoom, false);
+		first = false;
+	}
+	printf("\n  ]\n}\n");
+	glDeleteTextures(1, &linear);
+	glDeleteTextures(1, &trilinear);
+	return 0;
+}
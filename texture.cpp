@@ -0,0 +1,199 @@
+#include <cstring>
+#include <vector>
+#include "robot.h"
+#include "mipmap.h"
+
+/*! \file texture.cpp
+  \brief Texture Atlas
+
+  Implements TextureAtlas, which packs the images of a multi-face object such as the Cube into one texture, and the mip chains that TextureCache stores.
+
+  The atlas is mipmapped and sampled trilinearly, so a Cube far from the camera reads a small level instead of every texel of the full size one. Its levels are the images' own mip chains, built once on the CPU, rather than \c glGenerateMipmap(), which would blur neighbouring faces into each other. The gutter around every image is halved at each level, and the chain stops at ATLAS_LEVELS so that the gutter is still a texel wide at the smallest level. */
+
+//! Atlas Gutter
+/*! Number of texels of edge copies around every image in level 0 of a TextureAtlas. A power of two, so that it halves exactly down to the last level. */
+#define ATLAS_PADDING 16
+
+//! Atlas Levels
+/*! Number of mip levels in a TextureAtlas: \f$\log_2\f$ of ATLAS_PADDING, plus one. */
+#define ATLAS_LEVELS 5
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+/* OpenGL 1.2; missing from the Windows headers */
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+//! Round Up To A Power Of Two
+/*! Textures are kept at power of two sizes for OpenGL implementations older than 2.0.
+  \param n a positive number
+  \return the smallest power of two that is at least \a n */
+static GLsizei powerOfTwo(unsigned int n)
+{
+	GLsizei p = 1;
+	while ((unsigned int)p < n)
+		p *= 2;
+	return p;
+}
+
+//! TextureAtlas Constructor
+/*! Creates an empty atlas. Nothing is allocated on the GPU until load() is called. */
+TextureAtlas::TextureAtlas()
+{
+	texture = 0;
+	images = 0;
+	rects = NULL;
+	width = height = 1;
+	columns = 1;
+	cellWidth = cellHeight = 2 * ATLAS_PADDING;
+}
+
+//! TextureAtlas Destructor
+/*! Frees the texture on the GPU. The GL context it was created in must be current. */
+TextureAtlas::~TextureAtlas()
+{
+	if (texture)
+		GLState::deleteTexture(texture);
+	delete[] rects;
+}
+
+//! Bind Method
+/*! Binds the atlas to \c GL_TEXTURE_2D. */
+void TextureAtlas::bind()
+{
+	GLState::bindTexture(GL_TEXTURE_2D, texture);
+}
+
+//! Reserve Method
+/*! Lays out a grid of \a count cells of \f$width\times height\f$ texels, as close to square as possible, and uploads every level of it filled with a white placeholder, which shows as the plain material color. Cells are rounded up to a multiple of ATLAS_PADDING so that they line up at every level. The images can then be filled in one at a time with update() as they become available. The GL context must be current. Calling it again replaces the contents of the same texture object.
+  \param count the number of images
+  \param w the width of the largest image
+  \param h the height of the largest image */
+void TextureAtlas::reserve(unsigned int count, int w, int h)
+{
+	unsigned int rows;
+	cellWidth = (w + 3 * ATLAS_PADDING - 1) / ATLAS_PADDING * ATLAS_PADDING;
+	cellHeight = (h + 3 * ATLAS_PADDING - 1) / ATLAS_PADDING * ATLAS_PADDING;
+	columns = 1;
+	while (columns * columns < count)
+		columns++;
+	rows = (count + columns - 1) / columns;
+	width = powerOfTwo(columns * cellWidth);
+	height = powerOfTwo(rows * cellHeight);
+
+	delete[] rects;
+	images = count;
+	rects = new GLdouble[4 * count];
+	for (unsigned int i=0; i<count; i++)
+	{
+		int x0 = (i % columns) * cellWidth + ATLAS_PADDING, y0 = (i / columns) * cellHeight + ATLAS_PADDING;
+		rects[4*i] = (GLdouble)x0 / width;
+		rects[4*i+1] = (GLdouble)y0 / height;
+		rects[4*i+2] = (GLdouble)(x0 + w) / width;
+		rects[4*i+3] = (GLdouble)(y0 + h) / height;
+	}
+	std::vector<unsigned char> texels((size_t)width * height * 4, 255);
+	if (!texture)
+		glGenTextures(1, &texture);
+	GLState::bindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ATLAS_LEVELS - 1);
+	for (int k=0; k<ATLAS_LEVELS; k++)
+		glTexImage2D(GL_TEXTURE_2D, k, GL_RGB, width >> k, height >> k, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+	RENDER_COUNT(RENDER_TEXTURE_UPLOADS, ATLAS_LEVELS);
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
+}
+
+//! Update Method
+/*! Uploads one image into its cell of a reserved atlas with \c glTexSubImage2D, leaving the other cells alone. Level \f$k\f$ of the atlas gets level \f$k\f$ of \a chain. An image larger than the cells is scaled down to fit, and a chain that is too short, such as a lone image, is completed with mipChain() first. The GL context must be current.
+  \param image the index of the image
+  \param chain the mip chain of the image, largest level first
+  \return false if \a image is out of range or \a chain is empty */
+bool TextureAtlas::update(unsigned int image, std::vector<QImage> &chain)
+{
+	if (image >= images || chain.empty() || chain[0].isNull())
+		return false;
+	std::vector<QImage> scaled;
+	const std::vector<QImage> *levels = &chain;
+	int w = chain[0].width(), h = chain[0].height();
+	int cw = cellWidth - 2 * ATLAS_PADDING, ch = cellHeight - 2 * ATLAS_PADDING;
+	if (w > cw || h > ch)
+	{
+		scaled.push_back(chain[0].scaled(w > cw ? cw : w, h > ch ? ch : h));
+		w = scaled[0].width();
+		h = scaled[0].height();
+	}
+	else if (chain.size() < ATLAS_LEVELS && (chain.back().width() > 1 || chain.back().height() > 1))
+		scaled.push_back(chain[0]);
+	if (!scaled.empty())
+	{
+		mipChain(scaled);
+		levels = &scaled;
+	}
+	int x0 = (image % columns) * cellWidth + ATLAS_PADDING, y0 = (image / columns) * cellHeight + ATLAS_PADDING;
+	rects[4*image+2] = (GLdouble)(x0 + w) / width;
+	rects[4*image+3] = (GLdouble)(y0 + h) / height;
+
+	GLState::bindTexture(GL_TEXTURE_2D, texture);
+	std::vector<unsigned char> texels;
+	for (int k=0; k<ATLAS_LEVELS; k++)
+	{
+		/* copy the level and clamp its edges out into the gutter, which halves with it */
+		const QImage &level = (*levels)[(unsigned int)k < levels->size() ? k : levels->size() - 1];
+		int lw = level.width(), lh = level.height(), padding = ATLAS_PADDING >> k;
+		int pw = lw + 2 * padding, ph = lh + 2 * padding;
+		texels.resize((size_t)pw * ph * 4);
+		for (int y=0; y<ph; y++)
+		{
+			int sy = y - padding;
+			const unsigned char *source = level.constScanLine(sy < 0 ? 0 : (sy >= lh ? lh - 1 : sy));
+			unsigned char *target = &texels[4 * (size_t)y * pw];
+			for (int x=0; x<pw; x++)
+			{
+				int sx = x - padding;
+				memcpy(target + 4 * x, source + 4 * (sx < 0 ? 0 : (sx >= lw ? lw - 1 : sx)), 4);
+			}
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, k, ((x0 - ATLAS_PADDING) >> k), ((y0 - ATLAS_PADDING) >> k), pw, ph, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+	}
+	RENDER_COUNT(RENDER_TEXTURE_UPLOADS, ATLAS_LEVELS);
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+//! Map Method
+/*! Maps texture coordinates within one image to coordinates within the atlas.
+  \param image the index of the image
+  \param s the \f$s\f$ coordinate within the image, from 0 to 1
+  \param t the \f$t\f$ coordinate within the image, from 0 to 1
+  \param st array of 2 receiving the atlas coordinates */
+void TextureAtlas::map(unsigned int image, GLdouble s, GLdouble t, GLdouble *st)
+{
+	if (image >= images)
+	{
+		/* nothing loaded yet */
+		st[0] = s;
+		st[1] = t;
+		return;
+	}
+	const GLdouble *rect = rects + 4 * image;
+	st[0] = rect[0] + s * (rect[2] - rect[0]);
+	st[1] = rect[1] + t * (rect[3] - rect[1]);
+}
+
+//! Build A Mip Chain
+/*! Appends successively halved levels to \a levels until a level is \f$1\times1\f$, each made from the one above it by mipHalve().
+  \param levels a chain whose first element is the full size image in OpenGL format; anything after it is replaced */
+void mipChain(std::vector<QImage> &levels)
+{
+	if (levels.empty() || levels[0].isNull())
+		return;
+	levels.resize(1);
+	while (levels.back().width() > 1 || levels.back().height() > 1)
+	{
+		const QImage &above = levels.back();
+		QImage level(mipExtent(above.width(), 1), mipExtent(above.height(), 1), QImage::Format_RGBA8888);
+		mipHalve(above.constScanLine(0), above.width(), above.height(), above.bytesPerLine(), level.scanLine(0), level.bytesPerLine());
+		levels.push_back(level);
+	}
+}
@@ -0,0 +1,9 @@
+# texture sampling benchmark: qmake texture_bench.pro && make
+# renders offscreen through EGL, so it builds on Linux only; prints ms per frame as JSON on stdout
+SOURCES = texbench.cpp \
+	  mipmap.cpp
+HEADERS = mipmap.h
+TARGET = texture_bench
+CONFIG += console release warn_on c++14
+CONFIG -= qt app_bundle
+LIBS += -lEGL -lGL
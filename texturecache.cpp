@@ -0,0 +1,171 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGLWidget>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+#include "robot.h"
+
+/*! \file texturecache.cpp
+  \brief On-Disk Texture Cache
+
+  Implements TextureCache. A cache entry is one file holding a textureHeader followed by every level of the mip chain, largest first, as tightly packed RGBA bytes in the order \c glTexImage2D takes them. Entries are named after a hash of the source's absolute path and carry the source's size and modification time, so an edited texture is decoded again on the next start. */
+
+//! Cache Format Version
+/*! Bumped whenever the layout of an entry changes, which invalidates every existing entry. */
+#define TEXTURE_CACHE_VERSION 1
+
+//! Cache Entry Header
+/*! The fixed size start of a cache entry. All fields are in host byte order; the cache is not meant to be shared between machines. */
+struct textureHeader
+{
+	char magic[4]; /*!< Always "RTEX" */
+	quint32 version; /*!< TEXTURE_CACHE_VERSION */
+	qint64 modified; /*!< Source Modification Time In Milliseconds Since The Epoch */
+	qint64 size; /*!< Source Size In Bytes */
+	quint32 width; /*!< Width Of Level 0 */
+	quint32 height; /*!< Height Of Level 0 */
+	quint32 levels; /*!< Number Of Levels In The Mip Chain */
+	quint32 reserved; /*!< Zero; Keeps The Level Data 8 Byte Aligned */
+};
+
+//! Level Size
+/*! \param extent the width or height of level 0
+  \param level the level
+  \return the width or height of \a level */
+static quint32 levelExtent(quint32 extent, quint32 level)
+{
+	extent >>= level;
+	return extent ? extent : 1;
+}
+
+//! TextureCache Constructor
+/*! Opens the cache in \a directory, creating it if needed.
+  \param directory the cache directory; by default a \c textures directory under the platform's cache location */
+TextureCache::TextureCache(const QString &directory)
+{
+	path = directory;
+	if (path.isEmpty())
+		path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/textures";
+	QDir().mkpath(path);
+}
+
+//! TextureCache Destructor
+/*! Unmaps every entry. QImages returned by load() that wrap an entry must be destroyed first. */
+TextureCache::~TextureCache()
+{
+	for (unsigned int i=0; i<mapped.size(); i++)
+		delete mapped[i];
+}
+
+//! Load Method
+/*! Fills \a levels with the mip chain of the image in \a source. If the cache holds a current entry for \a source, the levels wrap the memory mapped entry and nothing is decoded or copied. Otherwise the image is decoded, converted with QGLWidget::convertToGLFormat(), given a mip chain by mipChain() and written to the cache for next time.
+  \param source the image file
+  \param levels receives the mip chain, largest level first
+  \param cached set to true if the levels came from the cache. The caller counts the hit or miss, since RenderStats may only be touched from the GUI thread.
+  \return false if \a source can't be read */
+bool TextureCache::load(const QString &source, std::vector<QImage> &levels, bool &cached)
+{
+	QFileInfo info(source);
+	levels.clear();
+	cached = false;
+	if (!info.exists())
+		return false;
+	QString entry = entryName(info.absoluteFilePath());
+	if (map(entry, info, levels))
+	{
+		cached = true;
+		return true;
+	}
+	QImage buffer;
+	if (!buffer.load(source))
+		return false;
+	levels.push_back(QGLWidget::convertToGLFormat(buffer));
+	mipChain(levels);
+	store(entry, info, levels);
+	return true;
+}
+
+//! Entry Name
+/*! Names the entry for a source by the 64 bit FNV-1a hash of its absolute path.
+  \param source the absolute path of the source
+  \return the path of the entry */
+QString TextureCache::entryName(const QString &source)
+{
+	QByteArray bytes = source.toUtf8();
+	quint64 hash = 14695981039346656037ULL;
+	for (int i=0; i<bytes.size(); i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return path + "/" + QString::number(hash, 16) + ".rtex";
+}
+
+//! Map Method
+/*! Maps an entry and wraps its levels in QImages if it is current for \a source.
+  \param entry the path of the entry
+  \param source the source it must match
+  \param levels receives the mip chain
+  \return false if the entry is missing, stale or damaged */
+bool TextureCache::map(const QString &entry, const QFileInfo &source, std::vector<QImage> &levels)
+{
+	QFile *file = new QFile(entry);
+	if (!file->open(QIODevice::ReadOnly) || file->size() < (qint64)sizeof(textureHeader))
+	{
+		delete file;
+		return false;
+	}
+	const uchar *data = file->map(0, file->size());
+	const textureHeader *header = (const textureHeader *)data;
+	if (!data || memcmp(header->magic, "RTEX", 4) || header->version != TEXTURE_CACHE_VERSION || !header->levels
+	    || header->modified != source.lastModified().toMSecsSinceEpoch() || header->size != source.size())
+	{
+		delete file;
+		return false;
+	}
+	qint64 offset = sizeof(textureHeader);
+	for (quint32 i=0; i<header->levels; i++)
+	{
+		quint32 w = levelExtent(header->width, i), h = levelExtent(header->height, i);
+		if (offset + 4 * (qint64)w * h > file->size())
+		{
+			levels.clear();
+			delete file;
+			return false;
+		}
+		levels.push_back(QImage(data + offset, w, h, 4 * w, QImage::Format_RGBA8888));
+		offset += 4 * (qint64)w * h;
+	}
+	lock.lock();
+	mapped.push_back(file);
+	lock.unlock();
+	return true;
+}
+
+//! Store Method
+/*! Writes a new entry. Failing to write is not an error; the texture is simply decoded again next time.
+  \param entry the path of the entry
+  \param source the source the entry is for
+  \param levels the mip chain to store */
+void TextureCache::store(const QString &entry, const QFileInfo &source, std::vector<QImage> &levels)
+{
+	textureHeader header;
+	memcpy(header.magic, "RTEX", 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.modified = source.lastModified().toMSecsSinceEpoch();
+	header.size = source.size();
+	header.width = levels[0].width();
+	header.height = levels[0].height();
+	header.levels = levels.size();
+	header.reserved = 0;
+	QSaveFile file(entry);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	file.write((const char *)&header, sizeof(header));
+	for (unsigned int i=0; i<levels.size(); i++)
+		for (int y=0; y<levels[i].height(); y++)
+			file.write((const char *)levels[i].constScanLine(y), 4 * levels[i].width());
+	file.commit();
+}
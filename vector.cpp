@@ -3,6 +3,64 @@
 #include <cstdlib>
 
 #include "linalg.h"
+#include "parallel.h"
+#include "simd.h"
+
+//! Large Dot Product
+/*! Dot product of arrays of any size. Beyond one chunk the partial sums are computed in parallel and added in a fixed order, so the result doesn't depend on the thread count.
+  \param a the first array
+  \param b the second array
+  \param n the dimension
+  \return \f$\sum a_ib_i\f$ */
+static double dotLarge(const double *a,const double *b,unsigned int n)
+{
+	return LinAlgThreads::sum(n,[a,b](unsigned long begin,unsigned long end)
+	{
+		return simdDot(a+begin,b+begin,end-begin);
+	});
+}
+
+//! Scale In Parallel
+/*! Scales an array in place, in parallel when it is large.
+  \param a the array
+  \param k the scalar
+  \param n the number of elements */
+static void scaleLarge(double *a,double k,unsigned int n)
+{
+	LinAlgThreads::run(n,[a,k](unsigned long begin,unsigned long end)
+	{
+		simdScale(a+begin,k,end-begin);
+	});
+}
+
+//! AXPY In Parallel
+/*! Computes \f$y\leftarrow kx+y\f$, in parallel when the arrays are large.
+  \param k the scalar
+  \param x the array to add
+  \param y the array to accumulate into
+  \param n the number of elements */
+static void axpyLarge(double k,const double *x,double *y,unsigned int n)
+{
+	LinAlgThreads::run(n,[k,x,y](unsigned long begin,unsigned long end)
+	{
+		simdAxpy(k,x+begin,y+begin,end-begin);
+	});
+}
+
+//! Small Dot Product
+/*! Dot product unrolled for \f$\Re^3\f$ and \f$\Re^4\f$, where calling a kernel costs more than the arithmetic; larger dimensions go to dotLarge().
+  \param a the first array
+  \param b the second array
+  \param n the dimension
+  \return \f$\sum a_ib_i\f$ */
+static inline double dotSmall(const double *a,const double *b,unsigned int n)
+{
+	if (n==3)
+		return a[0]*b[0]+a[1]*b[1]+a[2]*b[2];
+	if (n==4)
+		return (a[0]*b[0]+a[1]*b[1])+(a[2]*b[2]+a[3]*b[3]);
+	return dotLarge(a,b,n);
+}
 
 //! Scalar Multiplication Operator
 /*! Friend function that implements \f$k\overrightarrow v\f$.
@@ -12,8 +70,13 @@
 Vector operator*(double k,Vector &v)
 {
 	Vector answer(v.n);
-	for (unsigned int i=0;i<v.n;i++)
-		answer.vector[i]=k*v.vector[i];
+	double *a=answer.vector,*b=v.vector;
+	LinAlgThreads::run(v.n,[a,b,k](unsigned long begin,unsigned long end)
+	{
+		for (unsigned long i=begin;i<end;i++)
+			a[i]=k*b[i];
+	});
+	LINALG_FLOPS(OP_SCALE,v.n);
 	return answer;
 }
 
@@ -38,8 +101,13 @@ Vector operator/(Vector &v,double k)
 	if (fabs(k)<DBL_EPSILON)
 		throw LinAlgException("Divide by zero");
 	Vector answer(v.n);
-	for (unsigned int i=0;i<v.n;i++)
-		answer.vector[i]=v.vector[i]/k;
+	double *a=answer.vector,*b=v.vector;
+	LinAlgThreads::run(v.n,[a,b,k](unsigned long begin,unsigned long end)
+	{
+		for (unsigned long i=begin;i<end;i++)
+			a[i]=b[i]/k;
+	});
+	LINALG_FLOPS(OP_SCALE,v.n);
 	return answer;
 }
 
@@ -80,6 +148,8 @@ Vector::Vector()
 {
 	vector=0;
 	n=0;
+	wrapped=false;
+	LINALG_CONSTRUCT();
 }
 
 //! Copy Constructor
@@ -87,18 +157,11 @@ Vector::Vector()
   \param other the source Vector. */
 Vector::Vector(const Vector &other)
 {
-	try
-	{
-		vector=new double[other.n];
-		for (unsigned int i=0;i<other.n;i++)
-			vector[i]=other.vector[i];
-	}
-	catch (std::bad_alloc &e)
-	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
-	}
-	n=other.n;
+	allocate(other.n);
+	for (unsigned int i=0;i<n;i++)
+		vector[i]=other.vector[i];
+	LINALG_CONSTRUCT();
+	LINALG_COPY();
 }
 
 //! Sized Constructor
@@ -106,64 +169,60 @@ Vector::Vector(const Vector &other)
   \param a the dimension of the Vector */
 Vector::Vector(unsigned int a)
 {
-	try
-	{
-		vector=new double[a];
-		for (unsigned int i=0;i<a;i++)
-			vector[i]=0.0;
-	}
-	catch (std::bad_alloc &e)
-	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
-	}
-	n=a;
+	allocate(a);
+	for (unsigned int i=0;i<a;i++)
+		vector[i]=0.0;
+	LINALG_CONSTRUCT();
 }
 
 //! Sized Constructor With Data
 /*! Creates a Vector in \f$\Re^a\f$ populated with data from \a values.
   \param values array of Vector values
-  \param a the number of members in \a values */
-Vector::Vector(double *values,unsigned int a)
+  \param a the number of members in \a values
+  \param wrap if false, \a values is copied (default); if true, the Vector operates on \a values in place */
+Vector::Vector(double *values,unsigned int a,bool wrap)
 {
-	try
+	if (wrap)
 	{
-		vector=new double[a];
-		for (unsigned int i=0;i<a;i++)
-			vector[i]=values[i];
+		vector=values;
+		n=a;
+		wrapped=true;
 	}
-	catch (std::bad_alloc &e)
+	else
 	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
+		allocate(a);
+		for (unsigned int i=0;i<a;i++)
+			vector[i]=values[i];
 	}
-	n=a;
+	LINALG_CONSTRUCT();
 }
 
 //! std::vector Constructor
 /*! Creates a Vector populated with data from the std::vector \a values.
-  \param values the std::vector<double> with the data */
-Vector::Vector(std::vector<double> &values)
+  \param values the std::vector<double> with the data
+  \param wrap if false, \a values is copied (default); if true, the Vector operates on the data of \a values in place, which must then not be resized */
+Vector::Vector(std::vector<double> &values,bool wrap)
 {
-	try
+	if (wrap)
 	{
-		vector=new double[values.size()];
-		for (unsigned int i=0;i<values.size();i++)
-			vector[i]=values[i];
+		vector=values.empty()?0:&values[0];
+		n=values.size();
+		wrapped=true;
 	}
-	catch (std::bad_alloc &e)
+	else
 	{
-		std::cerr<<"Exception: "<<e.what()<<std::endl;
-		abort();
+		allocate(values.size());
+		for (unsigned int i=0;i<n;i++)
+			vector[i]=values[i];
 	}
-	n=values.size();
+	LINALG_CONSTRUCT();
 }
 
 //! Destructor
 /*! Deallocates allocated memory */
 Vector::~Vector()
 {
-	delete vector;
+	release();
 }
 
 //! Assignment Operator
@@ -172,21 +231,52 @@ Vector::~Vector()
   \return reference to the new Vector */
 Vector &Vector::operator=(const Vector &other)
 {
-	if (vector)
-		delete vector;
+	if (this==&other)
+		return *this;
+	/* reuse the storage when the dimensions already match */
+	if (!vector||n!=other.n)
+	{
+		release();
+		allocate(other.n);
+	}
+	for (unsigned int i=0;i<n;i++)
+		vector[i]=other.vector[i];
+	LINALG_COPY();
+	return *this;
+}
+
+//! Storage Allocator
+/*! Allocates uninitialized storage for a Vector in \f$\Re^a\f$ and sets the dimension. All Vector storage goes through here so it can be accounted for by LinAlgStats.
+  \param a the dimension of the Vector */
+void Vector::allocate(unsigned int a)
+{
 	try
 	{
-		vector=new double[other.n];
-		for (unsigned int i=0;i<other.n;i++)
-			vector[i]=other.vector[i];
+		vector=new double[a];
 	}
 	catch (std::bad_alloc &e)
 	{
 		std::cerr<<"Exception: "<<e.what()<<std::endl;
 		abort();
 	}
-	n=other.n;
-	return *this;
+	n=a;
+	wrapped=false;
+	LINALG_ALLOC((size_t)a*sizeof(double));
+}
+
+//! Storage Deallocator
+/*! Frees the storage obtained by allocate() and leaves an empty Vector. A wrapped array is only let go of.
+  \sa wraps() */
+void Vector::release()
+{
+	if (vector&&!wrapped)
+	{
+		delete[] vector;
+		LINALG_FREE((size_t)n*sizeof(double));
+	}
+	vector=0;
+	n=0;
+	wrapped=false;
 }
 
 //! Addition Operator
@@ -199,8 +289,13 @@ Vector Vector::operator+(Vector &other)
 	if (n!=other.n)
 		throw LinAlgException("Incompatible Dimensions");
 	Vector answer(n);
-	for (unsigned int i=0;i<n;i++)
-		answer.vector[i]=vector[i]+other.vector[i];
+	double *a=answer.vector,*b=vector,*c=other.vector;
+	LinAlgThreads::run(n,[a,b,c](unsigned long begin,unsigned long end)
+	{
+		for (unsigned long i=begin;i<end;i++)
+			a[i]=b[i]+c[i];
+	});
+	LINALG_FLOPS(OP_ADD,n);
 	return answer;
 }
 
@@ -214,8 +309,13 @@ Vector Vector::operator-(Vector &other)
 	if (n!=other.n)
 		throw LinAlgException("Incompatible Dimensions");
 	Vector answer(n);
-	for (unsigned int i=0;i<n;i++)
-		answer.vector[i]=vector[i]-other.vector[i];
+	double *a=answer.vector,*b=vector,*c=other.vector;
+	LinAlgThreads::run(n,[a,b,c](unsigned long begin,unsigned long end)
+	{
+		for (unsigned long i=begin;i<end;i++)
+			a[i]=b[i]-c[i];
+	});
+	LINALG_FLOPS(OP_SUBTRACT,n);
 	return answer;
 }
 
@@ -228,10 +328,8 @@ double Vector::operator*(Vector &other)
 {
 	if (n!=other.n)
 		throw LinAlgException("Incompatible Dimensions");
-	double answer=0.0;
-	for (unsigned int i=0;i<n;i++)
-		answer+=vector[i]*other.vector[i];
-	return answer;
+	LINALG_FLOPS(OP_DOT,2ul*n);
+	return dotSmall(vector,other.vector,n);
 }
 
 //! Cross Product Operator
@@ -244,64 +342,102 @@ Vector Vector::operator%(Vector &other)
 	if (n!=3||other.n!=3)
 		throw LinAlgException("Cross product is only defined in 3 space");
 	Vector answer(3);
-	answer.vector[0]=vector[1]*other.vector[2]-vector[2]*other.vector[1];
-	answer.vector[1]=vector[2]*other.vector[0]-vector[0]*other.vector[2];
-	answer.vector[2]=vector[0]*other.vector[1]-vector[1]*other.vector[0];
+	simdCross(vector,other.vector,answer.vector);
+	LINALG_FLOPS(OP_CROSS,9);
 	return answer;
 }
 
+//! Cross Product
+/*! Takes the cross product of two Vectors in \f$\Re^3\f$ without allocating. Unlike operator%() the result goes into \a answer, which may be either operand.
+  \param other the second operand of the cross product
+  \param answer a Vector in \f$\Re^3\f$ to store the result in
+  \throw LinAlgException if the Vectors aren't all in \f$\Re^3\f$. */
+void Vector::cross(Vector &other,Vector &answer)
+{
+	if (n!=3||other.n!=3||answer.n!=3)
+		throw LinAlgException("Cross product is only defined in 3 space");
+	simdCross(vector,other.vector,answer.vector);
+	LINALG_FLOPS(OP_CROSS,9);
+}
+
+//! Scaled Accumulation
+/*! Implements \f$\overrightarrow v\leftarrow\overrightarrow v+k\overrightarrow x\f$ in place.
+  \param k the scalar
+  \param x the Vector to add
+  \throw LinAlgException if the dimensions don't match */
+void Vector::axpy(double k,Vector &x)
+{
+	if (n!=x.n)
+		throw LinAlgException("Incompatible Dimensions");
+	axpyLarge(k,x.vector,vector,n);
+	LINALG_FLOPS(OP_ADD,2ul*n);
+}
+
 //! Accumulation Operator
-/*! This is a wrapper function for operator+()
+/*! Adds \a other in place.
   \param other the Vector to add
+  \throw LinAlgException if the dimensions don't match
   \sa operator+()
   \return the resulting Vector */
 Vector Vector::operator+=(Vector &other)
 {
-	*this=this->operator+(other);
+	if (n!=other.n)
+		throw LinAlgException("Incompatible Dimensions");
+	axpyLarge(1.0,other.vector,vector,n);
+	LINALG_FLOPS(OP_ADD,n);
 	return *this;
 }
 
 //! Decumulation Operator
-/*! This is a wrapper function for operator-()
+/*! Subtracts \a other in place.
   \param other the Vector to subtract (the subtrahend)
+  \throw LinAlgException if the dimensions don't match
   \sa operator-()
   \return the resulting Vector */
 Vector Vector::operator-=(Vector &other)
 {
-	*this=this->operator-(other);
+	if (n!=other.n)
+		throw LinAlgException("Incompatible Dimensions");
+	axpyLarge(-1.0,other.vector,vector,n);
+	LINALG_FLOPS(OP_SUBTRACT,n);
 	return *this;
 }
 
 //! Scalar Multiplication Operator
-/*! This is a wrapper function for operator*()
+/*! Scales the Vector in place.
   \param k the scalar to multiply by
   \sa operator*()
   \return the resulting Vector */
 Vector Vector::operator*=(double k)
 {
-	*this=::operator*(*this,k);
+	scaleLarge(vector,k,n);
+	LINALG_FLOPS(OP_SCALE,n);
 	return *this;
 }
 
-//! Scalar Multiplication Operator
-/*! This is a wrapper function for operator/()
-  \param k the scalar to multiply by
+//! Scalar Division Operator
+/*! Divides the Vector in place.
+  \param k the scalar to divide by
+  \throw LinAlgException if \f$k=0\f$.
   \sa operator/()
   \return the resulting Vector */
 Vector Vector::operator/=(double k)
 {
-	*this=operator/(*this,k);
+	if (fabs(k)<DBL_EPSILON)
+		throw LinAlgException("Divide by zero");
+	scaleLarge(vector,1.0/k,n);
+	LINALG_FLOPS(OP_SCALE,n);
 	return *this;
 }
 
 //! Cross Product Operator
-/*! This is a wrapper function for operator%()
+/*! Replaces the Vector with its cross product with \a other without allocating.
   \param other the second operator of the cross product
-  \sa operator%()
+  \sa operator%(), cross()
   \return the resulting Vector */
 Vector Vector::operator%=(Vector &other)
 {
-	*this=this->operator%(other);
+	cross(other,*this);
 	return *this;
 }
 
@@ -342,7 +478,7 @@ double Vector::operator[](unsigned int a)
 }
 
 //! Angle Between Two Vectors
-/*! Finds the angle \f$\theta\f$ between two Vectors such that: \f$\theta=\cos^{-1}(\hat u\cdot\hat v)\f$.
+/*! Finds the angle \f$\theta\f$ between two Vectors such that: \f$\theta=\cos^{-1}\frac{u\cdot v}{\left|u\right|\left|v\right|}\f$. Nothing is copied or normalized; the cosine is clamped to \f$[-1,1]\f$ so rounding can't produce NaN for parallel Vectors.
   \param other the other Vector to find the angle between
   \return the angle
   \throw LinAlgException if both Vectors aren't the same dimension */
@@ -350,12 +486,12 @@ double Vector::angle(Vector &other)
 {
 	if (n!=other.n)
 		throw LinAlgException("Incompatible Dimensions");
-	Vector u(n),v(n);
-	u=*this;
-	v=other;
-	u.normalize();
-	v.normalize();
-	return (acos(u*v));
+	double c=operator*(other)/(norm()*other.norm());
+	if (c>1.0)
+		c=1.0;
+	else if (c<-1.0)
+		c=-1.0;
+	return (acos(c));
 }
 
 //! Accessor Method
@@ -372,10 +508,8 @@ double Vector::at(unsigned int a)
   \returns the norm */
 double Vector::norm()
 {
-	double answer=0.0;
-	for (unsigned int i=0;i<n;i++)
-		answer+=pow(vector[i],2.0);
-	return (sqrt(answer));
+	LINALG_FLOPS(OP_NORM,2ul*n+1);
+	return (sqrt(dotSmall(vector,vector,n)));
 }
 
 //! Normalize
@@ -383,9 +517,9 @@ double Vector::norm()
   \sa norm() */
 void Vector::normalize()
 {
-	double k=norm();
-	for (unsigned int i=0;i<n;i++)
-		vector[i]/=k;
+	double k=1.0/norm();
+	scaleLarge(vector,k,n);
+	LINALG_FLOPS(OP_NORMALIZE,n+1);
 }
 
 //! Mutator Method
@@ -415,6 +549,14 @@ void Vector::set(unsigned int a,double v)
 	vector[a]=v;
 }
 
+//! Wrap Accessor
+/*! Indicates whether the Vector operates on an array it does not own.
+  \return true if the Vector wraps the caller's array */
+bool Vector::wraps()
+{
+	return wrapped;
+}
+
 //! Clear The Vector
 /*! Loads all zeros into the Vector. */
 void Vector::zero()